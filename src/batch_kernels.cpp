@@ -0,0 +1,165 @@
+#include "batch_kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace vis4 {
+
+namespace {
+
+const double max_pixel = 1 << 30;
+
+inline int scalar_pixel(int64_t ticks, int64_t origin, double scale, int offset)
+{
+    double p = double(ticks - origin)*scale + offset;
+    if (p < -max_pixel) p = -max_pixel;
+    if (p > max_pixel) p = max_pixel;
+    return int(p);
+}
+
+inline int scalar_lifeline(int component, const int* table, int table_size)
+{
+    return (unsigned)component < (unsigned)table_size ? table[component] : -1;
+}
+
+}
+
+/* Neither SSE2 nor AVX2 converts 64-bit integers to doubles, so each
+   difference is split into the signed high half and the low half,
+   which is biased by 2^31 to be converted as a signed integer:
+   x = hi*2^32 + (lo - 2^31) + 2^31. */
+
+#if defined(__AVX2__)
+
+void ticks_to_pixels(const int64_t* ticks, int count,
+                     int64_t origin, double scale, int offset,
+                     int* pixels)
+{
+    const __m256i vorigin = _mm256_set1_epi64x(origin);
+    const __m256i halves = _mm256_setr_epi32(1, 3, 5, 7, 0, 2, 4, 6);
+    const __m128i bias = _mm_set1_epi32(0x80000000);
+    const __m256d two32 = _mm256_set1_pd(4294967296.0);
+    const __m256d two31 = _mm256_set1_pd(2147483648.0);
+    const __m256d vscale = _mm256_set1_pd(scale);
+    const __m256d voffset = _mm256_set1_pd(offset);
+    const __m256d vmin = _mm256_set1_pd(-max_pixel);
+    const __m256d vmax = _mm256_set1_pd(max_pixel);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i d = _mm256_sub_epi64(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ticks + i)), vorigin);
+        d = _mm256_permutevar8x32_epi32(d, halves);
+
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_castsi256_si128(d));
+        __m256d lo = _mm256_cvtepi32_pd(
+            _mm_xor_si128(_mm256_extracti128_si256(d, 1), bias));
+        __m256d x = _mm256_add_pd(_mm256_mul_pd(hi, two32), _mm256_add_pd(lo, two31));
+
+        __m256d p = _mm256_add_pd(_mm256_mul_pd(x, vscale), voffset);
+        p = _mm256_min_pd(_mm256_max_pd(p, vmin), vmax);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm256_cvttpd_epi32(p));
+    }
+
+    for (; i < count; ++i)
+        pixels[i] = scalar_pixel(ticks[i], origin, scale, offset);
+}
+
+void components_to_lifelines(const int* components, int count,
+                             const int* table, int table_size,
+                             int* lifelines)
+{
+    const __m256i none = _mm256_set1_epi32(-1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i size = _mm256_set1_epi32(table_size);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(components + i));
+        __m256i inside = _mm256_andnot_si256(_mm256_cmpgt_epi32(zero, c),
+                                             _mm256_cmpgt_epi32(size, c));
+        __m256i l = _mm256_mask_i32gather_epi32(none, table, c, inside, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lifelines + i), l);
+    }
+
+    for (; i < count; ++i)
+        lifelines[i] = scalar_lifeline(components[i], table, table_size);
+}
+
+const char* batch_kernels_isa() { return "AVX2"; }
+
+#elif defined(__SSE2__)
+
+void ticks_to_pixels(const int64_t* ticks, int count,
+                     int64_t origin, double scale, int offset,
+                     int* pixels)
+{
+    const __m128i vorigin = _mm_set_epi32(int(origin >> 32), int(origin),
+                                          int(origin >> 32), int(origin));
+    const __m128i bias = _mm_set1_epi32(0x80000000);
+    const __m128d two32 = _mm_set1_pd(4294967296.0);
+    const __m128d two31 = _mm_set1_pd(2147483648.0);
+    const __m128d vscale = _mm_set1_pd(scale);
+    const __m128d voffset = _mm_set1_pd(offset);
+    const __m128d vmin = _mm_set1_pd(-max_pixel);
+    const __m128d vmax = _mm_set1_pd(max_pixel);
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128i d = _mm_sub_epi64(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(ticks + i)), vorigin);
+
+        __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(d, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128d lo = _mm_cvtepi32_pd(
+            _mm_xor_si128(_mm_shuffle_epi32(d, _MM_SHUFFLE(2, 0, 2, 0)), bias));
+        __m128d x = _mm_add_pd(_mm_mul_pd(hi, two32), _mm_add_pd(lo, two31));
+
+        __m128d p = _mm_add_pd(_mm_mul_pd(x, vscale), voffset);
+        p = _mm_min_pd(_mm_max_pd(p, vmin), vmax);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pixels + i), _mm_cvttpd_epi32(p));
+    }
+
+    for (; i < count; ++i)
+        pixels[i] = scalar_pixel(ticks[i], origin, scale, offset);
+}
+
+/* SSE2 has no gather, the table lookup stays scalar. */
+void components_to_lifelines(const int* components, int count,
+                             const int* table, int table_size,
+                             int* lifelines)
+{
+    for (int i = 0; i < count; ++i)
+        lifelines[i] = scalar_lifeline(components[i], table, table_size);
+}
+
+const char* batch_kernels_isa() { return "SSE2"; }
+
+#else
+
+void ticks_to_pixels(const int64_t* ticks, int count,
+                     int64_t origin, double scale, int offset,
+                     int* pixels)
+{
+    for (int i = 0; i < count; ++i)
+        pixels[i] = scalar_pixel(ticks[i], origin, scale, offset);
+}
+
+void components_to_lifelines(const int* components, int count,
+                             const int* table, int table_size,
+                             int* lifelines)
+{
+    for (int i = 0; i < count; ++i)
+        lifelines[i] = scalar_lifeline(components[i], table, table_size);
+}
+
+const char* batch_kernels_isa() { return "scalar"; }
+
+#endif
+
+}
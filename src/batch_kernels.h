@@ -0,0 +1,37 @@
+#ifndef BATCH_KERNELS_HPP
+#define BATCH_KERNELS_HPP
+
+#include <stdint.h>
+
+namespace vis4 {
+
+/** @name Transformations applied to whole batches of records.
+    Arrays are contiguous and of the same length, so the loops have
+    no dependencies between elements. When compiled with SSE2 or AVX2
+    enabled, the kernels process several elements per instruction;
+    otherwise plain loops are used. Results don't depend on the
+    version. */
+//@{
+
+/** Converts ticks to x coordinates:
+    pixels[i] = int((ticks[i] - origin)*scale + offset).
+    Coordinates are clamped to +-2^30, far outside of any page, so
+    that the conversion to int never overflows. */
+void ticks_to_pixels(const int64_t* ticks, int count,
+                     int64_t origin, double scale, int offset,
+                     int* pixels);
+
+/** Maps components to lifelines with a table indexed by component:
+    lifelines[i] = table[components[i]], or -1 if the component is
+    outside of the table. */
+void components_to_lifelines(const int* components, int count,
+                             const int* table, int table_size,
+                             int* lifelines);
+
+/** Name of the instruction set the kernels were compiled for. */
+const char* batch_kernels_isa();
+
+//@}
+
+}
+#endif
@@ -46,6 +46,8 @@ Canvas::Canvas(QWidget* parent)
     setViewportMargins(0, 0, 0, timeline_->sizeHint().height());
     connect(timeline_, SIGNAL( timeSettingsChanged() ),
         this, SLOT( timeSettingsChanged() ) );
+    connect(timeline_, SIGNAL( activityClicked(const common::Time&) ),
+        this, SLOT( activityClicked(const common::Time&) ) );
 }
 
 void Canvas::setModel(Trace_model::Ptr model)
@@ -69,6 +71,14 @@ Trace_model::Ptr & Canvas::model() const
     return contents_->model_;
 }
 
+void Canvas::refresh(Trace_model::Ptr model)
+{
+    contents_->setModel(model, true, true);
+    emit modelChanged(contents_->model_);
+
+    timeline_->update();
+}
+
 void Canvas::timeSettingsChanged()
 {
     timeline_->update();
@@ -83,6 +93,19 @@ void Canvas::timeSettingsChanged()
         settings.setValue("time_format", "plain");
 }
 
+void Canvas::activityClicked(const common::Time& time)
+{
+    if (!model()) return;
+
+    Time new_min = (model()->min_time() + time)/2;
+    Time new_max = (model()->max_time() + time)/2;
+
+    if (new_max - new_min < model()->min_resolution())
+        return;
+
+    setModel(model()->set_range(new_min, new_max));
+}
+
 void Canvas::setCursor(const QCursor& c)
 {
     contents_->setCursor(c);
@@ -214,7 +237,7 @@ Contents_widget::Contents_widget(Canvas* parent)
     setMouseTracking(true);
 }
 
-void Contents_widget::setModel(Trace_model::Ptr model, bool force)
+void Contents_widget::setModel(Trace_model::Ptr model, bool force, bool refresh)
 {
     Q_ASSERT(model.get() != 0);
 
@@ -222,10 +245,10 @@ void Contents_widget::setModel(Trace_model::Ptr model, bool force)
     bool start_in_background = false;
     /* At the moment, 'delta' returns 0 is the time
        unit changed, which is just for our purposed here. */
-    if (!force && model_)
+    if ((!force || refresh) && model_)
     {
         int delta = vis4::delta(*model_, *model);
-        need_redraw = (delta != 0);
+        need_redraw = force || (delta != 0);
         start_in_background = !(delta & Trace_model_delta::time_range);
     }
 
@@ -248,13 +271,13 @@ void Contents_widget::setModel(Trace_model::Ptr model, bool force)
     if (!isVisible()) return;
 
     // Draw trace
-    QApplication::setOverrideCursor(Qt::BusyCursor);
+    if (!refresh) QApplication::setOverrideCursor(Qt::BusyCursor);
     for (;;) {
         pendingRedraw = false;
         doDrawing(start_in_background);
         if (!pendingRedraw) break;
     }
-    QApplication::restoreOverrideCursor();
+    if (!refresh) QApplication::restoreOverrideCursor();
 }
 
 Trace_model::Ptr Contents_widget::model() const
@@ -37,6 +37,11 @@ public:
     void setModel(Trace_model::Ptr model);
     Trace_model::Ptr & model() const;
 
+    /** Redraws the model after the trace data behind it has grown.
+        The old picture is shown until the new one is ready, unless
+        the time range has changed. Generates modelChanged. */
+    void refresh(Trace_model::Ptr model);
+
     void setCursor(const QCursor& c);
 
     /**   ,     . */
@@ -111,6 +116,9 @@ private slots:
 
     void timeSettingsChanged();
 
+    /** Zooms in twice at the time clicked on the activity strip. */
+    void activityClicked(const common::Time& time);
+
 private: /* overloaded methods */
 
     void resizeEvent(QResizeEvent* event);
@@ -140,9 +148,10 @@ public:
     Contents_widget(Canvas* parent);
 
     /** If false is true, always redraw, don't suppress redraw
-        if the model seem unchanged.
+        if the model seem unchanged. If refresh is true, also draw
+        in background if the time range is the same.
      */
-    void setModel(Trace_model::Ptr model, bool force = false);
+    void setModel(Trace_model::Ptr model, bool force = false, bool refresh = false);
 
     Trace_model::Ptr model() const;
 
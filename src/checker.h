@@ -10,6 +10,8 @@
 namespace vis4 {
 
 class Checker;
+class Query;
+struct Rule;
 typedef boost::shared_ptr<Checker> pChecker;
 
 class Checker : public QObject {
@@ -48,6 +50,18 @@ public: /* methods */
 
     virtual void setModel(const Trace_model::Ptr & model) = 0;
 
+    /** Returns the query, if the checker is defined by one. The query
+        is compiled by the model and tested while it finds records. */
+    virtual const Query * query() const { return 0; }
+
+    /** Returns the rule, if the checker is defined by one. The model
+        finds the events violating it. */
+    virtual const Rule * rule() const { return 0; }
+
+    /** Returns the kinds of wait states the checker finds, a bit for
+        each Wait_state::Kind. The model finds them as states. */
+    virtual int wait_kinds() const { return 0; }
+
 private: /* methods */
 
     virtual Checker * clone() const = 0;
@@ -0,0 +1,243 @@
+#include "critical_path.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace vis4 {
+
+namespace {
+
+struct Receive
+{
+    int64_t time;
+    int64_t send_time;
+    int sender;
+};
+
+bool receive_before(const Receive& a, const Receive& b)
+{
+    return a.time < b.time;
+}
+
+struct Component
+{
+    Component()
+    : first(std::numeric_limits<int64_t>::max()),
+      last(std::numeric_limits<int64_t>::min()), cursor(0)
+    {}
+
+    void active(int64_t time)
+    {
+        first = std::min(first, time);
+        last = std::max(last, time);
+    }
+
+    std::vector<Receive> receives;
+    std::vector<const Path_call*> calls;
+    std::vector<Path_segment*> segments;
+    int64_t first;
+    int64_t last;
+    int cursor;                 ///< Receives before it are not walked yet.
+};
+
+typedef std::map<int, Component> Component_map;
+
+/** Keeps the receives made while the receiver was waiting in the
+    receiving call when the message was sent. */
+void keep_dependent(Component& c)
+{
+    std::stable_sort(c.receives.begin(), c.receives.end(), receive_before);
+
+    std::vector<Receive> dependent;
+    std::vector<const Path_call*> open;
+    unsigned k = 0;
+    for (unsigned i = 0; i < c.receives.size(); ++i)
+    {
+        const Receive& r = c.receives[i];
+        while (k < c.calls.size() && c.calls[k]->begin <= r.time)
+        {
+            while (!open.empty() && open.back()->end < c.calls[k]->begin)
+                open.pop_back();
+            open.push_back(c.calls[k++]);
+        }
+        while (!open.empty() && open.back()->end < r.time)
+            open.pop_back();
+
+        if (!open.empty() && r.send_time > open.back()->begin)
+            dependent.push_back(r);
+    }
+
+    c.receives.swap(dependent);
+    c.cursor = (int)c.receives.size();
+}
+
+/** Sums the time of the innermost calls within the segments of one
+    component. Time spans must be added in the order of time. */
+class Blame
+{
+public:
+    Blame(std::vector<Path_segment*>& segments)
+    : segments_(segments), times_(segments.size()), current_(0)
+    {}
+
+    void add(int type, int64_t begin, int64_t end)
+    {
+        if (type == -1 || begin >= end) return;
+
+        while (current_ < segments_.size() && segments_[current_]->end <= begin)
+            ++current_;
+
+        for (unsigned s = current_; s < segments_.size() && segments_[s]->begin < end; ++s)
+        {
+            int64_t time = std::min(end, segments_[s]->end)
+                - std::max(begin, segments_[s]->begin);
+            if (time > 0)
+                times_[s][type] += time;
+        }
+    }
+
+    void finish()
+    {
+        for (unsigned s = 0; s < segments_.size(); ++s)
+        {
+            int64_t best = 0;
+            std::map<int, int64_t>::const_iterator i;
+            for (i = times_[s].begin(); i != times_[s].end(); ++i)
+                if (i->second > best)
+                {
+                    best = i->second;
+                    segments_[s]->type = i->first;
+                }
+        }
+    }
+
+private:
+    std::vector<Path_segment*>& segments_;
+    std::vector< std::map<int, int64_t> > times_;
+    unsigned current_;
+};
+
+bool segment_before(const Path_segment* a, const Path_segment* b)
+{
+    return a->begin < b->begin;
+}
+
+/** Goes over the calls with the stack of the open calls, as
+    OTF_trace_model::profile does for the exclusive time. */
+void blame(Component& c)
+{
+    std::sort(c.segments.begin(), c.segments.end(), segment_before);
+    Blame b(c.segments);
+
+    std::vector<const Path_call*> open;
+    int64_t time = std::numeric_limits<int64_t>::min();
+    for (unsigned k = 0; k <= c.calls.size(); ++k)
+    {
+        int64_t next = k < c.calls.size() ? c.calls[k]->begin
+                                          : std::numeric_limits<int64_t>::max();
+        while (!open.empty() && open.back()->end <= next)
+        {
+            b.add(open.back()->type, time, open.back()->end);
+            time = std::max(time, open.back()->end);
+            open.pop_back();
+        }
+        if (k == c.calls.size()) break;
+
+        if (!open.empty())
+            b.add(open.back()->type, time, next);
+        time = next;
+        open.push_back(c.calls[k]);
+    }
+
+    b.finish();
+}
+
+Path_segment make_segment(Path_segment::Kind kind, int component, int from_component,
+                          int64_t begin, int64_t end)
+{
+    Path_segment s = { kind, component, from_component, begin, end, -1 };
+    return s;
+}
+
+}
+
+void find_critical_path(const std::vector<const Path_part*>& parts, int64_t min,
+                        std::vector<Path_segment>& path)
+{
+    Component_map components;
+    for (unsigned p = 0; p < parts.size(); ++p)
+    {
+        const Path_part& part = *parts[p];
+        for (unsigned i = 0; i < part.messages.size(); ++i)
+        {
+            const Path_message& m = part.messages[i];
+            if (m.receive_time < m.send_time) continue;
+
+            Receive r = { m.receive_time, m.send_time, m.sender };
+            components[m.receiver].receives.push_back(r);
+            components[m.receiver].active(m.receive_time);
+            components[m.sender].active(m.send_time);
+        }
+
+        for (unsigned i = 0; i < part.calls.size(); ++i)
+        {
+            const Path_call& c = part.calls[i];
+            Component& component = components[c.component];
+            component.calls.push_back(&c);
+            component.active(c.begin);
+            component.active(c.end);
+        }
+    }
+    if (components.empty()) return;
+
+    Component_map::iterator i, start = components.begin();
+    for (i = components.begin(); i != components.end(); ++i)
+    {
+        keep_dependent(i->second);
+        if (i->second.last > start->second.last)
+            start = i;
+    }
+
+    /* Walking back gives the segments from the end. */
+    std::vector<Path_segment> reversed;
+    int component = start->first;
+    int64_t time = start->second.last;
+    for (;;)
+    {
+        Component& c = components[component];
+        while (c.cursor > 0 && c.receives[c.cursor-1].time > time)
+            --c.cursor;
+
+        if (c.cursor == 0)
+        {
+            int64_t begin = std::max(min, std::min(c.first, time));
+            reversed.push_back(make_segment(Path_segment::local, component, component,
+                                            begin, time));
+            break;
+        }
+
+        const Receive& r = c.receives[--c.cursor];
+        reversed.push_back(make_segment(Path_segment::local, component, component,
+                                        r.time, time));
+        reversed.push_back(make_segment(Path_segment::message, component, r.sender,
+                                        r.send_time, r.time));
+        component = r.sender;
+        time = r.send_time;
+    }
+
+    size_t first = path.size();
+    for (int k = (int)reversed.size() - 1; k >= 0; --k)
+        if (reversed[k].kind == Path_segment::message || reversed[k].begin < reversed[k].end)
+            path.push_back(reversed[k]);
+
+    for (size_t k = first; k < path.size(); ++k)
+        if (path[k].kind == Path_segment::local)
+            components[path[k].component].segments.push_back(&path[k]);
+
+    for (i = components.begin(); i != components.end(); ++i)
+        if (!i->second.segments.empty())
+            blame(i->second);
+}
+
+}
@@ -0,0 +1,29 @@
+#ifndef CRITICAL_PATH_HPP
+#define CRITICAL_PATH_HPP
+
+#include "trace_model.h"
+
+#include <vector>
+#include <stdint.h>
+
+namespace vis4 {
+
+/** Finds the critical path through the messages and calls of parts,
+    the longest chain of dependent work ending at the last activity.
+
+    A receive depends on its send if the receiver was already in the
+    receiving call, the innermost call at the receive, when the message
+    was sent. The path is walked back from the component active last:
+    along the component to its latest dependent receive, then along the
+    message to the sender, and so on. Every component is walked back
+    once in total, so after the messages are sorted by receive the time
+    is linear in the number of messages and calls.
+
+    Segments are appended to path in the order of time. Segments within
+    a component are blamed on the state with most innermost time, and
+    the path starts not earlier than min. */
+void find_critical_path(const std::vector<const Path_part*>& parts, int64_t min,
+                        std::vector<Path_segment>& path);
+
+}
+#endif
@@ -2,63 +2,142 @@
 
 #include "trace_model.h"
 #include "event_model.h"
+#include "string_table.h"
 
 #include <QHeaderView>
 #include <QScrollBar>
 
+#include <algorithm>
+
 namespace vis4 {
 
 using common::Time;
+using common::String_table;
+
+namespace {
+
+bool earlier(const Event_record& a, const Event_record& b)
+{
+    return a.time < b.time;
+}
+
+}
+
+Event_table_model::Event_table_model(Trace_model::Ptr & model,
+                                     QVector<Event_record>& records, QObject* parent)
+: QAbstractTableModel(parent), model_(model)
+{
+    records_.swap(records);
+}
+
+Event_table_model::~Event_table_model()
+{
+    qDeleteAll(events_);
+}
+
+int Event_table_model::rowCount(const QModelIndex & parent) const
+{
+    return parent.isValid() ? 0 : records_.size();
+}
+
+int Event_table_model::columnCount(const QModelIndex & parent) const
+{
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant Event_table_model::data(const QModelIndex & index, int role) const
+{
+    if (!index.isValid() || index.row() >= records_.size())
+        return QVariant();
+
+    const Event_record& e = records_[index.row()];
+
+    if (index.column() == 0 && role == Qt::DisplayRole)
+        return model_->ticks_time(e.time).toString();
+
+    if (index.column() == 1 && (role == Qt::DisplayRole || role == Qt::ToolTipRole))
+        return String_table::instance().string(e.kind);
+
+    return QVariant();
+}
+
+int Event_table_model::nearestRow(const Time & time) const
+{
+    if (records_.isEmpty()) return -1;
+
+    Event_record probe;
+    probe.time = model_->time_ticks(time);
+    int row = std::lower_bound(records_.begin(), records_.end(), probe, earlier)
+        - records_.begin();
+
+    if (row == records_.size()
+        || (row > 0 && probe.time - records_[row-1].time <= records_[row].time - probe.time))
+        --row;
+    return row;
+}
+
+int Event_table_model::findRow(Event_model * e)
+{
+    Event_record probe;
+    probe.time = model_->time_ticks(e->time);
+
+    QVector<Event_record>::const_iterator i =
+        std::lower_bound(records_.constBegin(), records_.constEnd(), probe, earlier);
+
+    for (; i != records_.constEnd() && i->time == probe.time; ++i)
+    {
+        int row = i - records_.constBegin();
+        if (i->kind == e->kind && i->component == e->component && *event(row) == *e)
+            return row;
+    }
+    return -1;
+}
+
+Event_model * Event_table_model::event(int row)
+{
+    Q_ASSERT(row < records_.size());
+
+    Event_model*& e = events_[row];
+    if (!e)
+        e = model_->make_event(records_[row]).release();
+    return e;
+}
+
+void Event_table_model::updateTime()
+{
+    if (!records_.isEmpty())
+        emit dataChanged(index(0, 0), index(records_.size()-1, 0));
+}
 
 Event_list::Event_list(QWidget* parent) : QTreeView(parent), model_(0)
 {
     //setSelectionBehaviour(SelectRows);
     QTreeView::setRootIsDecorated(false);
     setEditTriggers(NoEditTriggers);
+    setUniformRowHeights(true);
     header()->hide();
 }
 
-void Event_list::showEvents(Trace_model::Ptr & model, const Time & time)
+void Event_list::showEvents(Trace_model::Ptr & model, int component,
+                            const Time & min, const Time & max, const Time & time)
 {
-    delete model_;
-    events.clear();
+    QVector<Event_record> records;
+    model->lifeline_events(component, min, max, records);
+
+    Event_table_model* old = model_;
 
-    model_ = new QStandardItemModel(this);
-    model_->insertColumns(0, 2);
+    model_ = new Event_table_model(model, records, this);
     QTreeView::setModel(model_);
+    delete old;
     connect(this->selectionModel(), SIGNAL(currentChanged(const QModelIndex &, const QModelIndex &)),
             this, SLOT(eventListRowChanged(const QModelIndex &)));
 
-    int nearest_event = -1; Time min_distance; int row = 0;
-    for(;;)
-    {
-        std::auto_ptr<Event_model> e = model->next_event();
-
-        if (!e.get())
-            break;
-
-        model_->insertRow(row);
-
-        if (nearest_event == -1 || distance(time, e->time) < min_distance)
-        {
-            nearest_event = row;
-            min_distance = distance(time, e->time);
-        }
-
-        QModelIndex index = model_->index(row, 0, QModelIndex());
-        model_->setData(index, e->time.toString());
-        index = model_->index(row, 1, QModelIndex());
-        model_->setData(index, e->shortDescription());
-        model_->setData(index, e->shortDescription(), Qt::ToolTipRole);
-        events.push_back(e.release());
-        ++row;
-    }
-
     setAlternatingRowColors(true);
 
     resizeColumnToContents(0);
     resizeColumnToContents(1);
 
+    int nearest_event = model_->nearestRow(time);
     if (nearest_event != -1) {
         selectionModel()->setCurrentIndex(this->model()->index(nearest_event, 0),
             QItemSelectionModel::Select);
@@ -71,11 +150,9 @@ void Event_list::showEvents(Trace_model::Ptr & model, const Time & time)
 
 void Event_list::updateTime()
 {
-    for(int i = 0; i < events.size(); ++i)
-    {
-        QModelIndex index = model_->index(i, 0, QModelIndex());
-        model_->setData(index, events[i]->time.toString());
-    }
+    if (!model_) return;
+
+    model_->updateTime();
     resizeColumnToContents(0);
 }
 
@@ -83,28 +160,22 @@ Event_model * Event_list::currentEvent()
 {
     int row = currentIndex().row();
     if (row != -1)
-    {
-        Q_ASSERT(row < events.size());
-
-        return events[row];
-    }
+        return model_->event(row);
 
     return 0;
 }
 
 void Event_list::setCurrentEvent(Event_model * event)
 {
-    for(int i = 0; i < events.size(); ++i)
+    int row = model_ ? model_->findRow(event) : -1;
+    if (row == -1)
     {
-        if (*(events[i]) == *event)
-        {
-            QModelIndex index = model_->index(i, 0, QModelIndex());
-            setCurrentIndex(index); scrollTo(index);
-            return;
-        }
+        qWarning("Can't find given event in the list");
+        return;
     }
 
-    qFatal("Can't find given event in the list");
+    QModelIndex index = model_->index(row, 0, QModelIndex());
+    setCurrentIndex(index); scrollTo(index);
 }
 
 void Event_list::eventListRowChanged(const QModelIndex& index)
@@ -4,20 +4,61 @@
 #include "trace_model.h"
 
 #include <QTreeView>
-#include <QStandardItemModel>
+#include <QAbstractTableModel>
 #include <QVector>
+#include <QHash>
 
 namespace vis4 {
 
 class Event_model;
 
+/** Table of events for Event_list.
+
+    Events are kept as records sorted by time, and rows are formatted
+    only when the view asks for them, so lists of millions of events
+    are cheap. Event_model objects are created only for the rows
+    whose details are shown, and are owned by the table. */
+class Event_table_model : public QAbstractTableModel
+{
+public:
+    /** Takes the records, which must be sorted by time. */
+    Event_table_model(Trace_model::Ptr & model, QVector<Event_record>& records,
+                      QObject* parent);
+    ~Event_table_model();
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    int columnCount(const QModelIndex & parent = QModelIndex()) const;
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+
+    /** Returns the row of the event nearest to time. */
+    int nearestRow(const common::Time & time) const;
+
+    /** Returns the row of the event, or -1 if it's not in the table. */
+    int findRow(Event_model * event);
+
+    /** Returns the event of the row, creating it if necessary. */
+    Event_model * event(int row);
+
+    /** Tells the view that times must be formatted again. */
+    void updateTime();
+
+private:
+    Trace_model::Ptr model_;
+    QVector<Event_record> records_;
+    QHash<int, Event_model*> events_;
+};
+
 class Event_list : public QTreeView
 {
     Q_OBJECT
 public:
     Event_list(QWidget* parent);
 
-    void showEvents(Trace_model::Ptr & model, const common::Time & time);
+    /** Shows the events of the lifeline of component within [min, max]
+        and selects the one nearest to time. */
+    void showEvents(Trace_model::Ptr & model, int component,
+                    const common::Time & min, const common::Time & max,
+                    const common::Time & time);
 
     void updateTime();
 
@@ -35,8 +76,7 @@ private slots:
     void eventListRowChanged(const QModelIndex& index);
 
 private:
-    QStandardItemModel* model_;
-    QVector<Event_model*> events;
+    Event_table_model* model_;
 };
 
 
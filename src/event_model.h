@@ -2,6 +2,7 @@
 #define EVENT_MODEL_HPP_VP_2006_03_21
 
 #include "time_vis3.h"
+#include "string_table.h"
 #include <QString>
 
 class QWidget;
@@ -18,10 +19,16 @@ public:
     /**   . */
     common::Time time;
 
-    /**   ().     
-           .
+    /**   (   String_table). 
+               .
     */
-    QString kind;
+    uint32_t kind;
+
+    /**   . */
+    const QString& kindName() const
+    {
+        return common::String_table::instance().string(kind);
+    }
 
     /** ,    .  
          . */
@@ -46,7 +53,7 @@ public:
 
     /**    ,   
          .      . */
-    virtual QString shortDescription() const { return kind; }
+    virtual QString shortDescription() const { return kindName(); }
 
     /**      ,  
           .
@@ -0,0 +1,647 @@
+#include "otf_loader.h"
+
+#include <QMutexLocker>
+#include <QFileInfo>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QMap>
+#include <QTime>
+#include <QFileSystemWatcher>
+#include <QDebug>
+
+#include "otf.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+struct Loader_state
+{
+    Record_ring* ring;          ///< If null, records are collected in batch.
+    Record_ring::Batch batch;
+    uint64_t records;
+};
+
+int add_record(void* userData, uint64_t time, Trace_record::Type type,
+               uint32_t process, uint32_t id, uint32_t peer = 0,
+               uint32_t group = 0, uint32_t length = 0)
+{
+    Loader_state* state = (Loader_state*)userData;
+
+    Trace_record r = { time, type, process, id, peer, group, length };
+    state->batch.push_back(r);
+    ++state->records;
+
+    if (state->ring && state->batch.size() >= (size_t)OTF_loader::batch_size)
+    {
+        if (!state->ring->push(state->batch))
+            return OTF_RETURN_ABORT;
+        state->batch.reserve(OTF_loader::batch_size);
+    }
+    return OTF_RETURN_OK;
+}
+
+int handleEnter(void *userData, uint64_t time, uint32_t function, uint32_t process,
+                uint32_t source, OTF_KeyValueList *list)
+{
+    return add_record(userData, time, Trace_record::enter, process, function);
+}
+
+int handleLeave(void *userData, uint64_t time, uint32_t function, uint32_t process,
+                uint32_t source, OTF_KeyValueList *list)
+{
+    return add_record(userData, time, Trace_record::leave, process, function);
+}
+
+int handleMarker(void *userData, uint64_t time, uint32_t process, uint32_t token,
+                 const char *text, OTF_KeyValueList *list)
+{
+    return add_record(userData, time, Trace_record::marker, process, token);
+}
+
+int handleSendMsg(void *userData, uint64_t time, uint32_t sender, uint32_t receiver,
+                  uint32_t group, uint32_t type, uint32_t length, uint32_t source,
+                  OTF_KeyValueList *list)
+{
+    return add_record(userData, time, Trace_record::send, sender, type,
+                      receiver, group, length);
+}
+
+int handleRecvMsg(void *userData, uint64_t time, uint32_t recvProc, uint32_t sendProc,
+                  uint32_t group, uint32_t type, uint32_t length, uint32_t source,
+                  OTF_KeyValueList *list)
+{
+    return add_record(userData, time, Trace_record::receive, recvProc, type,
+                      sendProc, group, length);
+}
+
+void set_handlers(OTF_HandlerArray* handlers, Loader_state* state)
+{
+    OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleEnter, OTF_ENTER_RECORD );
+    OTF_HandlerArray_setFirstHandlerArg( handlers, state, OTF_ENTER_RECORD );
+
+    OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleLeave, OTF_LEAVE_RECORD );
+    OTF_HandlerArray_setFirstHandlerArg( handlers, state, OTF_LEAVE_RECORD );
+
+    OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleMarker, OTF_MARKER_RECORD );
+    OTF_HandlerArray_setFirstHandlerArg( handlers, state, OTF_MARKER_RECORD );
+
+    OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleSendMsg, OTF_SEND_RECORD );
+    OTF_HandlerArray_setFirstHandlerArg( handlers, state, OTF_SEND_RECORD );
+
+    OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleRecvMsg, OTF_RECEIVE_RECORD );
+    OTF_HandlerArray_setFirstHandlerArg( handlers, state, OTF_RECEIVE_RECORD );
+}
+
+bool is_compressed(const QString& file)
+{
+    return file.endsWith(".z");
+}
+
+/** Takes the number of read calls and bytes read by the calling
+    thread from the system. Returns false if it doesn't count them. */
+bool thread_reads(uint64_t& reads, uint64_t& bytes)
+{
+    FILE* f = fopen("/proc/thread-self/io", "r");
+    if (!f) return false;
+
+    bool has_reads = false, has_bytes = false;
+    char name[32];
+    unsigned long long value;
+    while (fscanf(f, "%31[^:]: %llu ", name, &value) == 2)
+    {
+        if (strcmp(name, "syscr") == 0) { reads = value; has_reads = true; }
+        if (strcmp(name, "rchar") == 0) { bytes = value; has_bytes = true; }
+    }
+    fclose(f);
+    return has_reads && has_bytes;
+}
+
+}
+
+void apply_records(Trace_store& store, const Trace_record* records, size_t count)
+{
+    for (const Trace_record* r = records, *e = records + count; r != e; ++r)
+    {
+        switch (r->type)
+        {
+            case Trace_record::enter:
+                store.addEnter(r->time, r->id, r->process);
+                break;
+            case Trace_record::leave:
+                store.addLeave(r->time, r->id, r->process);
+                break;
+            case Trace_record::send:
+                store.addSend(r->time, r->process, r->peer, r->group, r->id, r->length);
+                break;
+            case Trace_record::receive:
+                store.addReceive(r->time, r->process, r->peer, r->group, r->id, r->length);
+                break;
+            case Trace_record::marker:
+                store.addMarker(r->time, r->process, r->id);
+                break;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------ */
+
+Record_ring::Record_ring(int capacity)
+: capacity_(capacity > 0 ? capacity : 1), finished_(false), cancelled_(false)
+{
+}
+
+bool Record_ring::push(Batch& batch)
+{
+    QMutexLocker lock(&mutex_);
+
+    while ((int)batches_.size() >= capacity_ && !cancelled_)
+        not_full_.wait(&mutex_);
+
+    if (cancelled_)
+        return false;
+
+    batches_.push_back(Batch());
+    batches_.back().swap(batch);
+    not_empty_.wakeOne();
+    return true;
+}
+
+bool Record_ring::pop(Batch& batch, bool wait)
+{
+    QMutexLocker lock(&mutex_);
+
+    while (batches_.empty() && wait && !finished_ && !cancelled_)
+        not_empty_.wait(&mutex_);
+
+    if (batches_.empty())
+        return false;
+
+    batch.clear();
+    batch.swap(batches_.front());
+    batches_.pop_front();
+    not_full_.wakeOne();
+    return true;
+}
+
+void Record_ring::finish()
+{
+    QMutexLocker lock(&mutex_);
+    finished_ = true;
+    not_empty_.wakeAll();
+}
+
+void Record_ring::cancel()
+{
+    QMutexLocker lock(&mutex_);
+    cancelled_ = true;
+    batches_.clear();
+    not_full_.wakeAll();
+    not_empty_.wakeAll();
+}
+
+bool Record_ring::finished() const
+{
+    QMutexLocker lock(&mutex_);
+    return finished_;
+}
+
+bool Record_ring::cancelled() const
+{
+    QMutexLocker lock(&mutex_);
+    return cancelled_;
+}
+
+/* ------------------------------------------------------------------ */
+
+const int OTF_loader::batch_size;
+const int OTF_loader::handles_per_stream;
+const int OTF_loader::chunk_records;
+
+/** Worker reading streams assigned by OTF_loader. */
+class Stream_worker : public QThread
+{
+public:
+    Stream_worker(OTF_loader* loader) : loader_(loader) {}
+
+protected:
+    void run();
+
+private:
+    OTF_loader* loader_;
+};
+
+void Stream_worker::run()
+{
+    Record_ring* ring = loader_->ring_;
+
+    Loader_state state;
+    state.ring = ring;
+    state.records = 0;
+    state.batch.reserve(OTF_loader::batch_size);
+
+    OTF_FileManager* manager = OTF_FileManager_open( OTF_loader::handles_per_stream );
+    assert( manager );
+
+    OTF_HandlerArray* handlers = OTF_HandlerArray_open();
+    assert( handlers );
+
+    set_handlers(handlers, &state);
+
+    QByteArray namestub = loader_->namestub_.toAscii();
+
+    uint64_t first_reads = 0, first_bytes = 0;
+    bool counted = thread_reads(first_reads, first_bytes);
+
+    uint32_t stream;
+    while (!ring->cancelled() && loader_->nextStream(stream))
+    {
+        QString events = loader_->streamFile(stream, "events");
+        QString markers = loader_->streamFile(stream, "marker");
+
+        OTF_RStream* rstream = OTF_RStream_open( namestub.data(), stream, manager );
+        if (!rstream) continue;
+
+        if (loader_->buffer_size_) OTF_RStream_setBufferSizes( rstream, loader_->buffer_size_ );
+        if (loader_->zbuffer_size_) OTF_RStream_setZBufferSizes( rstream, loader_->zbuffer_size_ );
+
+        /* Records are read in chunks, so the progress is reported
+           while large streams are read. */
+        OTF_RStream_setRecordLimit( rstream, OTF_loader::chunk_records );
+
+        state.records = 0;
+        uint64_t reported = 0;
+        if (!events.isEmpty())
+        {
+            uint64_t size = QFileInfo(events).size();
+            while (!ring->cancelled())
+            {
+                uint64_t read = OTF_RStream_readEvents( rstream, handlers );
+                if (read == 0 || read == OTF_READ_ERROR) break;
+
+                uint64_t minimum, current, maximum;
+                if (OTF_RStream_eventBytesProgress( rstream, &minimum, &current, &maximum ))
+                {
+                    uint64_t done = qMin(current - minimum, size);
+                    if (done > reported)
+                    {
+                        loader_->addProgress(done - reported);
+                        reported = done;
+                    }
+                }
+            }
+
+            OTF_RBuffer* buffer = OTF_RStream_getEventBuffer( rstream );
+            if (!is_compressed(events) && buffer)
+            {
+                Tail_position p = { stream, false, events,
+                    OTF_RBuffer_getFilePos( buffer ), buffer->time, buffer->process };
+                loader_->addTailPosition(p);
+            }
+        }
+        if (!markers.isEmpty())
+        {
+            while (!ring->cancelled())
+            {
+                uint64_t read = OTF_RStream_readMarkers( rstream, handlers );
+                if (read == 0 || read == OTF_READ_ERROR) break;
+            }
+
+            OTF_RBuffer* buffer = OTF_RStream_getMarkerBuffer( rstream );
+            if (!is_compressed(markers) && buffer)
+            {
+                Tail_position p = { stream, true, markers,
+                    OTF_RBuffer_getFilePos( buffer ), buffer->time, buffer->process };
+                loader_->addTailPosition(p);
+            }
+        }
+
+        /* Each batch holds records of one stream only. */
+        if (!state.batch.empty())
+            ring->push(state.batch);
+
+        OTF_RStream_close( rstream );
+
+        int files = 0;
+        uint64_t bytes = 0;
+        if (!events.isEmpty()) { ++files; bytes += QFileInfo(events).size(); }
+        if (!markers.isEmpty()) { ++files; bytes += QFileInfo(markers).size(); }
+        loader_->streamDone(state.records, files);
+        loader_->addProgress(bytes > reported ? bytes - reported : 0);
+    }
+
+    OTF_HandlerArray_close( handlers );
+    OTF_FileManager_close( manager );
+
+    uint64_t reads = 0, bytes = 0;
+    if (counted && thread_reads(reads, bytes))
+        loader_->addReads(reads - first_reads, bytes - first_bytes);
+}
+
+OTF_loader::OTF_loader(const QString& filename, Record_ring* ring)
+: filename_(filename), ring_(ring), buffer_size_(0), zbuffer_size_(0),
+  handle_budget_(64), records_(0), total_bytes_(0), done_bytes_(0), elapsed_(0)
+{
+    Io_counters zero = { 0, 0, 0, false };
+    counters_ = zero;
+}
+
+void OTF_loader::setBufferSizes(uint32_t buffer, uint32_t zbuffer)
+{
+    buffer_size_ = buffer;
+    zbuffer_size_ = zbuffer;
+}
+
+void OTF_loader::setHandleBudget(int handles)
+{
+    handle_budget_ = handles;
+}
+
+uint64_t OTF_loader::records() const
+{
+    QMutexLocker lock(&mutex_);
+    return records_;
+}
+
+int OTF_loader::progress() const
+{
+    QMutexLocker lock(&mutex_);
+    if (total_bytes_ == 0)
+        return ring_->finished() ? 100 : 0;
+    return (int)(done_bytes_ * 100 / total_bytes_);
+}
+
+Io_counters OTF_loader::counters() const
+{
+    QMutexLocker lock(&mutex_);
+    return counters_;
+}
+
+qint64 OTF_loader::traceSize(const QString& filename)
+{
+    QFileInfo info(filename);
+    QStringList files = info.absoluteDir().entryList(
+        QStringList() << info.completeBaseName() + ".*", QDir::Files);
+
+    qint64 size = 0;
+    foreach (const QString& f, files)
+        size += QFileInfo(info.absoluteDir(), f).size();
+    return size;
+}
+
+QString OTF_loader::streamFile(uint32_t stream, const QString& suffix) const
+{
+    QString name = namestub_ + "." + QString::number(stream, 16) + "." + suffix;
+    if (QFile::exists(name)) return name;
+    if (QFile::exists(name + ".z")) return name + ".z";
+    return QString();
+}
+
+bool OTF_loader::nextStream(uint32_t& stream)
+{
+    QMutexLocker lock(&mutex_);
+    if (streams_.empty())
+        return false;
+
+    stream = streams_.front();
+    streams_.pop_front();
+    return true;
+}
+
+void OTF_loader::addProgress(uint64_t bytes)
+{
+    QMutexLocker lock(&mutex_);
+    done_bytes_ = qMin(done_bytes_ + bytes, total_bytes_);
+}
+
+std::vector<Tail_position> OTF_loader::tailPositions() const
+{
+    QMutexLocker lock(&mutex_);
+    return tail_positions_;
+}
+
+void OTF_loader::addTailPosition(const Tail_position& position)
+{
+    QMutexLocker lock(&mutex_);
+    tail_positions_.push_back(position);
+}
+
+void OTF_loader::streamDone(uint64_t records, int files)
+{
+    QMutexLocker lock(&mutex_);
+    records_ += records;
+    counters_.files += files;
+}
+
+void OTF_loader::addReads(uint64_t reads, uint64_t bytes)
+{
+    QMutexLocker lock(&mutex_);
+    counters_.reads += reads;
+    counters_.bytes += bytes;
+    counters_.available = true;
+}
+
+namespace {
+
+struct Stream_order
+{
+    Stream_order(const QMap<uint32_t, qint64>& sizes) : sizes(sizes) {}
+    bool operator()(uint32_t a, uint32_t b) const { return sizes[a] > sizes[b]; }
+    const QMap<uint32_t, qint64>& sizes;
+};
+
+}
+
+void OTF_loader::run()
+{
+    QTime timer;
+    timer.start();
+
+    char* namestub = OTF_stripFilename( filename_.toAscii().data() );
+    namestub_ = namestub;
+
+    /* Stream list from the master control file. Stream 0 may have
+       only markers and is not listed there. */
+    OTF_FileManager* manager = OTF_FileManager_open( 1 );
+    assert( manager );
+
+    OTF_MasterControl* master = OTF_MasterControl_new( manager );
+    assert( master );
+
+    QSet<uint32_t> ids;
+    ids.insert(0);
+    if (OTF_MasterControl_read( master, namestub ))
+    {
+        for (uint32_t i = 0; i < OTF_MasterControl_getCount( master ); ++i)
+            ids.insert(OTF_MasterControl_getEntryByIndex( master, i )->argument);
+    }
+
+    OTF_MasterControl_close( master );
+    OTF_FileManager_close( manager );
+    free( namestub );
+
+    QMap<uint32_t, qint64> sizes;
+    foreach (uint32_t id, ids)
+    {
+        QString events = streamFile(id, "events");
+        QString markers = streamFile(id, "marker");
+        if (events.isEmpty() && markers.isEmpty()) continue;
+
+        sizes[id] = (events.isEmpty() ? 0 : QFileInfo(events).size())
+            + (markers.isEmpty() ? 0 : QFileInfo(markers).size());
+        streams_.push_back(id);
+    }
+    std::sort(streams_.begin(), streams_.end(), Stream_order(sizes));
+
+    {
+        QMutexLocker lock(&mutex_);
+        foreach (qint64 size, sizes)
+            total_bytes_ += size;
+    }
+
+    int workers = qMin(QThread::idealThreadCount(), handle_budget_ / handles_per_stream);
+    workers = qMax(1, qMin(workers, (int)streams_.size()));
+
+    std::vector<Stream_worker*> threads;
+    for (int i = 0; i < workers; ++i)
+    {
+        threads.push_back(new Stream_worker(this));
+        threads.back()->start();
+    }
+    for (int i = 0; i < workers; ++i)
+    {
+        threads[i]->wait();
+        delete threads[i];
+    }
+
+    ring_->finish();
+    elapsed_ = timer.elapsed();
+
+    Io_counters c = counters();
+    if (c.available)
+        qDebug() << "OTF loader:" << workers << "streams at once,"
+                 << (unsigned long long)c.files << "files,"
+                 << (unsigned long long)c.reads << "reads,"
+                 << (unsigned long long)c.bytes << "bytes";
+    else
+        qDebug() << "OTF loader:" << workers << "streams at once,"
+                 << (unsigned long long)c.files << "files";
+}
+
+/* ------------------------------------------------------------------ */
+
+OTF_tail::OTF_tail(const QString& filename, const std::vector<Tail_position>& positions)
+: positions_(positions), watcher_(new QFileSystemWatcher(this))
+{
+    char* namestub = OTF_stripFilename( filename.toAscii().data() );
+    namestub_ = namestub;
+    free( namestub );
+
+    for (unsigned i = 0; i < positions_.size(); ++i)
+    {
+        watcher_->addPath(positions_[i].file);
+
+        /* Records may have been appended since the load. */
+        changed_.insert(i);
+    }
+
+    connect(watcher_, SIGNAL( fileChanged(const QString&) ),
+            this, SLOT( fileChanged(const QString&) ));
+}
+
+void OTF_tail::fileChanged(const QString& file)
+{
+    for (unsigned i = 0; i < positions_.size(); ++i)
+        if (positions_[i].file == file)
+            changed_.insert(i);
+}
+
+bool OTF_tail::read(Trace_store& store)
+{
+    if (changed_.isEmpty())
+        return false;
+
+    QSet<int> changed = changed_;
+    changed_.clear();
+
+    OTF_FileManager* manager = OTF_FileManager_open( OTF_loader::handles_per_stream );
+    assert( manager );
+
+    OTF_HandlerArray* handlers = OTF_HandlerArray_open();
+    assert( handlers );
+
+    Loader_state state;
+    state.ring = 0;
+    state.records = 0;
+    set_handlers(handlers, &state);
+
+    QByteArray namestub = namestub_.toAscii();
+
+    foreach (int i, changed)
+    {
+        Tail_position& p = positions_[i];
+
+        /* The writer may be in the middle of a record; the file is
+           read when it ends with a complete line. */
+        QFile file(p.file);
+        if (file.size() <= (qint64)p.offset)
+            continue;
+
+        char last = 0;
+        if (!file.open(QIODevice::ReadOnly) || !file.seek(file.size() - 1)
+            || !file.getChar(&last) || last != '\n')
+        {
+            changed_.insert(i);
+            continue;
+        }
+        file.close();
+
+        OTF_RStream* rstream = OTF_RStream_open( namestub.data(), p.stream, manager );
+        if (!rstream) continue;
+
+        OTF_RBuffer* buffer = p.markers ? OTF_RStream_getMarkerBuffer( rstream )
+                                        : OTF_RStream_getEventBuffer( rstream );
+        if (!buffer)
+        {
+            OTF_RStream_close( rstream );
+            continue;
+        }
+
+        /* Jump continues from the start of the next line, so it is
+           given the newline ending the last record read. Time and
+           process are written only when they change, so the parser
+           state is restored as well. */
+        if (p.offset > 0)
+            OTF_RBuffer_jump( buffer, p.offset - 1 );
+        buffer->time = p.time;
+        buffer->process = p.process;
+
+        if (p.markers)
+            OTF_RStream_readMarkers( rstream, handlers );
+        else
+            OTF_RStream_readEvents( rstream, handlers );
+
+        p.offset = OTF_RBuffer_getFilePos( buffer );
+        p.time = buffer->time;
+        p.process = buffer->process;
+
+        OTF_RStream_close( rstream );
+    }
+
+    OTF_HandlerArray_close( handlers );
+    OTF_FileManager_close( manager );
+
+    if (state.batch.empty())
+        return false;
+
+    apply_records(store, &state.batch[0], state.batch.size());
+    return true;
+}
+
+}
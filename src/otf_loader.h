@@ -0,0 +1,221 @@
+#ifndef OTF_LOADER_HPP
+#define OTF_LOADER_HPP
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QObject>
+#include <QSet>
+
+#include <vector>
+#include <deque>
+
+#include "trace_store.h"
+
+class QFileSystemWatcher;
+
+namespace vis4 {
+
+/** Event record decoded by the loader thread. */
+struct Trace_record
+{
+    enum Type { enter, leave, send, receive, marker };
+
+    uint64_t time;
+    uint32_t type;
+    uint32_t process;   ///< Sender for sends, receiver for receives.
+    uint32_t id;        ///< Function, message tag or marker token.
+    uint32_t peer;      ///< Partner process of the message.
+    uint32_t group;
+    uint32_t length;
+};
+
+/** Adds decoded records to the store. */
+void apply_records(Trace_store& store, const Trace_record* records, size_t count);
+
+/** Bounded queue of record batches between the loader thread and
+    the thread building the store. The producer blocks while the
+    ring is full, so read-ahead never exceeds the ring capacity. */
+class Record_ring
+{
+public:
+    typedef std::vector<Trace_record> Batch;
+
+    Record_ring(int capacity);
+
+    /** Moves the batch into the ring, leaving it empty. Returns
+        false if the ring was cancelled. */
+    bool push(Batch& batch);
+
+    /** Moves the oldest batch out of the ring. If wait is true,
+        blocks until a batch arrives. Returns false if there are
+        no batches and the producer has finished or wait is false. */
+    bool pop(Batch& batch, bool wait);
+
+    /** Called by the producer after the last batch. */
+    void finish();
+
+    /** Wakes the producer and drops all pending batches. */
+    void cancel();
+
+    bool finished() const;
+    bool cancelled() const;
+
+private:
+    mutable QMutex mutex_;
+    QWaitCondition not_empty_;
+    QWaitCondition not_full_;
+
+    std::deque<Batch> batches_;
+    int capacity_;
+    bool finished_;
+    bool cancelled_;
+};
+
+/** I/O counters of the stream scheduler. Reads are done by OTF, so
+    they are taken from the counters the system keeps for each worker
+    thread, in /proc/thread-self/io. Where there are none, reads and
+    bytes stay 0 and available is false. */
+struct Io_counters
+{
+    uint64_t files;     ///< Stream files read.
+    uint64_t reads;     ///< Read calls made by the workers.
+    uint64_t bytes;     ///< Bytes they read, compressed size for .z files.
+    bool available;
+};
+
+/** Position after the last record read from a stream file. Records
+    appended to the file later are read from here. */
+struct Tail_position
+{
+    uint32_t stream;
+    bool markers;       ///< Marker file, otherwise events file.
+    QString file;
+    uint64_t offset;
+
+    /** Time and process of the read buffer at the offset, the state
+        of the parser there. The file holds them only when they
+        change, so they may come from lines without records. */
+    uint64_t time;
+    uint32_t process;
+};
+
+class Stream_worker;
+
+/** Thread reading event and marker records of OTF trace.
+
+    Streams listed in the master control file are read whole, one
+    after another, with large sequential reads. Several streams are
+    read at once by worker threads; their number is limited by the
+    handle budget, so the file manager never has to suspend and
+    reopen files. Larger streams are scheduled first.
+
+    Decompression of .z streams and parsing happen in the worker
+    threads, which fill Record_ring with batches of decoded records.
+    The consumer builds the store at the same time, so the slow
+    inflate stage overlaps with block sealing and LOD updates. */
+class OTF_loader : public QThread
+{
+public:
+    static const int batch_size = 16384;
+
+    /** Files of one stream open at once: events and markers. */
+    static const int handles_per_stream = 2;
+
+    /** Records read from a stream between progress updates. */
+    static const int chunk_records = 65536;
+
+    OTF_loader(const QString& filename, Record_ring* ring);
+
+    /** @name Configuration. Must be set before start(). */
+    //@{
+    /** Size of OTF read buffers. */
+    void setBufferSizes(uint32_t buffer, uint32_t zbuffer);
+
+    /** Maximum number of files open at once. */
+    void setHandleBudget(int handles);
+    //@}
+
+    /** @name Statistics. */
+    //@{
+    uint64_t records() const;
+
+    /** Percentage of the stream files read so far. */
+    int progress() const;
+
+    /** Positions where reading of uncompressed files has stopped. */
+    std::vector<Tail_position> tailPositions() const;
+    int elapsed() const { return elapsed_; }
+    Io_counters counters() const;
+    //@}
+
+    /** Returns total size of the files of the trace. */
+    static qint64 traceSize(const QString& filename);
+
+protected:
+    void run();
+
+private:
+    /** Takes the next stream to read. Returns false if none left. */
+    bool nextStream(uint32_t& stream);
+    void streamDone(uint64_t records, int files);
+
+    /** Adds the reads of a worker thread. */
+    void addReads(uint64_t reads, uint64_t bytes);
+    void addProgress(uint64_t bytes);
+    void addTailPosition(const Tail_position& position);
+
+    /** Returns existing file of the stream with given suffix
+        ("events" or "marker"), plain or compressed, or empty string. */
+    QString streamFile(uint32_t stream, const QString& suffix) const;
+
+    QString filename_;
+    QString namestub_;
+    Record_ring* ring_;
+
+    uint32_t buffer_size_;
+    uint32_t zbuffer_size_;
+    int handle_budget_;
+
+    mutable QMutex mutex_;
+    std::deque<uint32_t> streams_;
+    Io_counters counters_;
+    uint64_t records_;
+    uint64_t total_bytes_;
+    uint64_t done_bytes_;
+    std::vector<Tail_position> tail_positions_;
+    int elapsed_;
+
+    friend class Stream_worker;
+};
+
+/** Reads records appended to the stream files of a trace that is
+    still being written.
+
+    Files are watched with QFileSystemWatcher, and only changed files
+    are read, from the position where the previous read stopped.
+    Compressed streams and streams created after the load can't be
+    followed. */
+class OTF_tail : public QObject
+{
+    Q_OBJECT
+public:
+    OTF_tail(const QString& filename, const std::vector<Tail_position>& positions);
+
+    /** Adds records appended since the last call to the store.
+        Returns true if any records were added. */
+    bool read(Trace_store& store);
+
+private slots:
+    void fileChanged(const QString& file);
+
+private:
+    QString namestub_;
+    std::vector<Tail_position> positions_;
+    QSet<int> changed_;
+    QFileSystemWatcher* watcher_;
+};
+
+}
+#endif
@@ -1 +1,97 @@
 #include "otf_main_window.h"
+#include "otf_trace_model.h"
+
+#include <QTimer>
+#include <QAction>
+#include <QProgressBar>
+#include <QStatusBar>
+#include <QSettings>
+
+namespace vis4 {
+
+    const int OTF_main_window::load_slice;
+    const int OTF_main_window::load_tick;
+
+    void OTF_main_window::startLoading(Canvas* canvas)
+    {
+        canvas_ = canvas;
+
+        OTF_trace_model* model = dynamic_cast<OTF_trace_model*>(canvas_->model().get());
+        if (!model)
+            return;
+
+        QSettings settings;
+        if (!settings.contains("otf/refresh_interval"))
+            settings.setValue("otf/refresh_interval", 1000);
+        refresh_interval_ = settings.value("otf/refresh_interval").toInt();
+
+        load_timer_ = new QTimer(this);
+        connect(load_timer_, SIGNAL( timeout() ), this, SLOT( loadTick() ));
+
+        QAction* follow = new QAction(tr("Follow"), this);
+        follow->setCheckable(true);
+        follow->setToolTip(tr("Follow the trace while it is written"));
+        follow->setWhatsThis(
+            tr("<b>Follow</b>"
+               "<p>Reads records appended to the trace files by a running "
+               "program. If the diagram shows the end of the trace, it is "
+               "scrolled to show the new records."));
+        connect(follow, SIGNAL( toggled(bool) ), this, SLOT( setFollowing(bool) ));
+        installFreestandingTool(follow);
+
+        if (!model->loading())
+            return;
+
+        progress_ = new QProgressBar(this);
+        progress_->setRange(0, 100);
+        progress_->setFormat(tr("Loading %p%"));
+        progress_->setMaximumWidth(200);
+        statusBar()->addPermanentWidget(progress_);
+
+        load_timer_->start(load_tick);
+        refresh_timer_.start();
+    }
+
+    void OTF_main_window::loadTick()
+    {
+        OTF_trace_model* model = dynamic_cast<OTF_trace_model*>(canvas_->model().get());
+        Q_ASSERT(model);
+
+        if (model->load(load_slice))
+            unpublished_ = true;
+
+        bool finished = progress_ && !model->loading();
+        if (progress_)
+            progress_->setValue(model->loadProgress());
+        if (finished)
+        {
+            statusBar()->removeWidget(progress_);
+            progress_->deleteLater();
+            progress_ = 0;
+        }
+
+        if (!model->loading() && !model->following())
+            load_timer_->stop();
+
+        if (finished || (unpublished_ && refresh_timer_.elapsed() >= refresh_interval_))
+        {
+            refresh_timer_.restart();
+            unpublished_ = false;
+            canvas_->refresh(model->publish());
+        }
+    }
+
+    void OTF_main_window::setFollowing(bool following)
+    {
+        OTF_trace_model* model = dynamic_cast<OTF_trace_model*>(canvas_->model().get());
+        Q_ASSERT(model);
+
+        model->setFollowing(following);
+        if (following && !load_timer_->isActive())
+        {
+            load_timer_->start(load_tick);
+            refresh_timer_.start();
+        }
+    }
+
+}
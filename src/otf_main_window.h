@@ -4,14 +4,28 @@
 #include "tools/tool.h"
 #include "main_window.h"
 
+#include <QTime>
+
+class QTimer;
+class QProgressBar;
+
 namespace vis4 {
 
     using namespace common;
 
     class OTF_main_window : public MainWindow
     {
+        Q_OBJECT
     public:
+        /** @name Incremental loading. */
+        //@{
+        /** Time spent adding records to the store per timer tick, ms. */
+        static const int load_slice = 40;
+        static const int load_tick = 50;
+        //@}
+
         OTF_main_window()
+        : canvas_(0), load_timer_(0), progress_(0), unpublished_(false)
         {
             setWindowTitle("Vis4");
         }
@@ -22,16 +36,47 @@ namespace vis4 {
 
             Browser* browser = createBrowser(toolContainer, canvas);
             installBrowser(browser);
-/*
-            installTool(createGoto(toolContainer, canvas));
-            installTool(createMeasure(toolContainer, canvas));
+
+            /* Components can be filtered while the trace is loading. */
             installTool(createFilter(toolContainer, canvas));
+            installTool(createProfile(toolContainer, canvas));
+            installTool(createCommunication(toolContainer, canvas));
+            installTool(createCriticalPath(toolContainer, canvas));
+            installTool(createWaitStates(toolContainer, canvas));
+            installTool(createMeasure(toolContainer, canvas));
+
             Tool* find = createFind(toolContainer, canvas);
             installTool(find);
             connect(find, SIGNAL(extraHelp(const QString&)),
                     browser, SLOT(extraHelp(const QString&)));
-                    */
+
+            /* Goto works only with times that fit into int, which OTF
+               ticks don't.
+            installTool(createGoto(toolContainer, canvas));
+            */
+
+            startLoading(canvas);
         }
+
+        /** Shows the progress bar and starts adding records to the
+            store, if the trace is still loading. Adds the follow
+            mode button. */
+        void startLoading(Canvas* canvas);
+
+    private slots:
+        /** Adds loaded records and redraws the trace once per
+            refresh interval. */
+        void loadTick();
+
+        void setFollowing(bool following);
+
+    private:
+        Canvas* canvas_;
+        QTimer* load_timer_;
+        QProgressBar* progress_;
+        QTime refresh_timer_;
+        int refresh_interval_;
+        bool unpublished_;
     };
 
 }
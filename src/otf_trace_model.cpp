@@ -1,26 +1,331 @@
 #include "otf_trace_model.h"
+#include "otf_loader.h"
+#include "checker.h"
+#include "wait_states.h"
+#include "part_workers.h"
 #include <QDebug>
+#include <QSettings>
+#include <QTime>
 
-#include <OTF_RBuffer.h>
+#include <algorithm>
+#include <limits>
+#include <math.h>
 
 namespace vis4 {
 
     using namespace common;
 
+    namespace {
+
+        const char event_letters[event_kinds_count] = { 'S', 'R', 'M' };
+
+        bool event_time_less(const Event_entry& a, const Event_entry& b)
+        {
+            return a.time < b.time;
+        }
+
+        /** Event records of a series read block by block, using block
+            descriptors taken before. */
+        class Entry_stream
+        {
+        public:
+            Entry_stream(Trace_store& store, int lifeline, Trace_store::Series series,
+                         const std::vector<Trace_store::Block>& blocks)
+            : store_(store), lifeline_(lifeline), series_(series), blocks_(blocks),
+              block_(0), index_(0), records_(0)
+            {}
+
+            /** Returns the current record, or 0 at the end. */
+            const Event_entry* peek()
+            {
+                if (records_ && index_ < blocks_[block_].count)
+                    return records_ + index_;
+
+                if (records_)
+                {
+                    ++block_;
+                    index_ = 0;
+                    records_ = 0;
+                    ref_ = Block_ref();
+                }
+                while (block_ < blocks_.size() && blocks_[block_].count == 0)
+                    ++block_;
+                if (block_ >= blocks_.size())
+                    return 0;
+
+                ref_ = store_.fetch(lifeline_, series_, block_, blocks_[block_]);
+                records_ = static_cast<const Event_entry*>(ref_.data());
+                return records_;
+            }
+
+            void pop() { ++index_; }
+
+        private:
+            Trace_store& store_;
+            int lifeline_;
+            Trace_store::Series series_;
+            const std::vector<Trace_store::Block>& blocks_;
+            unsigned block_;
+            unsigned index_;
+            Block_ref ref_;
+            const Event_entry* records_;
+        };
+
+        bool record_time_less(const Event_record& a, const Event_record& b)
+        {
+            return a.time < b.time;
+        }
+
+        bool entry_before(const Event_entry& e, uint64_t time)
+        {
+            return e.time < time;
+        }
+
+        bool block_ends_before(const Trace_store::Block& b, uint64_t time)
+        {
+            return b.end < time;
+        }
+
+        bool state_begins_before(const State_entry& a, const State_entry& b)
+        {
+            return a.begin < b.begin || (a.begin == b.begin && a.depth < b.depth);
+        }
+
+        bool message_sent_before(const Message_entry& a, const Message_entry& b)
+        {
+            return a.send_time < b.send_time;
+        }
+
+        bool wait_begins_before(const Wait_state& w, int64_t time)
+        {
+            return w.begin < time;
+        }
+
+        bool time_before_wait(int64_t time, const Wait_state& w)
+        {
+            return time < w.begin;
+        }
+
+        bool time_before_block(uint64_t time, const Trace_store::Block& b)
+        {
+            return time < b.begin;
+        }
+
+        /** Returns true if the block has events of the kinds. */
+        bool has_kinds(const Trace_store::Block_summary& summary, uint32_t kinds)
+        {
+            for (int kind = 0; kind < event_kinds_count; ++kind)
+                if ((kinds >> kind & 1) && summary.kinds[kind])
+                    return true;
+            return false;
+        }
+
+        /** Returns true if the block may have calls of the functions
+            begun within [min, max]. */
+        bool has_calls(const Trace_store::Block_summary& summary,
+                       const std::vector<unsigned char>& functions, uint64_t min, uint64_t max)
+        {
+            std::vector<Trace_store::Function_summary>::const_iterator f;
+            for (f = summary.functions.begin(); f != summary.functions.end(); ++f)
+                if (f->calls && f->function < functions.size() && functions[f->function]
+                    && f->first <= max && f->last >= min)
+                    return true;
+            return false;
+        }
+
+        /** Adds the calls of the block to the profile. */
+        void add_calls(std::map<uint32_t, Profile_entry>& functions,
+                       const Trace_store::Block_summary& summary)
+        {
+            std::vector<Trace_store::Function_summary>::const_iterator f;
+            for (f = summary.functions.begin(); f != summary.functions.end(); ++f)
+            {
+                Profile_entry& e = functions[f->function];
+                e.calls += f->calls;
+                e.inclusive += f->inclusive;
+                e.exclusive += f->exclusive;
+            }
+        }
+
+        /** Adds the calls overlapping [from, to] to the profile, with
+            the time within it. The caller of a call overlapping the
+            range overlaps it too, and loses the same time from its
+            exclusive time. */
+        void add_calls(std::map<uint32_t, Profile_entry>& functions,
+                       const State_entry* begin, const State_entry* end,
+                       uint64_t from, uint64_t to)
+        {
+            for (const State_entry* s = begin; s != end; ++s)
+            {
+                if (s->end < from || s->begin > to) continue;
+
+                int64_t time = std::min(s->end, to) - std::max(s->begin, from);
+                Profile_entry& e = functions[s->function];
+                ++e.calls;
+                if (!(s->flags & recursive_call))
+                    e.inclusive += time;
+                e.exclusive += time;
+                if (s->caller != no_function)
+                    functions[s->caller].exclusive -= time;
+            }
+        }
+
+        /** Returns the time of the sorted list within [min, max]
+            following after, or preceding it if forward is false, or 0.
+            order is the sign of comparison of the list key, the
+            component and type, with the key at after; times equal to
+            after are skipped. */
+        const uint64_t* find_time(const std::vector<uint64_t>& list, uint64_t min, uint64_t max,
+                                  const uint64_t* after, int order, bool forward)
+        {
+            std::vector<uint64_t>::const_iterator i;
+            if (forward)
+            {
+                if (!after || *after < min)
+                    i = std::lower_bound(list.begin(), list.end(), min);
+                else if (order > 0)
+                    i = std::lower_bound(list.begin(), list.end(), *after);
+                else
+                    i = std::upper_bound(list.begin(), list.end(), *after);
+
+                if (i == list.end() || *i > max) return 0;
+            }
+            else
+            {
+                if (!after || *after > max)
+                    i = std::upper_bound(list.begin(), list.end(), max);
+                else if (order < 0)
+                    i = std::upper_bound(list.begin(), list.end(), *after);
+                else
+                    i = std::lower_bound(list.begin(), list.end(), *after);
+
+                if (i == list.begin() || *--i < min) return 0;
+            }
+            return &*i;
+        }
+    }
+
+    OTF_trace_data::OTF_trace_data(size_t memory_budget)
+        : store(memory_budget), loading(false), following(false),
+          declared_range(false), min_time(0), max_time(0)
+    {
+    }
+
+    OTF_trace_data::~OTF_trace_data()
+    {
+        if (loader.get())
+        {
+            ring->cancel();
+            loader->wait();
+        }
+    }
+
+    bool OTF_trace_data::load(int msecs)
+    {
+        if (!loading)
+            return following && tail->read(store);
+
+        QTime timer;
+        timer.start();
+
+        bool added = false;
+        bool done = false;
+        Record_ring::Batch batch;
+        for (;;)
+        {
+            /* Checked before pop, so no batch is pushed between an
+               empty pop and the end of loading. */
+            bool finished = ring->finished();
+            if (!ring->pop(batch, msecs < 0))
+            {
+                done = finished || msecs < 0;
+                break;
+            }
+
+            apply_records(store, &batch[0], batch.size());
+            added = true;
+
+            if (msecs >= 0 && timer.elapsed() >= msecs) break;
+        }
+
+        if (done)
+        {
+            loader->wait();
+            loading = false;
+            store.flush();
+            publish();
+
+            if (following)
+                tail.reset(new OTF_tail(filename, loader->tailPositions()));
+
+            qDebug() << "read event records:" << (unsigned long long)loader->records()
+                     << "in" << loader->elapsed() << "ms";
+            qDebug() << "trace store: spilled" << (unsigned long long)store.cache().spilledBytes()
+                     << "bytes, resident" << (unsigned long long)store.cache().residentBytes();
+            if (store.spillFailed())
+                qWarning() << "trace store: the spill file failed, the memory budget is exceeded";
+        }
+
+        return added;
+    }
+
+    void OTF_trace_data::setFollowing(bool following)
+    {
+        this->following = following;
+
+        /* Positions of the loader are used once; after that the tail
+           keeps its own. */
+        if (following && !loading && !tail.get())
+            tail.reset(new OTF_tail(filename, loader->tailPositions()));
+    }
+
+    void OTF_trace_data::publish()
+    {
+        store.publish();
+        if (store.isEmpty()) return;
+
+        if (declared_range)
+        {
+            min_time = std::min(min_time, store.minTime());
+            max_time = std::max(max_time, store.maxTime());
+        }
+        else
+        {
+            min_time = store.minTime();
+            max_time = store.maxTime();
+        }
+    }
+
     OTF_trace_model:: OTF_trace_model(const QString& filename)
-        : min_time_(getTime(0))
+        : groups_enabled_(true), min_time_(getTime(0)), max_time_(getTime(0)),
+          lod_level_(-1), wait_kinds_(0)
     {
+        QSettings settings;
+        if (!settings.contains("trace_store/memory_budget"))
+            settings.setValue("trace_store/memory_budget", 512);
+        size_t budget = settings.value("trace_store/memory_budget").toULongLong() << 20;
+
+        data_.reset(new OTF_trace_data(budget));
+        data_->filename = filename;
+
+        initialize_component_list();
         states_.clear();
 
-        ha = (HandlerArgument){ 0 /* count */, parent_component_ /*parent */, &components_ /*components*/, 0, 0};
+        events_.clear();
+        events_.addItem("Send");
+        events_.addItem("Receive");
+        events_.addItem("Marker");
+
+        HandlerArgument ha = { data_.get(), &components_, &states_, root_component_ };
 
-        manager= OTF_FileManager_open( 100 );
-        assert( manager );
+        if (!settings.contains("otf/max_open_files"))
+            settings.setValue("otf/max_open_files", 64);
+        int handle_budget = settings.value("otf/max_open_files").toInt();
 
-        initialize();
-        max_time_ = getTime(100);
+        OTF_FileManager* manager = OTF_FileManager_open( handle_budget );
+        assert( manager );
 
-        handlers = OTF_HandlerArray_open();
+        OTF_HandlerArray* handlers = OTF_HandlerArray_open();
         assert( handlers );
 
         /* processes */
@@ -41,75 +346,70 @@ namespace vis4 {
         OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleDefMarker, OTF_DEFMARKER_RECORD );
         OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_DEFMARKER_RECORD );
 
-        /* for reading enter/leave functions */
-        OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleEnter, OTF_ENTER_RECORD );
-        OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_ENTER_RECORD );
-
-        OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleLeave, OTF_LEAVE_RECORD );
-        OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_LEAVE_RECORD );
-
-        /* for reading markers */
-        OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleMarker, OTF_MARKER_RECORD );
-        OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_MARKER_RECORD );
-
-        /* messages */
-        OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleSendMsg, OTF_SEND_RECORD );
-        OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_SEND_RECORD );
-
-        OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleRecvMsg, OTF_RECEIVE_RECORD );
-        OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_RECEIVE_RECORD );
+        OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*) handleDefTimeRange, OTF_DEFTIMERANGE_RECORD );
+        OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_DEFTIMERANGE_RECORD );
 
-        initialize_component_list();
-
-        reader = OTF_Reader_open( filename.toAscii().data(), manager );  // hello_world
+        OTF_Reader* reader = OTF_Reader_open( filename.toAscii().data(), manager );
         assert( reader );
 
-
-
         //       handlers
-        ret = OTF_Reader_readDefinitions( reader, handlers );
+        uint64_t ret = OTF_Reader_readDefinitions( reader, handlers );
+
+        OTF_Reader_close( reader );
+        OTF_HandlerArray_close( handlers );
+        OTF_FileManager_close( manager );
 
         //   Events
-        OTF_Reader_setRecordLimit(reader, 1);
-        OTF_Reader_readEvents( reader, handlers);
-        OTF_Reader_setRecordLimit(reader, 3);
-        OTF_Reader_readMarkers( reader, handlers);
+        // Records are decoded in the loader thread while this thread
+        // fills the store.
+        if (!settings.contains("otf/read_ahead"))
+            settings.setValue("otf/read_ahead", 64);
+        if (!settings.contains("otf/buffer_size"))
+            settings.setValue("otf/buffer_size", 1024);
+        if (!settings.contains("otf/zbuffer_size"))
+            settings.setValue("otf/zbuffer_size", 1024);
+
+        data_->ring.reset(new Record_ring(settings.value("otf/read_ahead").toInt()));
+        data_->loader.reset(new OTF_loader(filename, data_->ring.get()));
+        data_->loader->setBufferSizes(settings.value("otf/buffer_size").toUInt() << 10,
+                                      settings.value("otf/zbuffer_size").toUInt() << 10);
+        data_->loader->setHandleBudget(handle_budget);
+        data_->loader->start();
+        data_->loading = true;
+
+        /* Lifelines are known from the definitions. Records of
+           undefined processes are kept in the store, but not shown. */
+        const Trace_store& store = data_->store;
+        data_->lifeline_component.resize(store.lifelinesCount());
+        for (int l = 0; l < store.lifelinesCount(); ++l)
+            data_->lifeline_component[l] = data_->process_component[store.process(l)];
+
+        available_states_ = states_;
+        /* Without the declared range the first view is empty and
+           grows as records are published. */
+        min_time_ = getTime(data_->min_time);
+        max_time_ = getTime(std::max(data_->max_time, data_->min_time + 1));
+        adjust_components();
 
         qDebug() << "read definition records: " << (unsigned long long int)ret;
-        qDebug() << "countSend=" << ha.countSend << " countRecv=" << ha.countRecv;
     }
 
     OTF_trace_model::~OTF_trace_model()
     {
-        /*
-        OTF_Reader_close( reader );
-        OTF_HandlerArray_close( handlers );
-        OTF_FileManager_close( manager );
-        */
     }
 
 
     void OTF_trace_model:: initialize_component_list()
     {
         components_.clear();
-        int rootLink = components_.addItem("Stand", Selection::ROOT);
-        //components_.setItemProperty(rootLink, "ctlink", ComponentTree::ROOT);
-        //components_.setItemProperty(0, "current_parent", rootLink);
-        parent_component_ = rootLink;
-
-        //components_map_[ComponentTree::ROOT] = rootLink;
+        root_component_ = components_.addItem("Stand", Selection::ROOT);
+        parent_component_ = root_component_;
     }
 
 
     int OTF_trace_model:: parent_component() const
     {
         return parent_component_;
-#if 0
-        if (currentElement.tagName() == "component")
-            return currentElement.attribute("name");
-        else
-            return "";
-#endif
     }
 
 
@@ -120,8 +420,8 @@ namespace vis4 {
 
     int OTF_trace_model:: lifeline(int component) const
     {
-        if (!lifeline_map_.contains(component)) return -1;
-        return lifeline_map_[component];
+        if ((unsigned)component >= (unsigned)lifeline_table_.size()) return -1;
+        return lifeline_table_[component];
     }
 
     int OTF_trace_model:: component_type(int component) const
@@ -159,226 +459,1223 @@ namespace vis4 {
 
     Time OTF_trace_model::min_time() const { return min_time_; }
     Time OTF_trace_model::max_time() const { return max_time_; }
-    Time OTF_trace_model::min_resolution() const { return getTime(3); }
+    Time OTF_trace_model::min_resolution() const { return getTime(1); }
 
+    bool OTF_trace_model::loading() const
+    {
+        return data_->loading;
+    }
+
+    int OTF_trace_model::loadProgress() const
+    {
+        return data_->loading ? data_->loader->progress() : 100;
+    }
+
+    bool OTF_trace_model::load(int msecs)
+    {
+        return data_->load(msecs);
+    }
+
+    Trace_model::Ptr OTF_trace_model::publish()
+    {
+        uint64_t old_min = data_->min_time;
+        uint64_t old_max = data_->max_time;
+        data_->publish();
+
+        OTF_trace_model::Ptr n(new OTF_trace_model(*this));
+        bool at_end = ticks(max_time_) >= old_max;
+
+        if (ticks(min_time_) <= old_min)
+            n->min_time_ = getTime(data_->min_time);
+        else if (at_end && data_->following)
+        {
+            uint64_t width = ticks(max_time_) - ticks(min_time_);
+            n->min_time_ = getTime(data_->max_time - std::min(width, data_->max_time));
+        }
+
+        if (at_end)
+            n->max_time_ = getTime(data_->max_time);
+        return n;
+    }
+
+    bool OTF_trace_model::following() const
+    {
+        return data_->following;
+    }
+
+    void OTF_trace_model::setFollowing(bool following)
+    {
+        data_->setFollowing(following);
+    }
+
+
+    void OTF_trace_model::fill_event(Event_record& r, uint64_t time, uint32_t kind,
+                                     int component) const
+    {
+        r.time = time;
+        r.component = component;
+        r.kind = events_.itemTitle(kind);
+        r.letter = event_letters[kind];
+        r.subletter = '\0';
+        r.letter_position = (kind == receive_event) ?
+            Event_model::right_bottom : Event_model::right_top;
+        r.priority = (kind == marker_event) ? 1 : 0;
+    }
 
     void OTF_trace_model::rewind()
     {
-        currentItem.clear();
-        currentSubcomponent = -1;
+        min_ticks_ = ticks(min_time_);
+        max_ticks_ = ticks(max_time_);
+        lod_level_ = lodLevel();
 
-        allEvents.clear();
-        QMultiMap<Time, Event_model*> events;
+        state_lifeline_ = -1;
+        state_cursor_ = Series_cursor<State_entry>();
+        lod_state_bin_ = -1;
 
-        for(;;)
+        group_lifeline_ = -1;
+        group_cursor_ = Series_cursor<Message_entry>();
+
+        event_cursors_.clear();
+        if (lod_level_ == -1)
+        {
+            foreach (int l, lifelines_)
+            {
+                event_cursors_.push_back(Series_cursor<Event_entry>(
+                    &data_->store, l, Trace_store::events_series, min_ticks_, max_ticks_));
+                event_cursors_.push_back(Series_cursor<Event_entry>(
+                    &data_->store, l, Trace_store::markers_series, min_ticks_, max_ticks_));
+            }
+        }
+
+        events_window_.clear();
+        events_window_pos_ = 0;
+        events_window_end_ = min_ticks_;
+        events_window_width_ = (max_ticks_ - min_ticks_)/64 + 1;
+
+        lod_event_bin_ = -1;
+        lod_event_lifeline_ = 0;
+        lod_event_kind_ = 0;
+    }
+
+    int OTF_trace_model::next_states(State_record* records, int capacity)
+    {
+        Trace_store& store = data_->store;
+        int count = 0;
+
+        if (lod_level_ != -1)
+        {
+            /* Consecutive bins with the same dominant function are
+               shown as one state. */
+            const Trace_store::Lod_geometry& g = store.lodGeometry();
+            uint64_t width = g.width << lod_level_;
+
+            while (count < capacity)
+            {
+                int first, last;
+                if (state_lifeline_ != -1 && lodBins(lifelines_[state_lifeline_], first, last))
+                {
+                    if (lod_state_bin_ == -1) lod_state_bin_ = first;
+
+                    const std::vector<Lod_bin>& bins =
+                        store.lod(lifelines_[state_lifeline_]).level(lod_level_);
+
+                    while (lod_state_bin_ <= last && count < capacity)
+                    {
+                        int begin = lod_state_bin_;
+                        uint32_t function = bins[begin].dominant;
+                        while (lod_state_bin_ <= last && bins[lod_state_bin_].dominant == function)
+                            ++lod_state_bin_;
+
+                        if (function == no_function || !stateEnabled(function)) continue;
+
+                        State_record& r = records[count++];
+                        r.begin = g.origin + begin * width;
+                        r.end = g.origin + lod_state_bin_ * width;
+                        r.type = data_->function_state.value(function, -1);
+                        r.component = data_->lifeline_component.at(lifelines_[state_lifeline_]);
+                        r.color = stateColor(function).rgb();
+                    }
+                    if (lod_state_bin_ <= last) break;
+                }
+
+                if (state_lifeline_ + 1 >= lifelines_.size())
+                    break;
+                ++state_lifeline_;
+                lod_state_bin_ = -1;
+            }
+
+            return count;
+        }
+
+        while (count < capacity)
+        {
+            if (const State_entry* s = state_cursor_.next())
+            {
+                if (s->end < min_ticks_ || s->begin > max_ticks_) continue;
+                if (!stateEnabled(s->function)) continue;
+
+                State_record& r = records[count++];
+                r.begin = s->begin;
+                r.end = s->end;
+                r.type = data_->function_state.value(s->function, -1);
+                r.component = data_->lifeline_component.at(state_cursor_.lifeline());
+                r.color = stateColor(s->function).rgb();
+                continue;
+            }
+
+            if (state_lifeline_ + 1 >= lifelines_.size())
+                break;
+
+            state_cursor_ = Series_cursor<State_entry>(&store, lifelines_[++state_lifeline_],
+                Trace_store::states_series, min_ticks_, max_ticks_);
+        }
+
+        return count;
+    }
+
+    int OTF_trace_model::next_groups(Group_record* records, int capacity)
+    {
+        /* Arrows are not shown for zoomed out views. */
+        if (!groups_enabled_ || lod_level_ != -1) return 0;
+
+        Trace_store& store = data_->store;
+        int count = 0;
+
+        while (count < capacity)
+        {
+            if (const Message_entry* m = group_cursor_.next())
+            {
+                if (m->recv_time < min_ticks_ || m->send_time > max_ticks_) continue;
+
+                int to = m->receiver_lifeline;
+                if (to >= data_->lifeline_component.size()) continue;
+
+                int to_component = data_->lifeline_component.at(to);
+                if (lifeline(to_component) == -1) continue;
+
+                Group_record& r = records[count++];
+                r.type = Group_model::arrow;
+                r.from_component = data_->lifeline_component.at(group_cursor_.lifeline());
+                r.from_time = m->send_time;
+                r.to_component = to_component;
+                r.to_time = m->recv_time;
+                continue;
+            }
+
+            if (group_lifeline_ + 1 >= lifelines_.size())
+                break;
+
+            group_cursor_ = Series_cursor<Message_entry>(&store, lifelines_[++group_lifeline_],
+                Trace_store::messages_series, min_ticks_, max_ticks_);
+        }
+
+        return count;
+    }
+
+    int OTF_trace_model::next_events(Event_record* records, int capacity)
+    {
+        Trace_store& store = data_->store;
+        int count = 0;
+
+        if (lod_level_ != -1)
         {
-            std::auto_ptr<Event_model> e = next_event_unsorted();
+            /* One synthetic event per kind for each non-empty bin. Bins
+               are visited in time order. */
+            const Trace_store::Lod_geometry& g = store.lodGeometry();
+            uint64_t width = g.width << lod_level_;
+
+            int first, last;
+            if (lifelines_.isEmpty() || !lodBins(lifelines_[0], first, last))
+                return 0;
+            if (lod_event_bin_ == -1) lod_event_bin_ = first;
+
+            for (; lod_event_bin_ <= last; ++lod_event_bin_, lod_event_lifeline_ = 0)
+            {
+                for (; lod_event_lifeline_ < lifelines_.size(); ++lod_event_lifeline_, lod_event_kind_ = 0)
+                {
+                    int l = lifelines_[lod_event_lifeline_];
+                    const Lod_bin& bin = store.lod(l).level(lod_level_)[lod_event_bin_];
+
+                    while (lod_event_kind_ < event_kinds_count)
+                    {
+                        if (count == capacity) return count;
+
+                        int kind = lod_event_kind_++;
+                        uint32_t n = (kind == send_event) ? bin.sends :
+                            (kind == receive_event) ? bin.receives : bin.markers;
+
+                        if (n == 0 || !events_.isEnabled(kind)) continue;
+
+                        fill_event(records[count++], g.origin + lod_event_bin_ * width + width/2,
+                                   kind, data_->lifeline_component.at(l));
+                    }
+                }
+            }
+
+            return count;
+        }
+
+        while (count < capacity)
+        {
+            if (events_window_pos_ < events_window_.size())
+            {
+                const Event_entry& e = events_window_[events_window_pos_++];
+                fill_event(records[count++], e.time, e.kind,
+                           data_->lifeline_component.at(store.lifeline(e.process)));
+                continue;
+            }
+
+            if (!fillEventsWindow())
+                break;
+        }
+
+        return count;
+    }
+
+    std::auto_ptr<State_model> OTF_trace_model::next_state()
+    {
+        State_record s;
+        if (!next_states(&s, 1))
+            return std::auto_ptr<State_model>();
+
+        return make_state(s);
+    }
+
+    std::auto_ptr<Group_model> OTF_trace_model::next_group()
+    {
+        Group_record g;
+        if (!next_groups(&g, 1))
+            return std::auto_ptr<Group_model>();
+
+        std::auto_ptr<Group_model> r(new Group_model);
+        r->type = g.type;
+        r->points.resize(2);
+        r->points[0].component = g.from_component;
+        r->points[0].time = getTime(g.from_time);
+        r->points[1].component = g.to_component;
+        r->points[1].time = getTime(g.to_time);
+        return r;
+    }
+
+    std::auto_ptr<Event_model> OTF_trace_model::next_event()
+    {
+        Event_record e;
+        if (!next_events(&e, 1))
+            return std::auto_ptr<Event_model>();
+
+        return make_event(e);
+    }
+
+    int64_t OTF_trace_model::time_ticks(const Time& time) const
+    {
+        return boost::any_cast<long long>(time.raw());
+    }
+
+    Time OTF_trace_model::ticks_time(int64_t ticks) const
+    {
+        return getTime(ticks);
+    }
+
+    void OTF_trace_model::lifeline_events(int component, const Time& min, const Time& max,
+                                          QVector<Event_record>& records)
+    {
+        records.clear();
+
+        int shown = lifeline(component);
+        if (shown == -1) return;
+
+        Trace_store& store = data_->store;
+        uint64_t from = ticks(min), to = ticks(max);
+
+        /* Records of a store lifeline are sorted by time, and so are
+           the blocks of a series, so both are found by binary search. */
+        foreach (int l, lifelines_)
+        {
+            if (lifeline(data_->lifeline_component.at(l)) != shown) continue;
+
+            Trace_store::Series series[] = { Trace_store::events_series,
+                                             Trace_store::markers_series };
+            for (int s = 0; s < 2; ++s)
+            {
+                const std::vector<Trace_store::Block>& blocks = store.blocks(l, series[s]);
+                std::vector<Trace_store::Block>::const_iterator b =
+                    std::lower_bound(blocks.begin(), blocks.end(), from, block_ends_before);
+
+                for (; b != blocks.end() && b->begin <= to; ++b)
+                {
+                    Block_ref ref = store.fetch(l, series[s], b - blocks.begin());
+                    const Event_entry* begin = static_cast<const Event_entry*>(ref.data());
+                    const Event_entry* end = begin + b->count;
+
+                    for (const Event_entry* e = std::lower_bound(begin, end, from, entry_before);
+                         e != end && e->time <= to; ++e)
+                    {
+                        if (!events_.isEnabled(e->kind)) continue;
+
+                        Event_record r;
+                        fill_event(r, e->time, e->kind, data_->lifeline_component.at(l));
+                        records.push_back(r);
+                    }
+                }
+            }
+        }
+
+        std::stable_sort(records.begin(), records.end(), record_time_less);
+    }
+
+    bool OTF_trace_model::find_event(const Event_record* after, bool forward,
+                                     Event_record& found)
+    {
+        if (after && after->time < 0)
+        {
+            if (!forward) return false;
+            after = 0;
+        }
+
+        if (query_ || !rule_) return query_event(after, forward, found);
+        if (!events_.isEnabled(rule_->trigger)) return false;
+
+        uint64_t min = ticks(min_time_), max = ticks(max_time_);
+        uint64_t after_time = after ? after->time : 0;
+        bool any = false;
+
+        /* With a rule, only the violations of the trigger kind are found. */
+        const Rule_violations& v = rule_violations();
+        foreach (int l, lifelines_)
+        {
+            const std::vector<uint64_t>& list = v.lifelines[l];
+            if (list.empty()) continue;
+
+            Event_record r;
+            fill_event(r, after_time, rule_->trigger, data_->lifeline_component.at(l));
+            int order = !after ? 0 : find_order(*after, r) ? 1 : find_order(r, *after) ? -1 : 0;
+
+            const uint64_t* t = find_time(list, min, max, after ? &after_time : 0, order, forward);
+            if (!t) continue;
+
+            r.time = *t;
+            if (!any || (forward ? find_order(r, found) : find_order(found, r)))
+            {
+                found = r;
+                any = true;
+            }
+        }
+        return any;
+    }
+
+    bool OTF_trace_model::find_state(const State_record* after, bool forward,
+                                     State_record& found)
+    {
+        if (after && after->begin < 0)
+        {
+            if (!forward) return false;
+            after = 0;
+        }
+
+        if (wait_kinds_) return find_wait(after, forward, found);
+        return query_state(after, forward, found);
+    }
+
+    /* Finds scan the blocks with the filter of the model. Blocks that
+       can't hold a record closer than the one found already are skipped
+       by their descriptors and summaries, without fetching them. */
+    bool OTF_trace_model::query_event(const Event_record* after, bool forward,
+                                      Event_record& found)
+    {
+        Query_filter f = store_filter();
+        if (after && forward)
+            f.min_time = std::max(f.min_time, (uint64_t)after->time);
+        if (after && !forward)
+            f.max_time = std::min(f.max_time, (uint64_t)after->time);
+
+        Trace_store& store = data_->store;
+        std::vector<uint32_t> selected;
+        bool any = false;
+
+        foreach (int l, lifelines_)
+        {
+            int component = data_->lifeline_component.at(l);
+
+            Trace_store::Series series[] = { Trace_store::events_series,
+                                             Trace_store::markers_series };
+            for (int s = 0; s < 2; ++s)
+            {
+                const std::vector<Trace_store::Block>& blocks = store.blocks(l, series[s]);
+                const std::vector<Trace_store::Block_summary>& summaries =
+                    store.summaries(l, series[s]);
+
+                /* Blocks of events follow each other in time, so the
+                   first one is found by binary search. */
+                int count = (int)blocks.size();
+                int b = forward
+                    ? std::lower_bound(blocks.begin(), blocks.end(), f.min_time, block_ends_before)
+                      - blocks.begin()
+                    : std::upper_bound(blocks.begin(), blocks.end(), f.max_time, time_before_block)
+                      - blocks.begin() - 1;
+                for (; b >= 0 && b < count; b += forward ? 1 : -1)
+                {
+                    const Trace_store::Block& d = blocks[b];
+
+                    if (forward ? d.begin > f.max_time : d.end < f.min_time) break;
+                    if (any && (forward ? d.begin > (uint64_t)found.time
+                                        : d.end < (uint64_t)found.time))
+                        break;
+                    if (!has_kinds(summaries[b], f.kinds)) continue;
+
+                    Block_ref ref = store.fetch(l, series[s], b);
+                    const Event_entry* entries = static_cast<const Event_entry*>(ref.data());
+                    selected.resize(d.count);
+                    int n = select_events(f, entries, d.count, &selected[0]);
+
+                    for (int j = 0; j < n; ++j)
+                    {
+                        const Event_entry& e = entries[selected[j]];
+
+                        Event_record r;
+                        fill_event(r, e.time, e.kind, component);
+                        if (after && !(forward ? find_order(*after, r) : find_order(r, *after)))
+                            continue;
+                        if (!any || (forward ? find_order(r, found) : find_order(found, r)))
+                        {
+                            found = r;
+                            any = true;
+                        }
+                    }
+                }
+            }
+        }
+        return any;
+    }
+
+    bool OTF_trace_model::query_state(const State_record* after, bool forward,
+                                      State_record& found)
+    {
+        Query_filter f = store_filter();
+        uint64_t min = f.min_time, max = f.max_time;
+        if (after && forward)
+            min = std::max(min, (uint64_t)after->begin);
+        if (after && !forward)
+            max = std::min(max, (uint64_t)after->begin);
+
+        Trace_store& store = data_->store;
+        std::vector<uint32_t> selected;
+        bool any = false;
+
+        /* Blocks of states are ordered by the end of the calls, so the
+           blocks ended before the range are skipped by binary search,
+           and none of the others ends the scan. */
+        foreach (int l, lifelines_)
+        {
+            int component = data_->lifeline_component.at(l);
+
+            const std::vector<Trace_store::Block>& blocks =
+                store.blocks(l, Trace_store::states_series);
+            const std::vector<Trace_store::Block_summary>& summaries =
+                store.summaries(l, Trace_store::states_series);
+            for (unsigned b = std::lower_bound(blocks.begin(), blocks.end(), min, block_ends_before)
+                     - blocks.begin();
+                 b < blocks.size(); ++b)
+            {
+                const Trace_store::Block& d = blocks[b];
+                if (d.begin > max) continue;
+
+                /* Calls closer than the one found begin between it and after. */
+                uint64_t from = min, to = max;
+                if (any && forward) to = std::min(to, (uint64_t)found.begin);
+                if (any && !forward) from = std::max(from, (uint64_t)found.begin);
+                if (!has_calls(summaries[b], f.functions, from, to)) continue;
+
+                Block_ref ref = store.fetch(l, Trace_store::states_series, b);
+                const State_entry* entries = static_cast<const State_entry*>(ref.data());
+                selected.resize(d.count);
+                int n = select_states(f, entries, d.count, &selected[0]);
+
+                for (int j = 0; j < n; ++j)
+                {
+                    const State_entry& s = entries[selected[j]];
+                    if (s.begin < min || s.begin > max) continue;
+
+                    State_record r;
+                    r.begin = s.begin;
+                    r.end = s.end;
+                    r.component = component;
+                    r.type = data_->function_state.value(s.function, -1);
+                    r.color = stateColor(s.function).rgb();
+                    if (after && !(forward ? find_order(*after, r) : find_order(r, *after)))
+                        continue;
+                    if (!any || (forward ? find_order(r, found) : find_order(found, r)))
+                    {
+                        found = r;
+                        any = true;
+                    }
+                }
+            }
+        }
+        return any;
+    }
+
+    int OTF_trace_model::search_parts()
+    {
+        search_filter_ = store_filter();
+        search_parts_.resize(lifelines_.size());
+        for (int i = 0; i < lifelines_.size(); ++i)
+        {
+            Search_part& p = search_parts_[i];
+            p.lifeline = lifelines_[i];
+            for (int s = 0; s < Trace_store::series_count; ++s)
+                p.blocks[s] = data_->store.blocks(p.lifeline, (Trace_store::Series)s);
+        }
+
+        /* The wait states are merged here, in the GUI thread, and the
+           parts take copies, as they take the blocks. */
+        if (wait_kinds_)
+        {
+            const Wait_results& w = wait_results();
+            for (unsigned i = 0; i < search_parts_.size(); ++i)
+            {
+                Search_part& p = search_parts_[i];
+                p.waits.clear();
+                if (p.lifeline < (int)w.lifelines.size())
+                    p.waits = w.lifelines[p.lifeline];
+            }
+        }
+        return (int)search_parts_.size();
+    }
+
+    void OTF_trace_model::search_events(int part, Search_sink& sink)
+    {
+        const Search_part& p = search_parts_[part];
+        const Query_filter& f = search_filter_;
+        int component = data_->lifeline_component.at(p.lifeline);
+
+        const int batch_size = 256;
+        Event_record batch[batch_size];
+        int count = 0;
+        std::vector<uint32_t> selected;
+
+        if (rule_)
+        {
+            if (!events_.isEnabled(rule_->trigger)) return;
+
+            std::vector<Event_entry> violations;
+            check_rule(p, violations);
+
+            for (unsigned i = 0; i < violations.size(); ++i)
+            {
+                const Event_entry& e = violations[i];
+                if (e.time < f.min_time || e.time > f.max_time) continue;
+
+                fill_event(batch[count++], e.time, e.kind, component);
+                if (count == batch_size)
+                {
+                    if (sink.cancelled()) return;
+                    sink.found(batch, count);
+                    count = 0;
+                }
+            }
+
+            if (count) sink.found(batch, count);
+            return;
+        }
+
+        Trace_store::Series series[] = { Trace_store::events_series,
+                                         Trace_store::markers_series };
+        for (int s = 0; s < 2; ++s)
+        {
+            const std::vector<Trace_store::Block>& blocks = p.blocks[series[s]];
+            for (unsigned b = 0; b < blocks.size(); ++b)
+            {
+                if (blocks[b].end < f.min_time || blocks[b].begin > f.max_time) continue;
+                if (sink.cancelled()) return;
+
+                Block_ref ref = data_->store.fetch(p.lifeline, series[s], b, blocks[b]);
+                const Event_entry* entries = static_cast<const Event_entry*>(ref.data());
+                selected.resize(blocks[b].count);
+                int n = select_events(f, entries, blocks[b].count, &selected[0]);
+
+                for (int j = 0; j < n; ++j)
+                {
+                    const Event_entry& e = entries[selected[j]];
+                    fill_event(batch[count++], e.time, e.kind, component);
+                    if (count == batch_size)
+                    {
+                        sink.found(batch, count);
+                        count = 0;
+                    }
+                }
+            }
+        }
+
+        if (count) sink.found(batch, count);
+    }
+
+    void OTF_trace_model::search_states(int part, Search_sink& sink)
+    {
+        const Search_part& p = search_parts_[part];
+        const Query_filter& f = search_filter_;
+        int component = data_->lifeline_component.at(p.lifeline);
+
+        const int batch_size = 256;
+        State_record batch[batch_size];
+        int count = 0;
+        std::vector<uint32_t> selected;
+
+        if (wait_kinds_)
+        {
+            for (unsigned i = 0; i < p.waits.size(); ++i)
+            {
+                const Wait_state& w = p.waits[i];
+                if (!(wait_kinds_ & (1 << w.kind))) continue;
+                if (w.begin < (int64_t)f.min_time || w.begin > (int64_t)f.max_time) continue;
+
+                uint32_t function = data_->state_function.at(w.type);
+                if (!stateEnabled(function)) continue;
+
+                State_record& r = batch[count++];
+                r.begin = w.begin;
+                r.end = w.end;
+                r.type = w.type;
+                r.component = w.component;
+                r.color = stateColor(function).rgb();
+                if (count == batch_size)
+                {
+                    if (sink.cancelled()) return;
+                    sink.found(batch, count);
+                    count = 0;
+                }
+            }
+
+            if (count) sink.found(batch, count);
+            return;
+        }
+
+        const std::vector<Trace_store::Block>& blocks = p.blocks[Trace_store::states_series];
+        for (unsigned b = 0; b < blocks.size(); ++b)
+        {
+            if (blocks[b].end < f.min_time || blocks[b].begin > f.max_time) continue;
+            if (sink.cancelled()) return;
+
+            Block_ref ref = data_->store.fetch(p.lifeline, Trace_store::states_series, b, blocks[b]);
+            const State_entry* entries = static_cast<const State_entry*>(ref.data());
+            selected.resize(blocks[b].count);
+            int n = select_states(f, entries, blocks[b].count, &selected[0]);
+
+            for (int j = 0; j < n; ++j)
+            {
+                const State_entry& s = entries[selected[j]];
+
+                State_record& r = batch[count++];
+                r.begin = s.begin;
+                r.end = s.end;
+                r.type = data_->function_state.value(s.function, -1);
+                r.component = component;
+                r.color = stateColor(s.function).rgb();
+                if (count == batch_size)
+                {
+                    sink.found(batch, count);
+                    count = 0;
+                }
+            }
+        }
+
+        if (count) sink.found(batch, count);
+    }
+
+    void OTF_trace_model::profile(int part, std::vector<Profile_entry>& entries)
+    {
+        const Search_part& p = search_parts_[part];
+        uint64_t min = ticks(min_time_), max = ticks(max_time_);
+
+        /* Blocks of states are ordered by the end of the calls, and
+           the records of a block by begin, so the calls overlapping
+           the range are collected and sorted to see the parents
+           before their calls. */
+        std::vector<State_entry> calls;
+        const std::vector<Trace_store::Block>& blocks = p.blocks[Trace_store::states_series];
+        for (unsigned b = 0; b < blocks.size(); ++b)
+        {
+            if (blocks[b].end < min || blocks[b].begin > max) continue;
+
+            Block_ref ref = data_->store.fetch(p.lifeline, Trace_store::states_series, b, blocks[b]);
+            const State_entry* s = static_cast<const State_entry*>(ref.data());
+            for (const State_entry* end = s + blocks[b].count; s != end; ++s)
+                if (s->end >= min && s->begin <= max)
+                    calls.push_back(*s);
+        }
+        std::sort(calls.begin(), calls.end(), state_begins_before);
+
+        std::map<uint32_t, Profile_entry> functions;
+        std::vector<Profile_entry*> open;
+        for (unsigned i = 0; i < calls.size(); ++i)
+        {
+            const State_entry& s = calls[i];
+            int64_t time = std::min(s.end, max) - std::max(s.begin, min);
+
+            /* The last calls with smaller depths begun before are the
+               ones open around this call. A recursive call adds no
+               inclusive time, its outermost call covers it. */
+            if (open.size() <= s.depth)
+                open.resize(s.depth + 1, 0);
+
+            Profile_entry& e = functions[s.function];
+            bool recursive = std::find(open.begin(), open.begin() + s.depth, &e)
+                != open.begin() + s.depth;
+
+            if (e.calls == 0)
+                e.min = e.max = time;
+            ++e.calls;
+            if (!recursive)
+                e.inclusive += time;
+            e.exclusive += time;
+            e.min = std::min(e.min, time);
+            e.max = std::max(e.max, time);
+
+            if (s.depth > 0 && open[s.depth - 1])
+                open[s.depth - 1]->exclusive -= time;
+            open[s.depth] = &e;
+        }
+
+        int component = data_->lifeline_component.at(p.lifeline);
+        std::map<uint32_t, Profile_entry>::iterator i;
+        for (i = functions.begin(); i != functions.end(); ++i)
+        {
+            if (!stateEnabled(i->first)) continue;
+
+            Profile_entry e = i->second;
+            e.component = component;
+            e.type = data_->function_state.value(i->first, -1);
+            entries.push_back(e);
+        }
+    }
+
+    void OTF_trace_model::communication(int part, std::vector<Communication_entry>& entries)
+    {
+        const Search_part& p = search_parts_[part];
+        uint64_t min = ticks(min_time_), max = ticks(max_time_);
+        int sender = data_->lifeline_component.at(p.lifeline);
+
+        /* Index of the entry of each receiving lifeline. Few lifelines
+           get messages from one sender, so the row is kept sparse. */
+        std::map<int, int> row;
+
+        const std::vector<Trace_store::Block>& blocks = p.blocks[Trace_store::messages_series];
+        for (unsigned b = 0; b < blocks.size(); ++b)
+        {
+            if (blocks[b].end < min || blocks[b].begin > max) continue;
+
+            Block_ref ref = data_->store.fetch(p.lifeline, Trace_store::messages_series, b, blocks[b]);
+            const Message_entry* m = static_cast<const Message_entry*>(ref.data());
+            for (const Message_entry* end = m + blocks[b].count; m != end; ++m)
+            {
+                if (m->send_time < min || m->send_time > max) continue;
+
+                int to = m->receiver_lifeline;
+                if (to >= data_->lifeline_component.size()) continue;
+                if (lifeline(data_->lifeline_component.at(to)) == -1) continue;
+
+                std::map<int, int>::iterator i = row.find(to);
+                if (i == row.end())
+                {
+                    Communication_entry e = { sender, data_->lifeline_component.at(to), 0, 0, { 0 } };
+                    i = row.insert(std::make_pair(to, (int)entries.size())).first;
+                    entries.push_back(e);
+                }
+
+                Communication_entry& e = entries[i->second];
+                ++e.messages;
+                e.bytes += m->length;
+                ++e.latency[latency_bin(m->recv_time - m->send_time)];
+            }
+        }
+    }
+
+    void OTF_trace_model::critical_path_part(int part, Path_part& data)
+    {
+        const Search_part& p = search_parts_[part];
+        uint64_t min = ticks(min_time_), max = ticks(max_time_);
+        int component = data_->lifeline_component.at(p.lifeline);
+        Trace_store& store = data_->store;
+
+        const std::vector<Trace_store::Block>& messages = p.blocks[Trace_store::messages_series];
+        for (unsigned b = 0; b < messages.size(); ++b)
+        {
+            if (messages[b].end < min || messages[b].begin > max) continue;
+
+            Block_ref ref = store.fetch(p.lifeline, Trace_store::messages_series, b, messages[b]);
+            const Message_entry* m = static_cast<const Message_entry*>(ref.data());
+            for (const Message_entry* end = m + messages[b].count; m != end; ++m)
+            {
+                if (m->send_time < min || m->recv_time > max) continue;
+
+                int to = m->receiver_lifeline;
+                if (to >= data_->lifeline_component.size()) continue;
+                if (lifeline(data_->lifeline_component.at(to)) == -1) continue;
 
-            Event_model* ep = e.release();
+                Path_message e = { component, data_->lifeline_component.at(to),
+                                   (int64_t)m->send_time, (int64_t)m->recv_time };
+                data.messages.push_back(e);
+            }
+        }
 
-            if (!ep)
-                break;
+        /* All calls are taken, including those of the hidden states,
+           since a receive waits within its call whether it is shown
+           or not. */
+        std::vector<State_entry> calls;
+        const std::vector<Trace_store::Block>& states = p.blocks[Trace_store::states_series];
+        for (unsigned b = 0; b < states.size(); ++b)
+        {
+            if (states[b].end < min || states[b].begin > max) continue;
 
-            events.insert(ep->time, ep);
+            Block_ref ref = store.fetch(p.lifeline, Trace_store::states_series, b, states[b]);
+            const State_entry* s = static_cast<const State_entry*>(ref.data());
+            for (const State_entry* end = s + states[b].count; s != end; ++s)
+                if (s->end >= min && s->begin <= max)
+                    calls.push_back(*s);
         }
+        std::sort(calls.begin(), calls.end(), state_begins_before);
 
-        for(QMultiMap<Time, Event_model*>::iterator i = events.begin(),
-                e = events.end(); i != e; ++i)
+        for (unsigned i = 0; i < calls.size(); ++i)
         {
-            allEvents.push_back(i.value());
+            Path_call c = { component, data_->function_state.value(calls[i].function, -1),
+                            (int64_t)calls[i].begin, (int64_t)calls[i].end };
+            data.calls.push_back(c);
         }
-        currentEvent = 0;
+    }
 
-        currentItem.clear();
-        currentSubcomponent = -1;
+    void OTF_trace_model::wait_part(int part, Wait_part& data)
+    {
+        collect_waits(search_parts_[part], ticks(min_time_), ticks(max_time_), data);
     }
 
-    std::auto_ptr<State_model> OTF_trace_model::next_state()
+    void OTF_trace_model::lifeline_waits(int part, std::map<int, Wait_part>& parts)
     {
-        for(;;)
+        const Search_part& p = search_parts_[part];
+        collect_waits(p, 0, ~(uint64_t)0, parts[p.lifeline]);
+    }
+
+    void OTF_trace_model::collect_waits(const Search_part& p, uint64_t min, uint64_t max,
+                                        Wait_part& data) const
+    {
+        int component = data_->lifeline_component.at(p.lifeline);
+        Trace_store& store = data_->store;
+
+        /* Message blocks are sorted within themselves only. */
+        std::vector<Message_entry> messages;
+        const std::vector<Trace_store::Block>& message_blocks =
+            p.blocks[Trace_store::messages_series];
+        for (unsigned b = 0; b < message_blocks.size(); ++b)
         {
-            findNextItem("states");
+            if (message_blocks[b].begin > max) continue;
+
+            Block_ref ref = store.fetch(p.lifeline, Trace_store::messages_series,
+                                        b, message_blocks[b]);
+            const Message_entry* m = static_cast<const Message_entry*>(ref.data());
+            for (const Message_entry* end = m + message_blocks[b].count; m != end; ++m)
+                if (m->recv_time >= min && m->recv_time <= max)
+                    messages.push_back(*m);
+        }
+        std::stable_sort(messages.begin(), messages.end(), message_sent_before);
 
-            if (currentItem.isNull())
-                return std::auto_ptr<State_model>();
+        /* Calls are needed from the first send on. Earlier calls of
+           collectives are only counted. */
+        uint64_t first = messages.empty() ? min : std::min(min, messages.front().send_time);
 
-            int component = visible_components_[currentSubcomponent];
-            QString state_name = currentItem.attribute("name").toAscii().data();
+        std::vector<State_entry> calls;
+        std::map<uint32_t, int64_t> numbers;
+        const QSet<uint32_t>& collective = data_->collective_functions;
+        const std::vector<Trace_store::Block>& state_blocks = p.blocks[Trace_store::states_series];
+        for (unsigned b = 0; b < state_blocks.size(); ++b)
+        {
+            if (state_blocks[b].begin > max) continue;
 
-            int sparent = states_.itemLink(0, Selection::ROOT);
-            while (states_.itemProperty(sparent, "component").toInt() != component)
+            Block_ref ref = store.fetch(p.lifeline, Trace_store::states_series, b, state_blocks[b]);
+            const State_entry* s = static_cast<const State_entry*>(ref.data());
+            for (const State_entry* end = s + state_blocks[b].count; s != end; ++s)
             {
-                int index = states_.itemIndex(sparent);
-                Q_ASSERT(index+1 < states_.itemsCount());
-                sparent = states_.itemLink(index+1, Selection::ROOT);
+                if (s->begin > max) continue;
+
+                if (s->end >= first)
+                    calls.push_back(*s);
+                else if (collective.contains(s->function))
+                    ++numbers[s->function];
             }
+        }
+        std::sort(calls.begin(), calls.end(), state_begins_before);
+
+        std::vector<Wait_call> wait_calls;
+        for (unsigned i = 0; i < calls.size(); ++i)
+        {
+            const State_entry& s = calls[i];
+            Wait_call c = { component, data_->function_state.value(s.function, -1),
+                            (int64_t)s.begin, (int64_t)s.end };
+            wait_calls.push_back(c);
 
-            int state_id = states_.itemLink(state_name, sparent);
-            Q_ASSERT(state_id != -1);
+            if (collective.contains(s.function))
+            {
+                Wait_collective w = { numbers[s.function]++, c };
+                data.collectives.push_back(w);
+            }
+        }
 
-            if (!states_.isEnabled(sparent)) continue;
-            if (!states_.isEnabled(state_id)) continue;
+        Call_stack senders(component, wait_calls);
+        for (unsigned i = 0; i < messages.size(); ++i)
+        {
+            const Message_entry& m = messages[i];
+            int to = m.receiver_lifeline;
+            if (to >= data_->lifeline_component.size()) continue;
+
+            Wait_message w = { data_->lifeline_component.at(to),
+                               (int64_t)m.send_time, (int64_t)m.recv_time,
+                               senders.at(m.send_time) };
+            data.messages.push_back(w);
+        }
 
-            std::auto_ptr<State_model> r(new State_model);
+        /* Receives are in the events series, in the order of time. */
+        Call_stack receivers(component, wait_calls);
+        const std::vector<Trace_store::Block>& event_blocks = p.blocks[Trace_store::events_series];
+        for (unsigned b = 0; b < event_blocks.size(); ++b)
+        {
+            if (event_blocks[b].end < min || event_blocks[b].begin > max) continue;
 
-            r->begin = getTime(currentItem.attribute("begin").toInt());
-            r->end = getTime(currentItem.attribute("end").toInt());
-            r->component = component;
-            r->type = state_id;
-            r->color = Qt::yellow;
+            Block_ref ref = store.fetch(p.lifeline, Trace_store::events_series, b, event_blocks[b]);
+            const Event_entry* e = static_cast<const Event_entry*>(ref.data());
+            for (const Event_entry* end = e + event_blocks[b].count; e != end; ++e)
+            {
+                if (e->kind != receive_event || e->time < min || e->time > max) continue;
 
-            return r;
+                Wait_receive r = { (int64_t)e->time, receivers.at(e->time) };
+                data.receives.push_back(r);
+            }
         }
     }
 
-    std::auto_ptr<Group_model> OTF_trace_model:: next_group()
+    bool OTF_trace_model::activity(int bins, std::vector<Activity_bin>& activity)
     {
-        if (!groups_enabled_) return std::auto_ptr<Group_model>();
-
-        for(;;)
+        Activity_bin empty = { 0, 0, -1, 0 };
+        activity.assign(bins > 0 ? bins : 0, empty);
+
+        const Trace_store& store = data_->store;
+        const Trace_store::Lod_geometry& g = store.lodGeometry();
+        uint64_t min = ticks(min_time_), max = ticks(max_time_);
+        if (bins <= 0 || lifelines_.isEmpty() || max <= min)
+            return true;
+
+        double bin_width = double(max - min) / bins;
+        int levels = store.lod(lifelines_[0]).levels();
+        int level = 0;
+        while (level+1 < levels && double(g.width << (level+1)) <= bin_width)
+            ++level;
+
+        uint64_t width = g.width << level;
+        int count = (int)store.lod(lifelines_[0]).level(level).size();
+        if (max < g.origin) return true;
+
+        uint64_t from = min > g.origin ? (min - g.origin) / width : 0;
+        uint64_t to = (max - g.origin) / width;
+        if (from >= (uint64_t)count) return true;
+        int first = (int)from;
+        int last = to < (uint64_t)count ? (int)to : count-1;
+
+        bool markers = events_.isEnabled(marker_event);
+        bool sends = events_.isEnabled(send_event);
+        bool receives = events_.isEnabled(receive_event);
+
+        std::vector<uint64_t> dominant_time(bins, 0);
+        std::vector<uint32_t> dominant(bins, no_function);
+
+        foreach (int l, lifelines_)
         {
-            findNextItem("groups");
-
-            if (currentItem.isNull())
+            const std::vector<Lod_bin>& lod = store.lod(l).level(level);
+            for (int b = first; b <= last; ++b)
             {
-                return std::auto_ptr<Group_model>();
-            }
-            else
-            {
-                std::auto_ptr<Group_model> r(new Group_model);
-
-                r->type = Group_model::arrow;
-                r->points.resize(2);
-                r->points[0].component = visible_components_[currentSubcomponent];
-                r->points[0].time = getTime(
-                    currentItem.attribute("time").toInt());
-                r->points[1].time = getTime(
-                    currentItem.attribute("target_time").toInt());
-
-                QString to_component_s =
-                    currentItem.attribute("target_component");
-
-                int to_component = -1;
-                for(unsigned i = 0; i < subcomponents.size(); ++i)
+                const Lod_bin& bin = lod[b];
+                bool state = bin.dominant != no_function && stateEnabled(bin.dominant);
+                double events = markers ? bin.markers : 0;
+                double messages = (sends ? bin.sends : 0) + (receives ? bin.receives : 0);
+                if (!state && events == 0 && messages == 0) continue;
+
+                /* Position of the pyramid bin in activity bins. */
+                uint64_t begin = g.origin + b * width;
+                double x0 = ((double)begin - (double)min) / bin_width;
+                double x1 = x0 + width / bin_width;
+                int p0 = x0 > 0 ? (int)x0 : 0;
+                int p1 = x1 < bins ? (int)ceil(x1) - 1 : bins - 1;
+
+                for (int p = p0; p <= p1; ++p)
                 {
-                    if (to_component_s == subcomponents[i].attribute("name"))
+                    double share = (qMin(x1, p + 1.0) - qMax(x0, (double)p)) / (x1 - x0);
+                    activity[p].events += events * share;
+                    activity[p].messages += messages * share;
+
+                    if (state && bin.dominant_time > dominant_time[p])
                     {
-                        to_component = i;
-                        break;
+                        dominant_time[p] = bin.dominant_time;
+                        dominant[p] = bin.dominant;
                     }
                 }
-                if (to_component != -1)
-                {
-                    r->points[1].component = visible_components_[to_component];
-                    return r;
-                }
             }
         }
-    }
 
-    std::auto_ptr<Event_model> OTF_trace_model:: next_event_unsorted()
-    {
-        Time time;
-        for(;;)
+        for (int p = 0; p < bins; ++p)
         {
-            findNextItem("events");
+            if (dominant[p] == no_function) continue;
+            activity[p].state = data_->function_state.value(dominant[p], -1);
+            activity[p].color = stateColor(dominant[p]).rgb();
+        }
 
-            if (currentItem.isNull())
-                break;
+        return true;
+    }
 
-            time = getTime(currentItem.attribute("time").toInt());
+    bool OTF_trace_model::range_profile(int component, const Time& min, const Time& max,
+                                        std::vector<Profile_entry>& entries)
+    {
+        int shown = lifeline(component);
+        if (shown == -1) return true;
 
-            QString kind_att = currentItem.attribute("kind");
-            bool allowed_kind = false;
-            if (kind_att.isEmpty())
-            {
-                allowed_kind = true;
-            }
-            else
+        uint64_t from = ticks(min), to = ticks(max);
+        Trace_store& store = data_->store;
+        std::map<uint32_t, Profile_entry> functions;
+
+        foreach (int l, lifelines_)
+        {
+            if (lifeline(data_->lifeline_component.at(l)) != shown) continue;
+
+            /* Blocks of states are ordered by the end of the calls.
+               Blocks within the range are added from their summaries,
+               only the ones crossing its ends are read. */
+            const std::vector<Trace_store::Block>& blocks =
+                store.blocks(l, Trace_store::states_series);
+            const std::vector<Trace_store::Block_summary>& summaries =
+                store.summaries(l, Trace_store::states_series);
+            for (unsigned b = std::lower_bound(blocks.begin(), blocks.end(), from, block_ends_before)
+                     - blocks.begin();
+                 b < blocks.size(); ++b)
             {
-                foreach(int event, events_.items())
+                const Trace_store::Block& d = blocks[b];
+                if (d.begin > to) continue;
+
+                if (d.begin >= from && d.end <= to)
                 {
-                    if (events_.item(event) == kind_att)
-                    {
-                        allowed_kind = events_.isEnabled(event);
-                        break;
-                    }
+                    add_calls(functions, summaries[b]);
+                    continue;
                 }
+
+                Block_ref ref = store.fetch(l, Trace_store::states_series, b);
+                const State_entry* entries = static_cast<const State_entry*>(ref.data());
+                add_calls(functions, entries, entries + d.count, from, to);
             }
 
-            if (time >= min_time_ && time <= max_time_ && allowed_kind)
-                break;
+            /* Calls made from the running ones were taken from their
+               exclusive time, so the running calls count too. */
+            const std::vector<State_entry>& open = store.openStates(l);
+            if (!open.empty())
+                add_calls(functions, &open[0], &open[0] + open.size(), from, to);
         }
 
-        if (currentItem.isNull())
-            return std::auto_ptr<Event_model>();
-        else
+        std::map<uint32_t, Profile_entry>::iterator i;
+        for (i = functions.begin(); i != functions.end(); ++i)
         {
-            std::auto_ptr<Event_model> r(new Event_model);
-
-            r->time = time;
-            r->letter = currentItem.attribute("letter")[0].toAscii();
-            if (currentItem.hasAttribute("subletter"))
-                r->subletter = currentItem.attribute("subletter")[0].toAscii();
-            else
-                r->subletter = '\0';
-            if (currentItem.hasAttribute("position"))
-            {
-                QString p = currentItem.attribute("position");
-                if (p == "left_top")
-                    r->letter_position = Event_model::left_top;
-                else if (p == "right_top")
-                    r->letter_position = Event_model::right_top;
-                else if (p == "left_bottom")
-                    r->letter_position = Event_model::left_bottom;
-                else if (p == "right_bottom")
-                    r->letter_position = Event_model::right_bottom;
-            }
-            else
-                r->letter_position = Event_model::right_top;
-
-            if (currentItem.hasAttribute("priority"))
-                r->priority = currentItem.attribute("priority").toInt();
-            else
-                r->priority = 0;
+            if (!i->second.calls || !stateEnabled(i->first)) continue;
 
-            r->kind = currentItem.attribute("kind").toAscii().data();
-            r->component = visible_components_[currentSubcomponent];
-
-            return r;
+            Profile_entry e = i->second;
+            e.component = component;
+            e.type = data_->function_state.value(i->first, -1);
+            e.min = e.max = -1;
+            entries.push_back(e);
         }
+        return true;
     }
 
-    std::auto_ptr<Event_model> OTF_trace_model::next_event()
+    bool OTF_trace_model::range_statistics(int component, const Time& min, const Time& max,
+                                           Range_statistics& statistics)
     {
-        if (currentEvent >= allEvents.count())
-        {
-            return std::auto_ptr<Event_model>();
-        }
-        else
+        statistics.component = component;
+        statistics.events.clear();
+        statistics.states.clear();
+        statistics.messages = statistics.bytes = 0;
+
+        int shown = lifeline(component);
+        if (shown == -1) return true;
+
+        uint64_t from = ticks(min), to = ticks(max);
+        Trace_store& store = data_->store;
+        foreach (int l, lifelines_)
         {
-            return std::auto_ptr<Event_model>(allEvents[currentEvent++]);
+            if (lifeline(data_->lifeline_component.at(l)) != shown) continue;
+
+            /* Blocks within the range are counted by their summaries,
+               only the ones crossing its ends are read. */
+            Trace_store::Series series[] = { Trace_store::events_series,
+                                             Trace_store::markers_series };
+            for (int s = 0; s < 2; ++s)
+            {
+                const std::vector<Trace_store::Block>& blocks = store.blocks(l, series[s]);
+                const std::vector<Trace_store::Block_summary>& summaries =
+                    store.summaries(l, series[s]);
+                std::vector<Trace_store::Block>::const_iterator b =
+                    std::lower_bound(blocks.begin(), blocks.end(), from, block_ends_before);
+                for (; b != blocks.end() && b->begin <= to; ++b)
+                {
+                    const Trace_store::Block_summary& summary = summaries[b - blocks.begin()];
+                    if (b->begin >= from && b->end <= to)
+                    {
+                        for (int kind = 0; kind < event_kinds_count; ++kind)
+                            if (summary.kinds[kind] && events_.isEnabled(kind))
+                                statistics.events[kind] += summary.kinds[kind];
+                        continue;
+                    }
+
+                    Block_ref ref = store.fetch(l, series[s], b - blocks.begin());
+                    const Event_entry* begin = static_cast<const Event_entry*>(ref.data());
+                    const Event_entry* end = begin + b->count;
+                    for (const Event_entry* e = std::lower_bound(begin, end, from, entry_before);
+                         e != end && e->time <= to; ++e)
+                        if (events_.isEnabled(e->kind))
+                            ++statistics.events[e->kind];
+                }
+            }
+
+            /* Messages are stored as they are matched, so their blocks
+               follow no order. */
+            const std::vector<Trace_store::Block>& blocks =
+                store.blocks(l, Trace_store::messages_series);
+            const std::vector<Trace_store::Block_summary>& summaries =
+                store.summaries(l, Trace_store::messages_series);
+            for (unsigned b = 0; b < blocks.size(); ++b)
+            {
+                const Trace_store::Block_summary& summary = summaries[b];
+                if (summary.first > to || summary.last < from) continue;
+                if (summary.first >= from && summary.last <= to)
+                {
+                    statistics.messages += blocks[b].count;
+                    statistics.bytes += summary.bytes;
+                    continue;
+                }
+
+                Block_ref ref = store.fetch(l, Trace_store::messages_series, b);
+                const Message_entry* entries = static_cast<const Message_entry*>(ref.data());
+                for (const Message_entry* m = entries; m != entries + blocks[b].count; ++m)
+                {
+                    if (m->send_time < from || m->send_time > to) continue;
+                    ++statistics.messages;
+                    statistics.bytes += m->length;
+                }
+            }
         }
+
+        return range_profile(component, min, max, statistics.states);
     }
 
     Trace_model::Ptr OTF_trace_model::root()
     {
         OTF_trace_model::Ptr n(new OTF_trace_model(*this));
-        n->currentElement = root_;
-        n->parent_component_ = Selection::ROOT;
+        n->parent_component_ = root_component_;
 
-        n->min_time_ = getTime(0);
-        QString max_time_at = n->currentElement.attribute("max_time");
-        if (max_time_at.isEmpty())
-        {
-            n->max_time_ = max_time_;
-        }
-        else
-        {
-            n->max_time_ = getTime(max_time_at.toInt());
-        }
+        n->min_time_ = getTime(data_->min_time);
+        n->max_time_ = getTime(data_->max_time);
 
         n->events_.enableAll(Selection::ROOT, true);
+        n->events_changed();
         n->adjust_components();
 
         return n;
@@ -386,56 +1683,10 @@ namespace vis4 {
 
     Trace_model::Ptr OTF_trace_model::set_parent_component(int component)
     {
-        
         if (parent_component_ == component)
             return shared_from_this();
 
-        if (component == Selection::ROOT)
-        {
-            OTF_trace_model::Ptr n(new OTF_trace_model(*this));
-            n->currentElement = root_;
-            n->parent_component_ = Selection::ROOT;
-            n->adjust_components();
-            return n;
-        }
-
-        if (component == components_.itemParent(parent_component_))
-        {
-            OTF_trace_model::Ptr n(new OTF_trace_model(*this));
-            n->currentElement = currentElement.parentNode().toElement();
-            n->parent_component_ = component;
-            n->adjust_components();
-            return n;
-        }
-
-        if (components_.itemParent(component) == parent_component_)
-        {
-            OTF_trace_model::Ptr n(new OTF_trace_model(*this));
-
-            QDomNodeList subcomponents = currentElement.childNodes();
-            n->currentElement = subcomponents.at(components_.itemIndex(component)).toElement();
-
-            n->parent_component_ = component;
-            n->adjust_components();
-            return n;
-        }
-
         OTF_trace_model::Ptr n(new OTF_trace_model(*this));
-
-        QList<int> parents; parents << component;
-        while (parents.front() != component)
-            parents.prepend(components_.itemParent(component));
-        parents.pop_front();
-
-        n->currentElement = root_;
-        while (!parents.isEmpty())
-        {
-            int component = parents.first();
-
-            QDomNodeList subcomponents = currentElement.childNodes();
-            currentElement = subcomponents.at(components_.itemIndex(component)).toElement();
-        }
-
         n->parent_component_ = component;
         n->adjust_components();
         return n;
@@ -458,6 +1709,7 @@ namespace vis4 {
     {
         OTF_trace_model::Ptr n(new OTF_trace_model(*this));
         n->components_ = filter;
+        n->components_changed();
         n->adjust_components();
         return n;
     }
@@ -481,35 +1733,314 @@ namespace vis4 {
     {
         OTF_trace_model::Ptr n(new OTF_trace_model(*this));
         n->states_ = filter;
-        //n->adjust_components();
+        n->states_changed();
         return n;
     }
 
     Trace_model::Ptr OTF_trace_model::install_checker(Checker * checker)
     {
-        return shared_from_this();
+        const Query* query = checker ? checker->query() : 0;
+        const Rule* rule = checker ? checker->rule() : 0;
+        int wait_kinds = checker ? checker->wait_kinds() : 0;
+        if (!query && !query_ && !rule && !rule_ && !wait_kinds && !wait_kinds_)
+            return shared_from_this();
+
+        OTF_trace_model::Ptr n(new OTF_trace_model(*this));
+        n->query_.reset();
+        n->rule_.reset();
+        n->violations_.reset();
+
+        /* The wait states don't depend on the kinds, so they are kept
+           while the checker changes them. */
+        n->wait_kinds_ = wait_kinds;
+        if (!wait_kinds)
+            n->waits_.reset();
+        else if (!n->waits_)
+            n->waits_.reset(new Wait_results());
+        if (rule)
+        {
+            n->rule_.reset(new Rule(*rule));
+            n->violations_.reset(new Rule_violations());
+        }
+        if (query)
+        {
+            n->query_.reset(new Query_filter(query->filter()));
+
+            std::vector<unsigned char>& functions = n->query_->functions;
+            QHash<uint32_t, int>::const_iterator i;
+            for (i = data_->function_state.constBegin(); i != data_->function_state.constEnd(); ++i)
+            {
+                if (functions.size() <= i.key())
+                    functions.resize(i.key() + 1, 0);
+                functions[i.key()] = query->matchesFunction(states_.item(i.value()));
+            }
+        }
+        n->events_changed();
+        n->states_changed();
+        return n;
+    }
+
+    void OTF_trace_model::check_rule(const Search_part& p,
+                                     std::vector<Event_entry>& violations) const
+    {
+        Trace_store& store = data_->store;
+        bool messages = rule_->match == Rule::peer_process;
+
+        /* Receives of the messages sent by the lifeline come from the
+           messages series, which is sorted by sends. */
+        std::vector<Event_entry> receives;
+        if (messages)
+        {
+            const std::vector<Trace_store::Block>& blocks = p.blocks[Trace_store::messages_series];
+            for (unsigned b = 0; b < blocks.size(); ++b)
+            {
+                Block_ref ref = store.fetch(p.lifeline, Trace_store::messages_series, b, blocks[b]);
+                const Message_entry* m = static_cast<const Message_entry*>(ref.data());
+                for (const Message_entry* end = m + blocks[b].count; m != end; ++m)
+                {
+                    Event_entry r = { m->recv_time, m->receiver, receive_event,
+                                      m->sender, m->tag, m->length, 0 };
+                    receives.push_back(r);
+                }
+            }
+            std::stable_sort(receives.begin(), receives.end(), event_time_less);
+        }
+
+        Entry_stream events(store, p.lifeline, Trace_store::events_series,
+                            p.blocks[Trace_store::events_series]);
+        Entry_stream markers(store, p.lifeline, Trace_store::markers_series,
+                             p.blocks[Trace_store::markers_series]);
+        std::vector<Event_entry>::const_iterator r = receives.begin();
+
+        Rule_engine engine(*rule_, violations);
+        for (;;)
+        {
+            const Event_entry* next = events.peek();
+            Entry_stream* stream = &events;
+
+            const Event_entry* m = markers.peek();
+            if (m && (!next || m->time < next->time))
+            {
+                next = m;
+                stream = &markers;
+            }
+            if (r != receives.end() && (!next || r->time < next->time))
+            {
+                next = &*r;
+                stream = 0;
+            }
+            if (!next) break;
+
+            Event_entry e = *next;
+            if (stream)
+                stream->pop();
+            else
+                ++r;
+
+            /* Receives of the lifeline itself belong to the parts of
+               their senders. */
+            if (messages && stream && e.kind == receive_event) continue;
+            engine.feed(e);
+        }
+        engine.finish();
+    }
+
+    void OTF_trace_model::lifeline_violations(int part,
+                                              std::map<int, std::vector<uint64_t> >& lists)
+    {
+        const Search_part& p = search_parts_[part];
+        std::vector<Event_entry> violations;
+        check_rule(p, violations);
+
+        std::vector<uint64_t>& list = lists[p.lifeline];
+        for (unsigned i = 0; i < violations.size(); ++i)
+            list.push_back(violations[i].time);
+    }
+
+    const Rule_violations& OTF_trace_model::rule_violations()
+    {
+        Rule_violations& v = *violations_;
+        OTF_trace_model::Ptr stale = stale_parts(v.blocks, true);
+        v.lifelines.resize(v.blocks.size());
+        if (!stale) return v;
+
+        typedef std::map<int, std::vector<uint64_t> > Lists;
+        Part_workers<Lists, OTF_trace_model> workers;
+        workers.start(stale, &OTF_trace_model::lifeline_violations, stale->search_parts_.size());
+        workers.wait();
+
+        std::vector<const Lists*> results = workers.results();
+        for (unsigned r = 0; r < results.size(); ++r)
+            for (Lists::const_iterator i = results[r]->begin(); i != results[r]->end(); ++i)
+                v.lifelines[i->first] = i->second;
+        return v;
+    }
+
+    OTF_trace_model::Ptr OTF_trace_model::stale_parts(std::vector<size_t>& blocks, bool shown)
+    {
+        Trace_store& store = data_->store;
+        if ((int)blocks.size() < store.lifelinesCount())
+            blocks.resize(store.lifelinesCount(), 0);
+
+        OTF_trace_model::Ptr stale;
+        int count = shown ? lifelines_.size() : store.lifelinesCount();
+        for (int i = 0; i < count; ++i)
+        {
+            Search_part p;
+            p.lifeline = shown ? lifelines_[i] : i;
+            size_t n = 0;
+            for (int s = 0; s < Trace_store::series_count; ++s)
+            {
+                p.blocks[s] = store.blocks(p.lifeline, (Trace_store::Series)s);
+                n += p.blocks[s].size();
+            }
+            if (n == blocks[p.lifeline]) continue;
+
+            if (!stale)
+            {
+                stale.reset(new OTF_trace_model(*this));
+                stale->search_parts_.clear();
+            }
+            stale->search_parts_.push_back(p);
+            blocks[p.lifeline] = n;
+        }
+        return stale;
+    }
+
+    const Wait_results& OTF_trace_model::wait_results()
+    {
+        Wait_results& w = *waits_;
+        OTF_trace_model::Ptr stale = stale_parts(w.blocks, false);
+        if (!stale) return w;
+
+        typedef std::map<int, Wait_part> Parts;
+        Part_workers<Parts, OTF_trace_model> workers;
+        workers.start(stale, &OTF_trace_model::lifeline_waits, stale->search_parts_.size());
+        workers.wait();
+
+        w.parts.resize(w.blocks.size());
+        std::vector<const Parts*> results = workers.results();
+        for (unsigned r = 0; r < results.size(); ++r)
+            for (Parts::const_iterator i = results[r]->begin(); i != results[r]->end(); ++i)
+                w.parts[i->first] = i->second;
+
+        std::vector<const Wait_part*> pointers;
+        std::map<int, int> component_lifeline;
+        for (unsigned l = 0; l < w.parts.size(); ++l)
+        {
+            pointers.push_back(&w.parts[l]);
+            component_lifeline[data_->lifeline_component.at(l)] = l;
+        }
+
+        std::vector<Wait_state> waits;
+        find_wait_states(pointers, 0, std::numeric_limits<int64_t>::max(), waits);
+
+        w.lifelines.assign(w.parts.size(), std::vector<Wait_state>());
+        for (unsigned i = 0; i < waits.size(); ++i)
+            w.lifelines[component_lifeline[waits[i].component]].push_back(waits[i]);
+        return w;
+    }
+
+    bool OTF_trace_model::find_wait(const State_record* after, bool forward,
+                                    State_record& found)
+    {
+        const Wait_results& w = wait_results();
+        int64_t min = ticks(min_time_), max = ticks(max_time_);
+        bool any = false;
+
+        foreach (int l, lifelines_)
+        {
+            if (l >= (int)w.lifelines.size()) continue;
+            const std::vector<Wait_state>& waits = w.lifelines[l];
+
+            /* Waits of a lifeline are sorted by begin, and ones of the
+               same begin are passed by find_order. */
+            int i;
+            if (forward)
+            {
+                int64_t from = after ? std::max(min, after->begin) : min;
+                i = std::lower_bound(waits.begin(), waits.end(), from, wait_begins_before)
+                    - waits.begin();
+            }
+            else
+            {
+                int64_t to = after ? std::min(max, after->begin) : max;
+                i = std::upper_bound(waits.begin(), waits.end(), to, time_before_wait)
+                    - waits.begin() - 1;
+            }
+
+            for (; i >= 0 && i < (int)waits.size(); i += forward ? 1 : -1)
+            {
+                const Wait_state& s = waits[i];
+                if (forward ? s.begin > max : s.begin < min) break;
+                if (!(wait_kinds_ & (1 << s.kind))) continue;
+
+                uint32_t function = data_->state_function.at(s.type);
+                if (!stateEnabled(function)) continue;
+
+                State_record r;
+                r.begin = s.begin;
+                r.end = s.end;
+                r.component = s.component;
+                r.type = s.type;
+                r.color = stateColor(function).rgb();
+                if (after && !(forward ? find_order(*after, r) : find_order(r, *after)))
+                    continue;
+
+                if (!any || (forward ? find_order(r, found) : find_order(found, r)))
+                {
+                    found = r;
+                    any = true;
+                }
+                break;
+            }
+        }
+        return any;
+    }
+
+    Query_filter OTF_trace_model::store_filter() const
+    {
+        Query_filter f = query_ ? *query_ : Query_filter();
+        f.min_time = std::max(f.min_time, ticks(min_time_));
+        f.max_time = std::min(f.max_time, ticks(max_time_));
+
+        uint32_t kinds = 0;
+        for (int kind = 0; kind < event_kinds_count; ++kind)
+            if (events_.isEnabled(kind)) kinds |= 1u << kind;
+        f.kinds &= kinds;
+
+        /* The selection of states may change after the query has been
+           installed, so it is applied here. */
+        std::vector<unsigned char> functions;
+        QHash<uint32_t, int>::const_iterator i;
+        for (i = data_->function_state.constBegin(); i != data_->function_state.constEnd(); ++i)
+        {
+            if (functions.size() <= i.key())
+                functions.resize(i.key() + 1, 0);
+            functions[i.key()] = stateEnabled(i.key()) &&
+                (!query_ || (i.key() < query_->functions.size() && query_->functions[i.key()]));
+        }
+        f.functions.swap(functions);
+        return f;
     }
 
     Trace_model::Ptr OTF_trace_model::filter_events(const Selection & filter)
     {
         OTF_trace_model::Ptr n(new OTF_trace_model(*this));
         n->events_ = filter;
+        n->events_changed();
         return n;
     }
 
     QString OTF_trace_model::save() const
     {
         QString componentPos;
-        for(QDomElement c = currentElement;
-            !c.isNull() && c.tagName() == "component";
-            c = c.parentNode().toElement())
-        {
-            componentPos = c.attribute("name")+"/"+componentPos;
-        }
+        for (int c = parent_component_; c != Selection::ROOT; c = components_.itemParent(c))
+            componentPos = components_.item(c) + "/" + componentPos;
         componentPos = "/"+componentPos;
 
         return  componentPos + ":" +
-            min_time_.toString() + ":" + max_time_.toString();
+            QString::number(ticks(min_time_)) + ":" + QString::number(ticks(max_time_));
     }
 
     bool OTF_trace_model::groupsEnabled() const
@@ -529,166 +2060,164 @@ namespace vis4 {
     void OTF_trace_model::restore(const QString& s)
     {
         QStringList parts = s.split(":");
-        if (parts.size() < 2)
+        if (parts.size() < 3)
             return;
 
         QStringList path_parts = parts[0].split("/",QString::SkipEmptyParts);
-        currentElement = root_; parent_component_ = Selection::ROOT;
+        int parent = Selection::ROOT;
         foreach(QString s, path_parts)
         {
-            for(QDomElement e = currentElement.firstChildElement();
-                !e.isNull();
-                e = e.nextSiblingElement("component"))
-            {
-                if (e.attribute("name") == s)
-                {
-                    currentElement = e;
-                    parent_component_ = components_.itemLink(s, parent_component_);
-                    break;
-                }
-            }
+            int link = components_.itemLink(s, parent);
+            if (link == Selection::ROOT) break;
+            parent = link;
         }
+        if (parent != Selection::ROOT)
+            parent_component_ = parent;
         adjust_components();
 
-        min_time_ = getTime(parts[1].toInt());
-        max_time_ = getTime(parts[2].toInt());
+        min_time_ = getTime(parts[1].toULongLong());
+        max_time_ = getTime(parts[2].toULongLong());
     }
 
 // private functions
 
-    Time OTF_trace_model::getTime(int t) const
+    Time OTF_trace_model::getTime(uint64_t t) const
     {
-        return scalar_time<int>(t);
+        return scalar_time<long long>((long long)t);
     }
 
+    uint64_t OTF_trace_model::ticks(const Time& t) const
+    {
+        long long v = boost::any_cast<long long>(t.raw());
+        return v < 0 ? 0 : (uint64_t)v;
+    }
 
-    void OTF_trace_model::initialize()
+    void OTF_trace_model::adjust_components()
     {
+        visible_components_ = components_.enabledItems(parent_component_);
+        components_.setItemProperty(0, "current_parent", parent_component_);
 
-        QString max_time_at = root_.attribute("max_time");
-        max_time_ = getTime(max_time_at.toInt());
+        /* Links of children are greater than the link of their parent,
+           so one pass in link order passes each lifeline down the
+           enabled subtree of its visible component. */
+        int count = components_.totalItemsCount();
+        lifeline_table_.fill(-1, count);
+        int* table = lifeline_table_.data();
 
-        // Initialize components and states
-/*
-        components_.clear();
-        states_.clear();
-        typedef std::pair<QDomElement, int> node;
-        std::queue<node> nodes;
-        nodes.push(node(root_, Selection::ROOT));
-
-        fprintf( stdout, "  $$$$$$    parent component %u \n", parent_component_);
-
-        int current_link = components_.addItem("Component_1", parent_component_);
-        current_link = components_.addItem("Component_2", parent_component_);
-        parent_component_ = current_link;
-*/
-       /*
-        QString fullComponentName = component_name(current_link, true);
-        int sparent = states_.itemLink(fullComponentName);
-
-        if (sparent == -1) {
-            sparent = states_.addItem(fullComponentName);
-            states_.setItemProperty(sparent, "component", current_link);
-        }
-
-        states_.addItem("STATE_1", sparent);
-*/
-/*
-        while (!nodes.empty())
-        {
-            QDomElement parent = nodes.front().first.toElement();
-            for (QDomElement e = parent.firstChildElement("component");
-            !e.isNull();
-            e = e.nextSiblingElement("component"))
-            {
-                int current_link = components_.addItem(e.attribute("name"),  nodes.front().second);
-                nodes.push(node(e, current_link));
-
-                QDomElement statesNode = e.firstChildElement("states");
-                if (!statesNode.isNull()) {
-                    QString fullComponentName = component_name(current_link, true);
-                    int sparent = states_.itemLink(fullComponentName);
-
-                    if (sparent == -1) {
-                        sparent = states_.addItem(fullComponentName);
-                        states_.setItemProperty(sparent, "component", current_link);
-                    }
+        for (int ll = 0; ll < visible_components_.size(); ll++)
+            table[visible_components_[ll]] = ll;
 
-                    for (QDomElement stateNode = statesNode.firstChildElement("state");
-                        !stateNode.isNull(); stateNode = stateNode.nextSiblingElement("state"))
-                    {
-                        states_.addItem(stateNode.attribute("name"), sparent);
-                    }
-                }
-            }
-            nodes.pop();
+        for (int c = 0; c < count; ++c)
+        {
+            if (table[c] != -1 || !components_.isEnabled(c)) continue;
+
+            int parent = components_.itemParent(c);
+            Q_ASSERT(parent < c);
+            if (parent != Selection::ROOT)
+                table[c] = table[parent];
         }
 
-        components_.setItemProperty(0, "current_parent", parent_component_);
-        available_states_ = states_;
-*/
-        // Initialize events
+        lifelines_.clear();
+        for (int l = 0; l < data_->lifeline_component.size(); ++l)
+        {
+            if (lifeline(data_->lifeline_component.at(l)) != -1)
+                lifelines_ << l;
+        }
+    }
 
-        events_.clear();
-        events_.addItem("Update");
-        events_.addItem("Delay");
-        events_.addItem("Send");
-        events_.addItem("Receive");
-        events_.addItem("Stop");
+    bool OTF_trace_model::stateEnabled(uint32_t function) const
+    {
+        int link = data_->function_state.value(function, -1);
+        if (link == -1) return false;
 
+        return states_.isEnabled(link) && states_.isEnabled(states_.itemParent(link));
     }
 
-    void OTF_trace_model::adjust_components()
+    QColor OTF_trace_model::stateColor(uint32_t function) const
     {
-        visible_components_ = components_.enabledItems(parent_component_);
-        components_.setItemProperty(0, "current_parent", parent_component_);
+        return QColor::fromHsv((function * 47) % 360, 80, 255);
+    }
 
-        subcomponents.clear();
-        QDomNodeList nodes = currentElement.childNodes();
-        foreach(int component, visible_components_)
-        {
-            int index = components_.itemIndex(component);
-            subcomponents.push_back(nodes.at(index).toElement());
-        }
+    bool OTF_trace_model::fillEventsWindow()
+    {
+        /* Events of all lifelines are merged by time in windows, so
+           only one block per lifeline is pinned at any moment. */
+        events_window_.clear();
+        events_window_pos_ = 0;
 
-        lifeline_map_.clear();
-        for (int ll = 0; ll < visible_components_.size(); ll++)
+        while (events_window_.empty())
         {
-            QList<int> queue; queue << visible_components_[ll];
-            while (!queue.isEmpty())
+            if (events_window_end_ > max_ticks_)
+                return false;
+
+            uint64_t end = events_window_end_ + events_window_width_;
+            bool more = false;
+
+            for (unsigned i = 0; i < event_cursors_.size(); ++i)
             {
-                int comp = queue.takeFirst();
-                lifeline_map_[comp] = ll;
+                Series_cursor<Event_entry>& c = event_cursors_[i];
+                while (const Event_entry* e = c.next())
+                {
+                    if (e->time > max_ticks_)
+                    {
+                        c = Series_cursor<Event_entry>();
+                        break;
+                    }
+                    if (e->time >= end)
+                    {
+                        c.unget();
+                        more = true;
+                        break;
+                    }
+                    if (e->time < min_ticks_ || !events_.isEnabled(e->kind)) continue;
 
-                foreach(int child, components_.enabledItems(comp))
-                    queue << child;
+                    events_window_.push_back(*e);
+                }
+                c.release();
             }
+
+            events_window_end_ = end;
+            if (!more && events_window_.empty())
+                return false;
         }
 
+        std::stable_sort(events_window_.begin(), events_window_.end(), event_time_less);
+        return true;
     }
 
-    void OTF_trace_model::findNextItem(const QString& elementName)
+    int OTF_trace_model::lodLevel() const
     {
-        if (!currentItem.isNull())
-            currentItem = currentItem.nextSiblingElement();
+        const Trace_store::Lod_geometry& g = data_->store.lodGeometry();
+        if (max_ticks_ <= min_ticks_ || lifelines_.isEmpty())
+            return -1;
 
-        if (currentItem.isNull())
-        {
-            for(;;)
-            {
-                ++currentSubcomponent;
-                if (unsigned(currentSubcomponent) >= subcomponents.size())
-                    break;
+        uint64_t min_bins = std::min(lod_min_bins, g.capacity / 4);
+        uint64_t bins = (max_ticks_ - min_ticks_) / g.width;
+        if (bins < min_bins)
+            return -1;
 
-                QDomElement group = subcomponents[currentSubcomponent]
-                    .firstChildElement(elementName);
+        int levels = data_->store.lod(lifelines_[0]).levels();
+        int level = 0;
+        while (level+1 < levels && (bins >> (level+1)) >= min_bins)
+            ++level;
 
-                if (!group.isNull())
-                {
-                    currentItem = group.firstChildElement();
-                    break;
-                }
-            }
-        }
+        return level;
+    }
+
+    bool OTF_trace_model::lodBins(int lifeline, int& first, int& last) const
+    {
+        const Trace_store::Lod_geometry& g = data_->store.lodGeometry();
+        uint64_t width = g.width << lod_level_;
+        int count = (int)data_->store.lod(lifeline).level(lod_level_).size();
+
+        if (max_ticks_ < g.origin) return false;
+
+        uint64_t from = min_ticks_ > g.origin ? (min_ticks_ - g.origin) / width : 0;
+        uint64_t to = (max_ticks_ - g.origin) / width;
+        if (from >= (uint64_t)count) return false;
+
+        first = (int)from;
+        last = to < (uint64_t)count ? (int)to : count-1;
+        return true;
     }
 }
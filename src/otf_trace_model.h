@@ -1,14 +1,14 @@
 #ifndef OTF_TRACE_MODEL_H
 #define OTF_TRACE_MODEL_H
 
-#include <QDomDocument>
-#include <QDomElement>
-#include <QFile>
 #include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QVector>
 #include <QDebug>
-#include <sstream>
-#include <set>
-#include <queue>
+#include <vector>
+#include <map>
+#include <memory>
 #include <algorithm>
 
 #include <stdio.h>
@@ -23,6 +23,11 @@
 #include "group_model.h"
 #include "event_list.h"
 #include "grx.h"
+#include "trace_store.h"
+#include "otf_loader.h"
+#include "query.h"
+#include "rules.h"
+#include "wait_states.h"
 
 #include "otf.h"
 
@@ -31,12 +36,105 @@ namespace vis4 {
 using namespace common;
 class OTF_trace_model;
 
+/** Times of the violations of a rule on each store lifeline. Shared
+    by the copies of the model with the rule. */
+struct Rule_violations
+{
+    /** Sealed blocks of each store lifeline its list was built from.
+        Lists of the lifelines not shown are built once shown. */
+    std::vector<size_t> blocks;
+
+    std::vector< std::vector<uint64_t> > lifelines;
+};
+
+/** Wait states of each store lifeline over the whole trace, in the
+    order of wait_before. Shared by the copies of the model with the
+    wait checker. */
+struct Wait_results
+{
+    /** Sealed blocks of each store lifeline its part was collected
+        from. */
+    std::vector<size_t> blocks;
+
+    /** Data of each store lifeline for find_wait_states. */
+    std::vector<Wait_part> parts;
+
+    std::vector< std::vector<Wait_state> > lifelines;
+};
+
+/** Trace data shared by all copies of OTF_trace_model.
+
+    Event records are decoded by the loader thread and added to the
+    store in portions by load(). Readers see them after publish(),
+    which seals the blocks that stopped growing and updates the LOD
+    pyramids; the remaining blocks are sealed when loading ends.
+
+    load() is called by the thread showing the model, in short slices,
+    so the store is built there and the view stays responsive only as
+    long as the slices are short. The loader thread reads and decodes
+    the records.
+
+    In follow mode, load() continues after the loader has finished,
+    adding records appended to the trace files. */
+struct OTF_trace_data
+{
+    OTF_trace_data(size_t memory_budget);
+    ~OTF_trace_data();
+
+    /** Adds decoded records to the store, spending at most msecs
+        milliseconds, or waits for all records if msecs is negative.
+        Returns true if any records were added. */
+    bool load(int msecs);
+
+    void setFollowing(bool following);
+
+    /** Makes the records added so far visible to readers, except
+        the ones in blocks still being filled. */
+    void publish();
+
+    Trace_store store;
+
+    /** @name Background loading. */
+    //@{
+    std::auto_ptr<Record_ring> ring;
+    std::auto_ptr<OTF_loader> loader;
+    bool loading;
+
+    QString filename;
+    std::auto_ptr<OTF_tail> tail;
+    bool following;
+    //@}
+
+    /** @name Time range of the published records, including the
+        range declared in the definitions, if any. */
+    //@{
+    bool declared_range;
+    uint64_t min_time;
+    uint64_t max_time;
+    //@}
+
+    /** @name Mapping of OTF identifiers to selection links. */
+    //@{
+    QHash<uint32_t, int> process_component;
+    QHash<uint32_t, int> function_group_state;
+    QHash<uint32_t, int> function_state;
+    QVector<uint32_t> state_function;
+    //@}
+
+    /** Functions that are collective operations, see is_collective.
+        Found with the definitions, so the search workers don't look
+        at the names. */
+    QSet<uint32_t> collective_functions;
+
+    /** Component of each store lifeline. */
+    QVector<int> lifeline_component;
+};
+
 typedef struct {
-    uint64_t count;
-    int parent_component;
+    OTF_trace_data* data;
     Selection* components;
-    uint64_t countSend;
-    uint64_t countRecv;
+    Selection* states;
+    int root_component;
 } HandlerArgument;
 
 class OTF_trace_model : public Trace_model,
@@ -45,6 +143,15 @@ class OTF_trace_model : public Trace_model,
 public: /* members */
     typedef boost::shared_ptr<OTF_trace_model> Ptr;
 
+    /** Zoomed out views are served from the LOD pyramids when the
+        visible range covers at least this number of level 0 bins, or a
+        quarter of the bins, if the budget made the pyramids smaller.
+        The trace fills between half and all of the bins, so views of
+        at least half of it never read the blocks, however many
+        lifelines there are; closer views read only the blocks they
+        show. */
+    static const int lod_min_bins = 512;
+
 public: /* methods */
     OTF_trace_model(const QString& filename);
     ~OTF_trace_model();
@@ -60,13 +167,86 @@ public: /* methods */
     Time max_time() const;
     Time min_resolution() const;
 
+    /** @name Incremental loading.
+        The constructor reads only definitions, event records are
+        loaded in background. */
+    //@{
+    bool loading() const;
+
+    /** Percentage of the trace files read. */
+    int loadProgress() const;
+
+    /** Adds decoded records to the store, see OTF_trace_data::load. */
+    bool load(int msecs);
+
+    /** Makes loaded records visible. Returns the model with the time
+        range extended to the new records, if this model showed all
+        records published before. In follow mode, a model showing the
+        end of a part of the trace is scrolled to the new end. */
+    Trace_model::Ptr publish();
+
+    /** Follow mode is shared by all copies of the model. */
+    bool following() const;
+    void setFollowing(bool following);
+    //@}
+
     void rewind();
 
     std::auto_ptr<State_model> next_state();
     std::auto_ptr<Group_model> next_group();
-    std::auto_ptr<Event_model> next_event_unsorted();
     std::auto_ptr<Event_model> next_event();
 
+    int next_events(Event_record* records, int capacity);
+    int next_states(State_record* records, int capacity);
+    int next_groups(Group_record* records, int capacity);
+
+    int64_t time_ticks(const Time& time) const;
+    Time ticks_time(int64_t ticks) const;
+
+    void lifeline_events(int component, const Time& min, const Time& max,
+                         QVector<Event_record>& records);
+
+    bool find_event(const Event_record* after, bool forward, Event_record& found);
+    bool find_state(const State_record* after, bool forward, State_record& found);
+
+    /** Parts are the visible store lifelines. */
+    int search_parts();
+    void search_events(int part, Search_sink& sink);
+    void search_states(int part, Search_sink& sink);
+
+    /** Calls are nested by their depth, so exclusive times need no
+        search of the enclosing calls. */
+    void profile(int part, std::vector<Profile_entry>& entries);
+
+    /** Adds up the block summaries of the calls, reading only the
+        blocks crossing the ends of the range. */
+    bool range_profile(int component, const Time& min, const Time& max,
+                       std::vector<Profile_entry>& entries);
+
+    /** Reads the messages series of the part, which holds the messages
+        sent by its lifeline, so the parts have no pairs in common. */
+    void communication(int part, std::vector<Communication_entry>& entries);
+
+    /** Reads the messages and states series of the part, which hold
+        the messages sent by its lifeline and its calls. */
+    void critical_path_part(int part, Path_part& data);
+
+    /** Reads the messages, events and states series of the part. The
+        states before the time range are read too, to number the
+        collective calls from the start of the trace. */
+    void wait_part(int part, Wait_part& data);
+
+    /** Merges the LOD pyramids of the shown lifelines at the finest
+        level having at most one bin per activity bin, so the time
+        depends only on the number of bins. As in the pyramid, the
+        dominant state is the one covering the most of a single bin. */
+    bool activity(int bins, std::vector<Activity_bin>& activity);
+
+    /** Counts events and messages by the block summaries, as
+        range_profile does, and takes the states from it. */
+    bool range_statistics(int component, const Time& min, const Time& max,
+                          Range_statistics& statistics);
+
     Trace_model::Ptr root();
     Trace_model::Ptr set_parent_component(int component);
     Trace_model::Ptr set_range(const Time& min, const Time& max);
@@ -88,9 +268,9 @@ public: /* methods */
     void restore(const QString& s);
 
 private:    /* members */
-    OTF_FileManager* manager;
-    OTF_Reader* reader;
+    boost::shared_ptr<OTF_trace_data> data_;
 
+    int root_component_;
     int parent_component_;
     Selection components_;
     Selection events_;
@@ -101,41 +281,120 @@ private:    /* members */
     Time min_time_;
     Time max_time_;
 
-    OTF_HandlerArray* handlers;
-    HandlerArgument ha;
-    uint64_t ret;
-
-//?
-    ComponentTree::Link hierarchy_pos;
-    QMap<ComponentTree::Link, int> components_map_;
-    boost::shared_ptr<ComponentTree> hierarchy_backend;
-
 private:    /* methods */
-    Time getTime(int t) const;
-    void initialize();
+    Time getTime(uint64_t t) const;
+    uint64_t ticks(const Time& t) const;
     void adjust_components();
     void initialize_component_list();
 
-//?
-    void findNextItem(const QString& elementName);
-    QDomElement currentElement;
-    std::vector<QDomElement> subcomponents;
+    bool stateEnabled(uint32_t function) const;
+    QColor stateColor(uint32_t function) const;
+    void fill_event(Event_record& r, uint64_t time, uint32_t kind, int component) const;
+    bool fillEventsWindow();
 
-    QList<int> visible_components_;
-    QMap<int, int> lifeline_map_;
+    /** Returns the filter of the installed query, or the filter
+        passing all records, restricted to the time range and the
+        selections of the model. */
+    Query_filter store_filter() const;
 
-    // The current item we iterate over -- could be state,
-    // or event, or group event.
-    QDomElement currentItem;
-    int currentSubcomponent;
+    /** find_event and find_state for the model with a query. */
+    bool query_event(const Event_record* after, bool forward, Event_record& found);
+    bool query_state(const State_record* after, bool forward, State_record& found);
+    int lodLevel() const;
+    bool lodBins(int lifeline, int& first, int& last) const;
 
-    // All events sorted by the time.
-    QVector<Event_model*> allEvents;
-    int currentEvent;
+    QList<int> visible_components_;
 
-    // Need to hold a reference to root so that it's not
-    // deleted.
-    QDomElement root_;
+    /** Lifeline of each component link, -1 if the component is not
+        shown. */
+    QVector<int> lifeline_table_;
+
+    /** Store lifelines with a visible component. */
+    QVector<int> lifelines_;
+
+    /** @name Iteration state. */
+    //@{
+    uint64_t min_ticks_;
+    uint64_t max_ticks_;
+    int lod_level_;             ///< Pyramid level in use, or -1.
+
+    int state_lifeline_;
+    Series_cursor<State_entry> state_cursor_;
+    int lod_state_bin_;
+
+    int group_lifeline_;
+    Series_cursor<Message_entry> group_cursor_;
+
+    std::vector< Series_cursor<Event_entry> > event_cursors_;
+    std::vector<Event_entry> events_window_;
+    unsigned events_window_pos_;
+    uint64_t events_window_end_;
+    uint64_t events_window_width_;
+    int lod_event_bin_;
+    int lod_event_lifeline_;
+    int lod_event_kind_;
+    //@}
+
+    /** Blocks of a lifeline taken by search_parts. Blocks are added
+        to the store while the search runs, so the workers don't look
+        into the block index. */
+    struct Search_part
+    {
+        int lifeline;
+        std::vector<Trace_store::Block> blocks[Trace_store::series_count];
+        std::vector<Wait_state> waits;  ///< With the wait checker.
+    };
+
+    std::vector<Search_part> search_parts_;
+    Query_filter search_filter_;
+
+    /** Returns a copy of the model whose search parts are the store
+        lifelines that have got blocks since they were counted in
+        blocks, and counts them again. If shown is true, only the
+        shown lifelines are taken. Returns null if none has. */
+    OTF_trace_model::Ptr stale_parts(std::vector<size_t>& blocks, bool shown);
+
+    /** Query of the installed checker, with the functions resolved. */
+    boost::shared_ptr<Query_filter> query_;
+
+    /** Rule of the installed checker. */
+    boost::shared_ptr<Rule> rule_;
+    boost::shared_ptr<Rule_violations> violations_;
+
+    /** Checks the rule on the records of the part. Parts are checked
+        independently: the message rule takes the receives from the
+        messages sent by the lifeline of the part. */
+    void check_rule(const Search_part& part, std::vector<Event_entry>& violations) const;
+
+    /** Checks the rule on the part into lists, by its store lifeline. */
+    void lifeline_violations(int part, std::map<int, std::vector<uint64_t> >& lists);
+
+    /** Returns the violations of the rule. The shown lifelines
+        publish() has added blocks to are checked again in parallel. */
+    const Rule_violations& rule_violations();
+
+    /** Wait state kinds of the installed checker, a bit for each
+        Wait_state::Kind, and the wait states found. */
+    int wait_kinds_;
+    boost::shared_ptr<Wait_results> waits_;
+
+    /** Collects the data of the part for find_wait_states, for the
+        messages received within [min, max]. */
+    void collect_waits(const Search_part& part, uint64_t min, uint64_t max,
+                       Wait_part& data) const;
+
+    /** Collects the part over the whole trace into parts, by its store
+        lifeline. */
+    void lifeline_waits(int part, std::map<int, Wait_part>& parts);
+
+    /** Returns the wait states. The lifelines publish() has added
+        blocks to are collected again in parallel, and the states are
+        found again over all of them, as a send may end a wait of
+        another lifeline. */
+    const Wait_results& wait_results();
+
+    /** find_state for the model with the wait checker. */
+    bool find_wait(const State_record* after, bool forward, State_record& found);
 };
 
 
@@ -145,17 +404,19 @@ private:    /* methods */
 //   
 static int handleDefProcessGroup (void *userData, uint32_t stream, uint32_t procGroup, const char *name, uint32_t numberOfProcs, const uint32_t *procs)
 {
-    qDebug() << "stream = " << stream << " procGroup: " << procGroup << " name: " << name << " number: " << numberOfProcs;
-    QString str = "";
-    for (int i=0; i<numberOfProcs; i++) str += QString::number(procs[i]) + " ";
-    qDebug() << "process list: " << str;
     return OTF_RETURN_OK;
 }
 
 static int handleDefProcess (void *userData, uint32_t stream, uint32_t process, const char *name, uint32_t parent)
 {
-    int current_link = ((HandlerArgument*)userData)->components->addItem( QString(name), (int) parent);
-    qDebug() << "stream = " << stream << " process: " << process << " name: " << name << " parent: " << parent;
+    HandlerArgument* ha = (HandlerArgument*)userData;
+
+    int parent_link = ha->data->process_component.value(parent, ha->root_component);
+    int current_link = ha->components->addItem(name, parent_link);
+    ha->components->setItemProperty(current_link, "process", process);
+
+    ha->data->process_component[process] = current_link;
+    ha->data->store.addLifeline(process);
     return OTF_RETURN_OK;
 }
 
@@ -164,13 +425,29 @@ static int handleDefProcess (void *userData, uint32_t stream, uint32_t process,
 //   
 static int handleDefFunctionGroup (void *userData, uint32_t stream, uint32_t funcGroup, const char *name)
 {
-    qDebug() << "stream = " << stream << " funcGroup: " << funcGroup << " name: " << name;
+    HandlerArgument* ha = (HandlerArgument*)userData;
+
+    if (!ha->data->function_group_state.contains(funcGroup))
+        ha->data->function_group_state[funcGroup] = ha->states->addItem(name);
     return OTF_RETURN_OK;
 }
 
 static int handleDefFunction (void *userData, uint32_t stream, uint32_t func, const char *name, uint32_t funcGroup, uint32_t source)
 {
-    qDebug() << "stream = " << stream << " func: " << func << " name: " << name << " funcGroup: " << funcGroup << " source: " << source;
+    HandlerArgument* ha = (HandlerArgument*)userData;
+
+    if (!ha->data->function_group_state.contains(funcGroup))
+        handleDefFunctionGroup(userData, stream, funcGroup, "Other");
+
+    int link = ha->states->addItem(name, ha->data->function_group_state[funcGroup]);
+    ha->data->function_state[func] = link;
+
+    if (ha->data->state_function.size() <= link)
+        ha->data->state_function.resize(link+1);
+    ha->data->state_function[link] = func;
+
+    if (is_collective(name))
+        ha->data->collective_functions.insert(func);
     return OTF_RETURN_OK;
 }
 
@@ -179,53 +456,24 @@ static int handleDefFunction (void *userData, uint32_t stream, uint32_t func, co
 //   
 static int handleDefMarker(void *userData, uint32_t stream, uint32_t token, const char *name, uint32_t type)
 {
-    qDebug() << "DEFMARKER: stream = " << stream << " token: " << token << " name: " << name << " type: " << type;
     return OTF_RETURN_OK;
 }
 
-
-//===========================================================================
-//===========================================================================
-//===========================================================================
-
-//    
-static int handleEnter (void *userData, uint64_t time, uint32_t function, uint32_t process, uint32_t source, OTF_KeyValueList *list)
-{
-     //fprintf( stdout, "      Enter time: %u function name: '%u'\n", process, function );
-
-     qDebug() << "ENTER: " << function;
-     return OTF_RETURN_OK;
-}
-
- static int handleLeave (void *userData, uint64_t time, uint32_t function, uint32_t process, uint32_t source, OTF_KeyValueList *list)
-{
-     //fprintf( stdout, "      Leave time: %u function name: '%u'\n", process, function );
-     qDebug() << "LEAVE: " << function;
-     return OTF_RETURN_OK;
-}
-
- static int handleMarker(void *userData, uint64_t time, uint32_t process, uint32_t token, const char *text, OTF_KeyValueList *list)
+/* The range is known before events are loaded, so the first view
+   shows the whole trace. */
+static int handleDefTimeRange(void *userData, uint32_t stream, uint64_t minTime, uint64_t maxTime, OTF_KeyValueList *list)
 {
-     qDebug() << "MARKER: " << text;
-     return OTF_RETURN_OK;
-}
+    HandlerArgument* ha = (HandlerArgument*)userData;
 
+    if (minTime > maxTime) return OTF_RETURN_OK;
 
-// *************************** MESSAGES **************************************
-// ***************************************************************************
- static int handleSendMsg(void *userData, uint64_t time, uint32_t sender, uint32_t receiver, uint32_t group, uint32_t type, uint32_t length, uint32_t source, OTF_KeyValueList *list)
-{
-     //qDebug() << "SendMsg: ";
-     ((HandlerArgument*)userData)->countSend++;
-     return OTF_RETURN_OK;
+    OTF_trace_data* data = ha->data;
+    data->min_time = data->declared_range ? std::min(data->min_time, minTime) : minTime;
+    data->max_time = data->declared_range ? std::max(data->max_time, maxTime) : maxTime;
+    data->declared_range = true;
+    return OTF_RETURN_OK;
 }
 
- static int handleRecvMsg(void *userData, uint64_t time, uint32_t recvProc, uint32_t sendProc, uint32_t group, uint32_t type, uint32_t length, uint32_t source, OTF_KeyValueList *list)
-{
-     //qDebug() << "RecvMsg: ";
-     ((HandlerArgument*)userData)->countRecv++;
-     return OTF_RETURN_OK;
-}
 
 }   // End of Namespace
 
@@ -0,0 +1,124 @@
+#ifndef PART_WORKERS_HPP
+#define PART_WORKERS_HPP
+
+#include "trace_model.h"
+
+#include <QThread>
+#include <QList>
+
+#include <vector>
+
+namespace vis4 {
+
+/** Threads running a method of Trace_model over the parts given by
+    Trace_model::search_parts, one thread per processor. Thread i
+    takes every n-th part starting with i and collects into a result
+    of its own, which the caller merges once all threads finish.
+    Model may be a subclass, for the methods of its own. */
+template<class Result, class Model = Trace_model>
+class Part_workers
+{
+public:
+    typedef boost::shared_ptr<Model> Ptr;
+    typedef void (Model::*Method)(int part, Result& result);
+
+    Part_workers() {}
+    ~Part_workers() { stop(); }
+
+    /** Starts the threads after stopping the previous ones. If
+        receiver is given, slot is connected to the finished() signal
+        of every thread. */
+    void start(const Ptr& model, Method method, int parts,
+               QObject* receiver = 0, const char* slot = 0)
+    {
+        stop();
+
+        int threads = qMax(1, qMin(QThread::idealThreadCount(), parts));
+        for (int i = 0; i < threads; ++i)
+        {
+            Worker* w = new Worker(model, method, i, threads, parts);
+            if (receiver)
+                QObject::connect(w, SIGNAL(finished()), receiver, slot);
+            workers_ << w;
+            w->start();
+        }
+    }
+
+    /** Returns true if the threads are started and all of them have
+        finished. */
+    bool finished() const
+    {
+        if (workers_.isEmpty()) return false;
+        foreach (Worker* w, workers_)
+            if (!w->isFinished()) return false;
+        return true;
+    }
+
+    /** Waits for the threads to finish. */
+    void wait()
+    {
+        foreach (Worker* w, workers_)
+            w->wait();
+    }
+
+    /** Results of the threads, valid until the next start or stop. */
+    std::vector<const Result*> results() const
+    {
+        std::vector<const Result*> results;
+        foreach (Worker* w, workers_)
+            results.push_back(&w->result);
+        return results;
+    }
+
+    /** Cancels the threads, waits for them and drops the results. */
+    void stop()
+    {
+        foreach (Worker* w, workers_)
+            w->cancel();
+        foreach (Worker* w, workers_)
+        {
+            w->wait();
+            delete w;
+        }
+        workers_.clear();
+    }
+
+private:
+    class Worker : public QThread
+    {
+    public:
+        Worker(const Ptr& model, Method method, int first, int step, int parts)
+        : model_(model), method_(method), first_(first), step_(step), parts_(parts),
+          cancelled_(false)
+        {}
+
+        void cancel() { cancelled_ = true; }
+
+        Result result;
+
+    protected:
+        void run()
+        {
+            for (int part = first_; part < parts_ && !cancelled_; part += step_)
+                ((*model_).*method_)(part, result);
+        }
+
+    private:
+        Ptr model_;
+        Method method_;
+        int first_;
+        int step_;
+        int parts_;
+        volatile bool cancelled_;
+    };
+
+    QList<Worker*> workers_;
+
+private:
+    Part_workers(const Part_workers&);
+    Part_workers& operator=(const Part_workers&);
+};
+
+}
+
+#endif
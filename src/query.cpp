@@ -0,0 +1,281 @@
+#include "query.h"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+QString tr(const char* s)
+{
+    return QCoreApplication::translate("vis4::Query", s);
+}
+
+/** Narrows [min, max] by the comparison with value. Empty range
+    has min greater than max. */
+template<class T>
+void restrict(T& min, T& max, const QString& op, T value)
+{
+    if (op == "<")
+    {
+        if (value == 0) { min = 1; max = 0; }
+        else max = std::min(max, T(value - 1));
+    }
+    else if (op == "<=")
+        max = std::min(max, value);
+    else if (op == "=")
+    {
+        min = std::max(min, value);
+        max = std::min(max, value);
+    }
+    else if (op == ">=")
+        min = std::max(min, value);
+    else
+    {
+        if (value == T(~T(0))) { min = 1; max = 0; }
+        else min = std::max(min, T(value + 1));
+    }
+}
+
+bool isOperator(const QString& s)
+{
+    return s == "<" || s == "<=" || s == "=" || s == ">=" || s == ">";
+}
+
+/** Microseconds in the unit, as in the units of Time. */
+uint64_t unitScale(const QString& unit, bool* ok)
+{
+    *ok = true;
+    if (unit.isEmpty() || unit == "us") return 1;
+    if (unit == "ms") return 1000;
+    if (unit == "s" || unit == "sec") return 1000000;
+    if (unit == "min") return 60000000;
+    if (unit == "hour") return Q_UINT64_C(3600000000);
+
+    *ok = false;
+    return 0;
+}
+
+/** Reads a number at tokens[i], advancing i. If units is true, the
+    number may be followed by a unit, in the same or the next token. */
+bool readNumber(const QStringList& tokens, int& i, bool units, uint64_t& value)
+{
+    if (i >= tokens.size()) return false;
+
+    QRegExp number("(\\d+(?:\\.\\d+)?)([a-z]*)");
+    if (!number.exactMatch(tokens[i])) return false;
+    ++i;
+
+    QString unit = number.cap(2);
+    bool ok;
+    if (units && unit.isEmpty() && i < tokens.size())
+    {
+        unitScale(tokens[i], &ok);
+        if (ok) unit = tokens[i++];
+    }
+    if (!units && !unit.isEmpty()) return false;
+
+    uint64_t scale = unitScale(unit, &ok);
+    if (!ok) return false;
+
+    value = (uint64_t)(number.cap(1).toDouble() * scale + 0.5);
+    return true;
+}
+
+}
+
+Query_filter::Query_filter()
+: kinds(~0u),
+  min_time(0), max_time(~(uint64_t)0),
+  min_duration(0), max_duration(~(uint64_t)0),
+  min_depth(0), max_depth(~0u),
+  min_process(0), max_process(~0u),
+  min_tag(0), max_tag(~0u),
+  min_length(0), max_length(~0u)
+{
+}
+
+int select_events(const Query_filter& f, const Event_entry* entries, int count,
+                  uint32_t* selected)
+{
+    int n = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const Event_entry& e = entries[i];
+
+        uint32_t ok = (f.kinds >> e.kind) & 1;
+        ok &= (e.time >= f.min_time) & (e.time <= f.max_time);
+        ok &= (e.process >= f.min_process) & (e.process <= f.max_process);
+        ok &= (e.tag >= f.min_tag) & (e.tag <= f.max_tag);
+        ok &= (e.length >= f.min_length) & (e.length <= f.max_length);
+
+        selected[n] = i;
+        n += ok;
+    }
+    return n;
+}
+
+int select_states(const Query_filter& f, const State_entry* entries, int count,
+                  uint32_t* selected)
+{
+    if (f.functions.empty()) return 0;
+
+    const unsigned char* functions = &f.functions[0];
+    uint32_t functions_count = (uint32_t)f.functions.size();
+
+    int n = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        const State_entry& s = entries[i];
+        uint64_t duration = s.end - s.begin;
+
+        uint32_t known = s.function < functions_count;
+        uint32_t ok = known & (functions[known ? s.function : 0] != 0);
+        ok &= (s.end >= f.min_time) & (s.begin <= f.max_time);
+        ok &= (duration >= f.min_duration) & (duration <= f.max_duration);
+        ok &= (s.depth >= f.min_depth) & (s.depth <= f.max_depth);
+        ok &= (s.process >= f.min_process) & (s.process <= f.max_process);
+
+        selected[n] = i;
+        n += ok;
+    }
+    return n;
+}
+
+bool read_time(const QStringList& tokens, int& i, uint64_t& value)
+{
+    return readNumber(tokens, i, true, value);
+}
+
+Query::Query()
+: target_(events)
+{
+}
+
+bool Query::parse(const QString& text, QString* error)
+{
+    QString s = text.simplified().toLower();
+    s.replace(QRegExp("(<=|>=|<|>|=)"), " \\1 ");
+    QStringList tokens = s.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+
+    Query_filter f;
+    QList<QRegExp> functions;
+    bool kinds = false, event_conditions = false, state_conditions = false;
+
+    QString message;
+    for (int i = 0; i < tokens.size() && message.isEmpty();)
+    {
+        QString word = tokens[i++];
+        uint64_t value, value2;
+
+        if (word == "and")
+            continue;
+
+        if (word == "send" || word == "receive" || word == "marker")
+        {
+            uint32_t bit = 1u << (word == "send" ? send_event :
+                                  word == "receive" ? receive_event : marker_event);
+            f.kinds = kinds ? (f.kinds | bit) : bit;
+            kinds = event_conditions = true;
+        }
+        else if (word == "state")
+        {
+            /* Names are matched in their original case. */
+            QStringList original = text.simplified().split(' ');
+            if (i >= tokens.size())
+                message = tr("Function name expected after \"state\"");
+            else
+            {
+                QString name = tokens[i++];
+                foreach (const QString& o, original)
+                    if (o.toLower() == name) { name = o; break; }
+                functions << QRegExp(name, Qt::CaseSensitive, QRegExp::Wildcard);
+                state_conditions = true;
+            }
+        }
+        else if (word == "process")
+        {
+            QRegExp range("(\\d+)(?:-(\\d+))?");
+            if (i >= tokens.size() || !range.exactMatch(tokens[i]))
+                message = tr("Process number or range expected after \"process\"");
+            else
+            {
+                ++i;
+                f.min_process = std::max(f.min_process, range.cap(1).toUInt());
+                f.max_process = std::min(f.max_process, range.cap(2).isEmpty() ?
+                    range.cap(1).toUInt() : range.cap(2).toUInt());
+            }
+        }
+        else if (word == "from" || word == "to")
+        {
+            if (!readNumber(tokens, i, true, value))
+                message = tr("Time expected after \"%1\"").arg(word);
+            else if (word == "from")
+                f.min_time = std::max(f.min_time, value);
+            else
+                f.max_time = std::min(f.max_time, value);
+        }
+        else if (word == "duration" || word == "depth" || word == "tag" || word == "size")
+        {
+            if (i >= tokens.size() || !isOperator(tokens[i]))
+            {
+                message = tr("Comparison expected after \"%1\"").arg(word);
+                continue;
+            }
+            QString op = tokens[i++];
+
+            if (!readNumber(tokens, i, word == "duration", value))
+            {
+                message = tr("Number expected after \"%1 %2\"").arg(word).arg(op);
+                continue;
+            }
+            value2 = std::min(value, (uint64_t)~0u);
+
+            if (word == "duration")
+                restrict(f.min_duration, f.max_duration, op, value);
+            else if (word == "depth")
+                restrict(f.min_depth, f.max_depth, op, (uint32_t)value2);
+            else if (word == "tag")
+                restrict(f.min_tag, f.max_tag, op, (uint32_t)value2);
+            else
+                restrict(f.min_length, f.max_length, op, (uint32_t)value2);
+
+            if (word == "duration" || word == "depth")
+                state_conditions = true;
+            else
+                event_conditions = true;
+        }
+        else
+            message = tr("Unknown condition \"%1\"").arg(word);
+    }
+
+    if (message.isEmpty() && tokens.isEmpty())
+        message = tr("Query is empty");
+    if (message.isEmpty() && event_conditions && state_conditions)
+        message = tr("Query has conditions of both events and states");
+
+    if (!message.isEmpty())
+    {
+        if (error) *error = message;
+        return false;
+    }
+
+    text_ = text;
+    target_ = state_conditions ? states : events;
+    filter_ = f;
+    functions_ = functions;
+    return true;
+}
+
+bool Query::matchesFunction(const QString& name) const
+{
+    if (functions_.isEmpty()) return true;
+
+    foreach (const QRegExp& f, functions_)
+        if (f.exactMatch(name)) return true;
+    return false;
+}
+
+}
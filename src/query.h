@@ -0,0 +1,102 @@
+#ifndef QUERY_HPP
+#define QUERY_HPP
+
+#include "trace_store.h"
+
+#include <QString>
+#include <QStringList>
+#include <QRegExp>
+#include <QList>
+
+#include <vector>
+#include <stdint.h>
+
+namespace vis4 {
+
+/** Conditions of a query, resolved to the identifiers of the store.
+    Ranges are inclusive. Records are tested by select_events and
+    select_states. */
+struct Query_filter
+{
+    Query_filter();
+
+    uint32_t kinds;             ///< Bit mask of Event_kind values.
+
+    uint64_t min_time, max_time;
+    uint64_t min_duration, max_duration;
+    uint32_t min_depth, max_depth;
+    uint32_t min_process, max_process;
+    uint32_t min_tag, max_tag;
+    uint32_t min_length, max_length;
+
+    /** Non-zero for the functions searched for, indexed by function.
+        Functions outside of the mask don't match. */
+    std::vector<unsigned char> functions;
+};
+
+/** @name Filters of the store records.
+    The conditions are combined with bitwise operations and the
+    indexes of matching records are written unconditionally, so the
+    loops have no branches depending on the data. They return the
+    number of matching records, whose indexes are written to selected. */
+//@{
+int select_events(const Query_filter& filter, const Event_entry* entries, int count,
+                  uint32_t* selected);
+int select_states(const Query_filter& filter, const State_entry* entries, int count,
+                  uint32_t* selected);
+//@}
+
+/** Reads a time of a query at tokens[i], advancing i past the number
+    and its unit. Returns false if there is no time at tokens[i]. */
+bool read_time(const QStringList& tokens, int& i, uint64_t& value);
+
+/** Query of the query checker.
+
+    A query is a list of conditions, all of which must hold:
+
+    - send, receive, marker -- event of the kind;
+    - state NAME -- call of the function; NAME may have * and ?
+      wildcards, several state conditions match any of the names;
+    - process N, process N-M -- records of the OTF processes;
+    - from TIME, to TIME -- records within the time range;
+    - duration OP TIME, depth OP N -- duration and nesting level of
+      the calls, depth of the top-level calls is 0;
+    - tag OP N, size OP N -- tag and length in bytes of the messages.
+
+    OP is one of <, <=, =, >=, >. TIME is a number with an optional
+    unit, one of us, ms, s, min and hour; without unit the number is
+    in ticks of the trace. The word "and" between the conditions
+    is allowed. For example, "state MPI_Wait duration > 5 ms
+    process 0-63". */
+class Query
+{
+public:
+    enum Target { events, states };
+
+    Query();
+
+    /** Parses the text. On error returns false and sets error
+        to the description. */
+    bool parse(const QString& text, QString* error = 0);
+
+    const QString& text() const { return text_; }
+
+    /** States are searched if the query has state conditions. */
+    Target target() const { return target_; }
+
+    /** Returns true if the function name matches the state conditions. */
+    bool matchesFunction(const QString& name) const;
+
+    /** Returns the filter. Functions are left for the model to fill
+        using matchesFunction. */
+    const Query_filter& filter() const { return filter_; }
+
+private:
+    QString text_;
+    Target target_;
+    Query_filter filter_;
+    QList<QRegExp> functions_;
+};
+
+}
+#endif
@@ -0,0 +1,48 @@
+#include "query_checker.h"
+
+#include <QWidget>
+#include <QLineEdit>
+#include <QLabel>
+#include <QVBoxLayout>
+
+namespace vis4 {
+
+Query_checker::Query_checker()
+    : valid_(false), edit_(0), error_(0)
+{
+}
+
+QWidget * Query_checker::widget()
+{
+    QWidget * w = new QWidget();
+    QVBoxLayout * layout = new QVBoxLayout(w);
+
+    edit_ = new QLineEdit(w);
+    edit_->setToolTip(tr("For example: state MPI_* duration > 5 ms process 0-63"));
+    layout->addWidget(edit_);
+
+    error_ = new QLabel(w);
+    error_->setWordWrap(true);
+    layout->addWidget(error_);
+
+    connect(edit_, SIGNAL( textChanged(const QString&) ),
+        this, SLOT( textChanged(const QString&) ));
+
+    return w;
+}
+
+Checker * Query_checker::clone() const
+{
+    return new Query_checker();
+}
+
+void Query_checker::textChanged(const QString & text)
+{
+    QString error;
+    valid_ = query_.parse(text, &error);
+    error_->setText(valid_ ? QString() : error);
+
+    emit stateChanged();
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef QUERY_CHECKER_HPP
+#define QUERY_CHECKER_HPP
+
+#include "checker.h"
+#include "query.h"
+
+class QLineEdit;
+class QLabel;
+
+namespace vis4 {
+
+/** Checker defined by a query, see Query for the language. The query
+    is not tested on models, it is passed to Trace_model::install_checker
+    which compiles it for the records of the trace. */
+class Query_checker : public Checker {
+
+    Q_OBJECT
+
+public: /* methods */
+
+    Query_checker();
+
+    QString name() const { return "query"; }
+
+    QString title() const { return tr("Query"); }
+
+    std::set<int> events() const { return std::set<int>(); }
+
+    std::set<int> subevents(int) const { return std::set<int>(); }
+
+    QWidget * widget();
+
+    bool isReady() const { return valid_; }
+
+    void setModel(const Trace_model::Ptr & model) { model_ = model; }
+
+    const Query * query() const { return valid_ ? &query_ : 0; }
+
+private: /* methods */
+
+    Checker * clone() const;
+
+private slots:
+
+    void textChanged(const QString & text);
+
+private: /* members */
+
+    Trace_model::Ptr model_;
+    Query query_;
+    bool valid_;
+
+    QLineEdit * edit_;
+    QLabel * error_;
+
+};
+
+}
+#endif
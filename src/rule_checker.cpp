@@ -0,0 +1,48 @@
+#include "rule_checker.h"
+
+#include <QWidget>
+#include <QLineEdit>
+#include <QLabel>
+#include <QVBoxLayout>
+
+namespace vis4 {
+
+Rule_checker::Rule_checker()
+    : valid_(false), edit_(0), error_(0)
+{
+}
+
+QWidget * Rule_checker::widget()
+{
+    QWidget * w = new QWidget();
+    QVBoxLayout * layout = new QVBoxLayout(w);
+
+    edit_ = new QLineEdit(w);
+    edit_->setToolTip(tr("For example: send not received within 10 ms"));
+    layout->addWidget(edit_);
+
+    error_ = new QLabel(w);
+    error_->setWordWrap(true);
+    layout->addWidget(error_);
+
+    connect(edit_, SIGNAL( textChanged(const QString&) ),
+        this, SLOT( textChanged(const QString&) ));
+
+    return w;
+}
+
+Checker * Rule_checker::clone() const
+{
+    return new Rule_checker();
+}
+
+void Rule_checker::textChanged(const QString & text)
+{
+    QString error;
+    valid_ = rule_.parse(text, &error);
+    error_->setText(valid_ ? QString() : error);
+
+    emit stateChanged();
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef RULE_CHECKER_HPP
+#define RULE_CHECKER_HPP
+
+#include "checker.h"
+#include "rules.h"
+
+class QLineEdit;
+class QLabel;
+
+namespace vis4 {
+
+/** Checker finding the events violating a temporal rule, see Rule
+    for the rules. The rule is checked by the model the checker is
+    installed to, which reports the violating triggers as events. */
+class Rule_checker : public Checker {
+
+    Q_OBJECT
+
+public: /* methods */
+
+    Rule_checker();
+
+    QString name() const { return "rule"; }
+
+    QString title() const { return tr("Rule"); }
+
+    std::set<int> events() const { return std::set<int>(); }
+
+    std::set<int> subevents(int) const { return std::set<int>(); }
+
+    QWidget * widget();
+
+    bool isReady() const { return valid_; }
+
+    void setModel(const Trace_model::Ptr & model) { model_ = model; }
+
+    const Rule * rule() const { return valid_ ? &rule_ : 0; }
+
+private: /* methods */
+
+    Checker * clone() const;
+
+private slots:
+
+    void textChanged(const QString & text);
+
+private: /* members */
+
+    Trace_model::Ptr model_;
+    Rule rule_;
+    bool valid_;
+
+    QLineEdit * edit_;
+    QLabel * error_;
+
+};
+
+}
+#endif
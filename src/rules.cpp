@@ -0,0 +1,155 @@
+#include "rules.h"
+#include "query.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QRegExp>
+
+namespace vis4 {
+
+namespace {
+
+QString tr(const char* s)
+{
+    return QCoreApplication::translate("vis4::Rule", s);
+}
+
+bool readKind(const QString& word, uint32_t& kind)
+{
+    if (word == "send") kind = send_event;
+    else if (word == "receive") kind = receive_event;
+    else if (word == "marker") kind = marker_event;
+    else return false;
+    return true;
+}
+
+}
+
+Rule::Rule()
+: trigger(send_event), response(receive_event), match(peer_process), timeout(0)
+{
+}
+
+bool Rule::parse(const QString& text, QString* error)
+{
+    QStringList tokens = text.simplified().toLower().split(' ', QString::SkipEmptyParts);
+
+    Rule r;
+    QString message;
+    int i = 0;
+
+    if (tokens.size() < 2 || !readKind(tokens[0], r.trigger) || tokens[1] != "not")
+        message = tr("Rule must start with \"send not\", \"receive not\" or \"marker not\"");
+    else if (tokens.size() > 2 && tokens[2] == "received")
+    {
+        if (r.trigger != send_event)
+            message = tr("Only sends are received");
+        r.response = receive_event;
+        r.match = peer_process;
+        i = 3;
+    }
+    else if (tokens.size() > 4 && tokens[2] == "followed" && tokens[3] == "by")
+    {
+        if (!readKind(tokens[4], r.response))
+            message = tr("Event kind expected after \"followed by\"");
+        else if (r.response == r.trigger)
+            message = tr("Response must differ from the trigger");
+        r.match = same_process;
+        i = 5;
+    }
+    else
+        message = tr("\"received\" or \"followed by\" expected");
+
+    if (message.isEmpty())
+    {
+        if (i >= tokens.size() || tokens[i] != "within")
+            message = tr("\"within\" expected");
+        else if (!read_time(tokens, ++i, r.timeout) || i != tokens.size())
+            message = tr("Time expected after \"within\"");
+    }
+
+    if (!message.isEmpty())
+    {
+        if (error) *error = message;
+        return false;
+    }
+
+    *this = r;
+    return true;
+}
+
+bool Rule_engine::Key::operator<(const Key& o) const
+{
+    if (source != o.source) return source < o.source;
+    if (target != o.target) return target < o.target;
+    return tag < o.tag;
+}
+
+Rule_engine::Rule_engine(const Rule& rule, std::vector<Event_entry>& violations)
+: rule_(rule), violations_(violations), last_key_(keys_.end())
+{
+}
+
+void Rule_engine::finish()
+{
+    expire(~(uint64_t)0);
+}
+
+/* Events of one key usually come in runs, so the last key is
+   checked before the map. */
+Rule_engine::Key_map::iterator Rule_engine::find(const Key& key)
+{
+    if (last_key_ != keys_.end() && !(last_key_->first < key) && !(key < last_key_->first))
+        return last_key_;
+
+    Key_state empty = { 0, 0 };
+    last_key_ = keys_.insert(std::make_pair(key, empty)).first;
+    return last_key_;
+}
+
+void Rule_engine::trigger(const Event_entry& e)
+{
+    Key key = { e.process, e.process, 0 };
+    if (rule_.match == Rule::peer_process)
+    {
+        key.target = e.peer;
+        key.tag = e.tag;
+    }
+
+    Key_map::iterator k = find(key);
+    Waiting w = { e, k, k->second.triggers++ };
+    waiting_.push_back(w);
+}
+
+void Rule_engine::respond(const Event_entry& e)
+{
+    Key key = { e.process, e.process, 0 };
+    if (rule_.match == Rule::peer_process)
+    {
+        key.source = e.peer;
+        key.tag = e.tag;
+    }
+
+    Key_map::iterator k = find(key);
+    if (k->second.responses < k->second.triggers)
+        ++k->second.responses;
+}
+
+/* A trigger is violating if the key has not got as many responses
+   as to reach it by the timeout. A late response is still matched
+   with it, so that the following triggers keep their responses. */
+void Rule_engine::expire(uint64_t time)
+{
+    while (!waiting_.empty())
+    {
+        const Waiting& w = waiting_.front();
+        if (time != ~(uint64_t)0 && w.event.time + rule_.timeout >= time)
+            break;
+
+        if (w.index >= w.key->second.responses)
+            violations_.push_back(w.event);
+        waiting_.pop_front();
+    }
+}
+
+}
@@ -0,0 +1,107 @@
+#ifndef RULES_HPP
+#define RULES_HPP
+
+#include "trace_store.h"
+
+#include <QString>
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <stdint.h>
+
+namespace vis4 {
+
+/** Temporal rule of the rule checker: an event of the trigger kind
+    must be followed by an event of the response kind within timeout.
+
+    The rule is written as
+
+    - "send not received within TIME" -- the message is received on
+      the peer process; sends and receives are matched by sender,
+      receiver and tag in the order of sends;
+    - "KIND not followed by KIND within TIME" -- the response is an
+      event of the same process; KIND is send, receive or marker.
+
+    TIME is written as in Query. */
+struct Rule
+{
+    enum Match { same_process, peer_process };
+
+    Rule();
+
+    /** Parses the text. On error returns false and sets error
+        to the description. */
+    bool parse(const QString& text, QString* error = 0);
+
+    uint32_t trigger;           ///< Event_kind
+    uint32_t response;          ///< Event_kind
+    Match match;
+    uint64_t timeout;
+};
+
+/** Checks a rule in one pass over events sorted by time.
+
+    Each trigger waits for a response with the same key: the process,
+    or the sender, receiver and tag for messages. A key is a counter
+    of triggers and responses, and responses are matched with the
+    oldest trigger. Triggers waiting for the timeout are kept in one
+    queue, in the order of time, so the memory is bounded by the
+    number of triggers within the timeout and the number of keys. */
+class Rule_engine
+{
+public:
+    /** Violating triggers are appended to violations, in the order
+        of time. */
+    Rule_engine(const Rule& rule, std::vector<Event_entry>& violations);
+
+    /** Passes the next event. Events must come in the order of time. */
+    void feed(const Event_entry& e)
+    {
+        expire(e.time);
+        if (e.kind == rule_.trigger)
+            trigger(e);
+        else if (e.kind == rule_.response)
+            respond(e);
+    }
+
+    /** Reports the triggers without a response at the end of the trace. */
+    void finish();
+
+private:
+    struct Key
+    {
+        uint32_t source, target, tag;
+        bool operator<(const Key& o) const;
+    };
+
+    struct Key_state
+    {
+        uint64_t triggers;
+        uint64_t responses;
+    };
+
+    typedef std::map<Key, Key_state> Key_map;
+
+    struct Waiting
+    {
+        Event_entry event;
+        Key_map::iterator key;
+        uint64_t index;         ///< Number of the trigger within the key.
+    };
+
+    Key_map::iterator find(const Key& key);
+    void trigger(const Event_entry& e);
+    void respond(const Event_entry& e);
+    void expire(uint64_t time);
+
+    Rule rule_;
+    std::vector<Event_entry>& violations_;
+
+    Key_map keys_;
+    Key_map::iterator last_key_;
+    std::deque<Waiting> waiting_;
+};
+
+}
+#endif
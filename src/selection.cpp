@@ -1,148 +1,199 @@
 #include "selection.h"
+#include "string_table.h"
 
 namespace vis4 { namespace common {
 
 const int Selection::ROOT;
 
+Selection::Selection()
+: tree_(new Tree), filterHash_(0)
+{
+}
+
+Selection::Tree& Selection::tree()
+{
+    if (!tree_.unique())
+        tree_.reset(new Tree(*tree_));
+    return *tree_;
+}
+
+quint64 Selection::titleKey(uint32_t title, int parent)
+{
+    return (quint64(uint32_t(parent + 1)) << 32) | title;
+}
+
+quint64 Selection::flagKey(int link)
+{
+    /* Finalizer of MurmurHash3, so that keys of adjacent links
+       differ in about half of the bits. */
+    quint64 k = quint64(link) + 1;
+    k ^= k >> 33;
+    k *= Q_UINT64_C(0xff51afd7ed558ccd);
+    k ^= k >> 33;
+    k *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    k ^= k >> 33;
+    return k;
+}
+
+void Selection::setFlag(int link, bool enabled)
+{
+    quint32& word = filter_[link >> 5];
+    quint32 bit = 1u << (link & 31);
+    if (bool(word & bit) == enabled) return;
+
+    word ^= bit;
+    filterHash_ ^= flagKey(link);
+    enabledItems_.clear();
+}
+
 int Selection::addItem(const QString & title, int parent)
 {
-    int link = items_.size();
-    items_ << title; filter_ << true;
-    properties_ << QHash<QString, QVariant>();
-    links_ << QList<int>(); parents_ << parent;
+    return addItem(String_table::instance().intern(title), parent);
+}
+
+int Selection::addItem(const char * title, int parent)
+{
+    return addItem(String_table::instance().intern(title), parent);
+}
+
+int Selection::addItem(uint32_t title, int parent)
+{
+    Tree& t = tree();
+
+    int link = t.titles.size();
+    t.titles << title; t.parents << parent;
+    t.children << QList<int>();
 
     if (parent == ROOT)
     {
-        topLevelItems_ << link;
+        t.indexes << t.topLevelItems.size();
+        t.topLevelItems << link;
     }
     else
     {
-        Q_ASSERT(parent < items_.size());
-        links_[parent] << link;
+        Q_ASSERT(parent < t.titles.size());
+        t.indexes << t.children[parent].size();
+        t.children[parent] << link;
     }
 
+    /* Like the linear search it replaces, finds the first item
+       with the title. */
+    quint64 key = titleKey(title, parent);
+    if (!t.links.contains(key))
+        t.links.insert(key, link);
+
+    if ((link >> 5) >= filter_.size())
+        filter_ << 0;
+    setFlag(link, true);
+
     return link;
 }
 
 const QString & Selection::item(int link) const
 {
-    Q_ASSERT(link < items_.size());
-    return items_[link];
+    Q_ASSERT(link < tree_->titles.size());
+    return String_table::instance().string(tree_->titles[link]);
+}
+
+uint32_t Selection::itemTitle(int link) const
+{
+    Q_ASSERT(link < tree_->titles.size());
+    return tree_->titles[link];
 }
 
 const QList<int> & Selection::items(int parent) const
 {
-    Q_ASSERT(parent < items_.size());
-    return (parent == ROOT) ? topLevelItems_ : links_[parent];
+    Q_ASSERT(parent < tree_->titles.size());
+    return (parent == ROOT) ? tree_->topLevelItems : tree_->children[parent];
 }
 
 int Selection::itemLink(int index, int parent) const
 {
-    if (parent == ROOT) {
-        Q_ASSERT(index < topLevelItems_.size());
-        return topLevelItems_[index];
-    }
-
-    Q_ASSERT(parent < items_.size());
-    Q_ASSERT(index < links_[parent].size());
-    return links_[parent][index];
+    const QList<int>& list = items(parent);
+    Q_ASSERT(index < list.size());
+    return list[index];
 }
 
 int Selection::itemLink(const QString & title, int parent) const
 {
-    Q_ASSERT(parent < items_.size());
+    Q_ASSERT(parent < tree_->titles.size());
 
-    foreach (int link, items(parent))
-        if (items_[link] == title) return link;
+    uint32_t id = String_table::instance().find(title);
+    if (id == String_table::no_string) return ROOT;
 
-    return ROOT;
+    return tree_->links.value(titleKey(id, parent), ROOT);
 }
 
 int Selection::itemParent(int link) const
 {
     if (link == Selection::ROOT) return Selection::ROOT;
 
-    Q_ASSERT(link < items_.size());
-    return parents_[link];
+    Q_ASSERT(link < tree_->titles.size());
+    return tree_->parents[link];
 }
 
 int Selection::itemIndex(int link) const
 {
-    Q_ASSERT(link < items_.size());
-    int parent = itemParent(link);
-    if (parent == ROOT)
-        return topLevelItems_.indexOf(link);
-    else
-        return links_[parent].indexOf(link);
+    Q_ASSERT(link < tree_->titles.size());
+    return tree_->indexes[link];
 }
 
 const QList<int> Selection::enabledItems(int parent) const
 {
-    QList<int> items;
+    QHash<int, QList<int> >::const_iterator cached = enabledItems_.constFind(parent);
+    if (cached != enabledItems_.constEnd())
+        return cached.value();
 
-    if (parent == ROOT) {
-        for (int i = 0; i < topLevelItems_.size(); i++)
-        {
-            if (filter_[topLevelItems_[i]])
-                items << itemLink(i);
-        }
-    }
-    else
-    {
-        Q_ASSERT(parent < items_.size());
-        for (int i = 0; i < links_[parent].size(); i++)
-        {
-            if (filter_[links_[parent][i]])
-                items << itemLink(i, parent);
-        }
-    }
+    QList<int> result;
+    foreach (int link, items(parent))
+        if (isEnabled(link)) result << link;
 
-    return items;
+    enabledItems_.insert(parent, result);
+    return result;
 }
 
 
 QVariant Selection::itemProperty(int link, const QString & property) const
 {
-   Q_ASSERT(link < items_.size());
+   Q_ASSERT(link < tree_->titles.size());
 
-   if (!properties_[link].contains(property))
+   QHash<int, QHash<QString, QVariant> >::const_iterator i = properties_.constFind(link);
+   if (i == properties_.constEnd())
         return QVariant();
 
-   return properties_[link][property];
+   return i.value().value(property);
 }
 
 void Selection::setItemProperty(int link, const QString & property, const QVariant & value)
 {
-   Q_ASSERT(link < items_.size());
+   Q_ASSERT(link < tree_->titles.size());
    properties_[link][property] = value;
 }
 
 bool Selection::hasSubitems() const
 {
-    return items_.size() > topLevelItems_.size();
+    return tree_->titles.size() > tree_->topLevelItems.size();
 }
 
 bool Selection::hasChildren(int parent) const
 {
-    Q_ASSERT(parent < items_.size());
     return items(parent).size();
 }
 
 int Selection::itemsCount(int parent) const
 {
-    Q_ASSERT(parent < items_.size());
     return items(parent).size();
 }
 
 int Selection::totalItemsCount() const
 {
-    return items_.size();
+    return tree_->titles.size();
 }
 
 bool Selection::isEnabled(int link) const
 {
-    Q_ASSERT(link < items_.size());
-    return filter_[link];
+    Q_ASSERT(link < tree_->titles.size());
+    return filter_[link >> 5] & (1u << (link & 31));
 }
 
 bool Selection::isEnabled(int index, int parent) const
@@ -152,24 +203,24 @@ bool Selection::isEnabled(int index, int parent) const
 
 void Selection::setEnabled(int link, bool enabled)
 {
-    Q_ASSERT(link < items_.size());
-    filter_[link] = enabled;
+    Q_ASSERT(link < tree_->titles.size());
+    setFlag(link, enabled);
 
-    int parent = parents_[link];
-    if (!enabled && parent != ROOT && filter_[parent])
+    int parent = tree_->parents[link];
+    if (!enabled && parent != ROOT && isEnabled(parent))
     {
-        for (int i = 0; i < itemsCount(parent); i++)
-            if (filter_[itemLink(i, parent)]) return;
+        foreach (int child, items(parent))
+            if (isEnabled(child)) return;
 
         setEnabled(parent, false); return;
     }
 
     if (enabled) {
-        for (int i = 0; i < itemsCount(link); i++)
-            if (filter_[itemLink(i, link)]) return;
+        foreach (int child, items(link))
+            if (isEnabled(child)) return;
 
-        for (int i = 0; i < itemsCount(link); i++)
-            setEnabled(itemLink(i, link), true);
+        foreach (int child, items(link))
+            setEnabled(child, true);
         return;
     }
 }
@@ -181,11 +232,9 @@ void Selection::setEnabled(int index, int parent, bool enabled)
 
 int Selection::enabledCount(int parent) const
 {
-    Q_ASSERT(parent < items_.size());
-
     int count = 0;
     foreach (int  link, items(parent))
-        if (filter_[link]) count++;
+        if (isEnabled(link)) count++;
 
     return count;
 }
@@ -195,10 +244,10 @@ Selection & Selection::enableAll(int parent, bool recursive)
     QList<int> queue = items(parent);
     while (!queue.isEmpty()) {
         int link = queue.takeFirst();
-        filter_[link] = true;
+        setFlag(link, true);
 
         if (recursive)
-            queue << links_[link];
+            queue << tree_->children[link];
     }
 
     return *this;
@@ -209,10 +258,10 @@ Selection & Selection::disableAll(int parent, bool recursive)
     QList<int> queue = items(parent);
     while (!queue.isEmpty()) {
         int link = queue.takeFirst();
-        filter_[link] = false;
+        setFlag(link, false);
 
         if (recursive)
-            queue << links_[link];
+            queue << tree_->children[link];
     }
 
     return *this;
@@ -220,17 +269,20 @@ Selection & Selection::disableAll(int parent, bool recursive)
 
 void Selection::clear()
 {
-    items_.clear();
-    properties_.clear();
+    tree_.reset(new Tree);
     filter_.clear();
-    links_.clear();
-    parents_.clear();
-    topLevelItems_.clear();
+    filterHash_ = 0;
+    properties_.clear();
+    enabledItems_.clear();
 }
 
 bool Selection::operator==(const Selection & other) const
 {
-    Q_ASSERT(items_.size() == other.items_.size());
+    Q_ASSERT(tree_->titles.size() == other.tree_->titles.size());
+
+    /* Different hashes settle most comparisons without looking at
+       the flags. */
+    if (filterHash_ != other.filterHash_) return false;
     return filter_ == other.filter_;
 }
 
@@ -241,10 +293,19 @@ bool Selection::operator!=(const Selection & other) const
 
 Selection Selection::operator&(const Selection & other) const
 {
-    Q_ASSERT(items_.size() == other.items_.size());
+    Q_ASSERT(tree_->titles.size() == other.tree_->titles.size());
     Selection result(*this);
-    for (int i = 0; i < filter_.size(); i++)
-        result.filter_[i] = filter_[i] && other.filter_[i];
+
+    result.filterHash_ = 0;
+    for (int w = 0; w < filter_.size(); w++)
+    {
+        quint32 word = filter_[w] & other.filter_[w];
+        result.filter_[w] = word;
+
+        for (int b = 0; word; ++b, word >>= 1)
+            if (word & 1) result.filterHash_ ^= flagKey(w*32 + b);
+    }
+    result.enabledItems_.clear();
 
     return result;
 }
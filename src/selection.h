@@ -6,6 +6,10 @@
 #include <QVariant>
 #include <QHash>
 
+#include <boost/shared_ptr.hpp>
+
+#include <stdint.h>
+
 namespace vis4 {
     namespace common {
 
@@ -19,6 +23,8 @@ public: /* static constants */
 
 public: /* methods */
 
+    Selection();
+
     bool hasSubitems() const;
 
 /** @defgroup operations Methods for operation on items. */
@@ -27,8 +33,15 @@ public: /* methods */
     int totalItemsCount() const;
 
     int addItem(const QString & title, int parent = ROOT);
+    int addItem(const char * title, int parent = ROOT);
     const QString & item(int link) const;
 
+    /** Adds item with the title interned in String_table. */
+    int addItem(uint32_t title, int parent);
+
+    /** Returns identifier of the item title in String_table. */
+    uint32_t itemTitle(int link) const;
+
     bool hasChildren(int parent) const;
     int itemsCount(int parent = ROOT) const;
     const QList<int> & items(int parent = ROOT) const;
@@ -68,16 +81,51 @@ public: /* methods */
 
     Selection operator&(const Selection & other) const;
 
+private: /* types */
+
+    /** Items and their hierarchy. Built once when the trace is
+        loaded, so it is shared by all copies of the selection and
+        copied only if a shared copy gets a new item. */
+    struct Tree
+    {
+        /** Identifiers of titles in String_table. */
+        QVector<uint32_t> titles;
+        QVector<int> parents;
+        QVector<int> indexes;           ///< Index of the item in its parent.
+        QVector< QList<int> > children;
+        QList<int> topLevelItems;
+
+        /** Link by parent and title, see titleKey. */
+        QHash<quint64, int> links;
+    };
+
+private: /* methods */
+
+    Tree& tree();
+    static quint64 titleKey(uint32_t title, int parent);
+
+    /** Sets the enable flag, updating the hash. */
+    void setFlag(int link, bool enabled);
+
+    /** Key of the link in the hash of enable flags. */
+    static quint64 flagKey(int link);
+
 private: /* members */
 
-    QVector<QString> items_;
-    QVector<bool> filter_;
+    boost::shared_ptr<Tree> tree_;
+
+    /** Enable flags, one bit per item. */
+    QVector<quint32> filter_;
+
+    /** Exclusive or of flagKey of all enabled items. Selections
+        with different hashes are never equal. */
+    quint64 filterHash_;
 
-    QVector< QHash<QString, QVariant> > properties_;
+    /** Properties of the items that have any. */
+    QHash<int, QHash<QString, QVariant> > properties_;
 
-    QVector< QList<int> > links_;
-    QVector<int> parents_;
-    QList<int> topLevelItems_;
+    /** Results of enabledItems, dropped when flags change. */
+    mutable QHash<int, QList<int> > enabledItems_;
 
 };
 
@@ -0,0 +1,157 @@
+#include "string_table.h"
+
+#include <QByteArray>
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+namespace vis4 { namespace common {
+
+const uint32_t String_table::no_string;
+const size_t String_table::chunk_size;
+
+String_table& String_table::instance()
+{
+    static String_table table;
+    return table;
+}
+
+String_table::String_table()
+: slots_(64, 0), chunk_(0), chunk_used_(chunk_size)
+{
+}
+
+String_table::~String_table()
+{
+    for (unsigned i = 0; i < chunks_.size(); ++i)
+        free(chunks_[i]);
+}
+
+uint32_t String_table::intern(const char* chars, size_t length)
+{
+    uint32_t h = hash(chars, length);
+    size_t s = slot(chars, length, h);
+    if (slots_[s])
+        return slots_[s] - 1;
+
+    Entry e = { store(chars, length), (uint32_t)length, h };
+    entries_.push_back(e);
+    slots_[s] = (uint32_t)entries_.size();
+
+    /* Load factor is kept below one half. */
+    if (entries_.size() * 2 > slots_.size())
+        grow();
+
+    return (uint32_t)entries_.size() - 1;
+}
+
+uint32_t String_table::intern(const char* chars)
+{
+    return intern(chars, strlen(chars));
+}
+
+uint32_t String_table::intern(const QString& s)
+{
+    QByteArray bytes = s.toUtf8();
+    return intern(bytes.constData(), bytes.size());
+}
+
+uint32_t String_table::find(const QString& s) const
+{
+    QByteArray bytes = s.toUtf8();
+    size_t found = slot(bytes.constData(), bytes.size(), hash(bytes.constData(), bytes.size()));
+    return slots_[found] ? slots_[found] - 1 : no_string;
+}
+
+const QString& String_table::string(uint32_t id) const
+{
+    assert(id < entries_.size());
+
+    /* Appending to a deque keeps references to its elements. */
+    if (strings_.size() < entries_.size())
+    {
+        strings_.resize(entries_.size());
+        materialized_.resize(entries_.size(), false);
+    }
+
+    if (!materialized_[id])
+    {
+        strings_[id] = QString::fromUtf8(entries_[id].chars, entries_[id].length);
+        materialized_[id] = true;
+    }
+    return strings_[id];
+}
+
+uint32_t String_table::hash(const char* chars, size_t length)
+{
+    /* FNV-1a. */
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+    {
+        h ^= (unsigned char)chars[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+size_t String_table::slot(const char* chars, size_t length, uint32_t hash) const
+{
+    size_t mask = slots_.size() - 1;
+    for (size_t s = hash & mask;; s = (s + 1) & mask)
+    {
+        if (!slots_[s])
+            return s;
+
+        const Entry& e = entries_[slots_[s] - 1];
+        if (e.hash == hash && e.length == length && memcmp(e.chars, chars, length) == 0)
+            return s;
+    }
+}
+
+const char* String_table::store(const char* chars, size_t length)
+{
+    size_t size = length + 1;
+    char* p;
+
+    if (size > chunk_size / 4)
+    {
+        /* Long strings get a chunk of their own, so the current
+           chunk is not abandoned half-empty. */
+        p = static_cast<char*>(malloc(size));
+        assert(p);
+        chunks_.push_back(p);
+    }
+    else
+    {
+        if (chunk_used_ + size > chunk_size)
+        {
+            chunk_ = static_cast<char*>(malloc(chunk_size));
+            assert(chunk_);
+            chunks_.push_back(chunk_);
+            chunk_used_ = 0;
+        }
+        p = chunk_ + chunk_used_;
+        chunk_used_ += size;
+    }
+
+    memcpy(p, chars, length);
+    p[length] = '\0';
+    return p;
+}
+
+void String_table::grow()
+{
+    std::vector<uint32_t> table(slots_.size() * 2, 0);
+    size_t mask = table.size() - 1;
+
+    for (unsigned id = 0; id < entries_.size(); ++id)
+    {
+        size_t s = entries_[id].hash & mask;
+        while (table[s]) s = (s + 1) & mask;
+        table[s] = id + 1;
+    }
+    slots_.swap(table);
+}
+
+}} // namespaces
@@ -0,0 +1,98 @@
+#ifndef STRING_TABLE_HPP
+#define STRING_TABLE_HPP
+
+#include <QString>
+
+#include <vector>
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vis4 {
+    namespace common {
+
+/** Table of interned strings.
+
+    Names of components, functions, states and event kinds are
+    stored once, in an arena, and referred to by 32-bit identifiers.
+    QString for an identifier is created only when the name is shown,
+    and is kept for later calls.
+
+    The table is not thread safe; it is used from the GUI thread. */
+class String_table {
+
+public: /* static constants */
+
+    static const uint32_t no_string = 0xffffffffu;
+
+public: /* methods */
+
+    /** Table shared by all selections and models. */
+    static String_table& instance();
+
+    String_table();
+    ~String_table();
+
+    /** Returns identifier of the string, adding it if necessary. */
+    uint32_t intern(const char* chars, size_t length);
+    uint32_t intern(const char* chars);
+    uint32_t intern(const QString& s);
+
+    /** Returns identifier of the string, or no_string if the string
+        was never interned. */
+    uint32_t find(const QString& s) const;
+
+    /** Returns null-terminated UTF-8 bytes of the string. */
+    const char* chars(uint32_t id) const { return entries_[id].chars; }
+    uint32_t length(uint32_t id) const { return entries_[id].length; }
+
+    /** Returns the string as QString. The reference stays valid for
+        the lifetime of the table. */
+    const QString& string(uint32_t id) const;
+
+    int count() const { return (int)entries_.size(); }
+
+private: /* types */
+
+    struct Entry
+    {
+        const char* chars;
+        uint32_t length;
+        uint32_t hash;
+    };
+
+    static const size_t chunk_size = 64 * 1024;
+
+private: /* methods */
+
+    String_table(const String_table&);
+    String_table& operator=(const String_table&);
+
+    static uint32_t hash(const char* chars, size_t length);
+
+    /** Returns the slot holding the string, or the empty slot where
+        it would be inserted. */
+    size_t slot(const char* chars, size_t length, uint32_t hash) const;
+
+    const char* store(const char* chars, size_t length);
+    void grow();
+
+private: /* members */
+
+    std::vector<Entry> entries_;
+
+    /** Open addressing hash table of identifiers plus one; zero marks
+        an empty slot. */
+    std::vector<uint32_t> slots_;
+
+    std::vector<char*> chunks_;
+    char* chunk_;               ///< Chunk being filled.
+    size_t chunk_used_;
+
+    mutable std::deque<QString> strings_;
+    mutable std::vector<bool> materialized_;
+};
+
+}} // namespaces
+
+#endif
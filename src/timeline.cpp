@@ -2,10 +2,14 @@
 #include "trace_painter.h"
 #include <timeunit_control.h>
 
+#include <QMouseEvent>
+
+#include <math.h>
+
 namespace vis4 {
 
 Timeline::Timeline(QWidget* parent, Trace_painter * painter)
-    : QWidget(parent), tp(painter)
+    : QWidget(parent), tp(painter), has_activity_(false)
 {
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Maximum);
 
@@ -16,7 +20,8 @@ Timeline::Timeline(QWidget* parent, Trace_painter * painter)
 
 QSize Timeline::sizeHint() const
 {
-    return QSize(-1, Trace_painter::timeline_text_top + QFontMetrics(font()).height());
+    return QSize(-1, activity_height + Trace_painter::timeline_text_top
+                 + QFontMetrics(font()).height());
 }
 
 QSize Timeline::minimumSizeHint() const
@@ -28,9 +33,11 @@ void Timeline::paintEvent(QPaintEvent* e)
 {
     if (!tp) return;
 
-    // Draw time notches and labels.
     QPainter p(this);
-    tp->drawTimeline(&p, 0, 0);
+    drawActivity(&p);
+
+    // Draw time notches and labels.
+    tp->drawTimeline(&p, 0, activity_height);
 
     // Draw time unit control.
     QSize size = timeUnitControl->sizeHint();
@@ -39,4 +46,55 @@ void Timeline::paintEvent(QPaintEvent* e)
 
     QWidget::paintEvent(e);
 }
+
+void Timeline::mousePressEvent(QMouseEvent* e)
+{
+    if (!has_activity_ || e->button() != Qt::LeftButton
+        || e->y() >= activity_height)
+        return QWidget::mousePressEvent(e);
+
+    int x = e->x();
+    if (x < tp->left_margin || x >= width() - tp->right_margin)
+        return QWidget::mousePressEvent(e);
+
+    emit activityClicked(tp->timeForPixel(x));
+}
+
+void Timeline::drawActivity(QPainter* painter)
+{
+    const Trace_model::Ptr& model = tp->traceModel();
+    int bins = width() - tp->left_margin - tp->right_margin;
+    if (!model || bins <= 0)
+    {
+        has_activity_ = false;
+        return;
+    }
+
+    if (model != activity_model_ || (int)activity_.size() != bins)
+    {
+        activity_model_ = model;
+        has_activity_ = model->activity(bins, activity_);
+    }
+    if (!has_activity_) return;
+
+    double top = 0;
+    for (int i = 0; i < bins; ++i)
+        top = qMax(top, activity_[i].events + activity_[i].messages);
+    double scale = top > 0 ? (activity_height - 2) / log(1 + top) : 0;
+
+    painter->fillRect(0, 0, width(), activity_height, Qt::white);
+    for (int i = 0; i < bins; ++i)
+    {
+        const Activity_bin& a = activity_[i];
+        int x = tp->left_margin + i;
+
+        /* A state without events is shown as a thin line. */
+        int h = (int)ceil(log(1 + a.events + a.messages) * scale);
+        if (a.state != -1) h = qMax(h, 2);
+        if (h == 0) continue;
+
+        painter->setPen(a.state != -1 ? QColor(a.color) : QColor(Qt::darkGray));
+        painter->drawLine(x, activity_height - h, x, activity_height - 1);
+    }
+}
 }
@@ -1,8 +1,12 @@
 #ifndef TIMELINE_HPP_VP_2006_03_21
 #define TIMELINE_HPP_VP_2006_03_21
 
+#include "trace_model.h"
+
 #include <QWidget>
 
+#include <vector>
+
 namespace vis4 {
 
 class Trace_painter;
@@ -25,19 +29,37 @@ public: // QWidget overides
     QSize sizeHint() const;
     QSize minimumSizeHint() const;
 
+    /** The height of the activity strip above the time notches. */
+    static const int activity_height = 12;
+
 signals:
 
     void timeSettingsChanged();
 
+    /** Emitted when the activity strip is clicked at time. */
+    void activityClicked(const common::Time& time);
+
 protected:
 
     void paintEvent(QPaintEvent* e);
+    void mousePressEvent(QMouseEvent* e);
 
 private:
 
+    /** Draws the activity of the model, one column per pixel: the height
+        shows the number of events and messages, on the logarithmic scale,
+        and the color shows the dominant state. */
+    void drawActivity(QPainter* painter);
+
     Trace_painter *tp;
     common::TimeUnitControl * timeUnitControl;
 
+    /** Activity of activity_model_, computed when the model or the
+        width changes. */
+    std::vector<Activity_bin> activity_;
+    Trace_model::Ptr activity_model_;
+    bool has_activity_;
+
 };
 
 }
@@ -168,20 +168,9 @@ public:
     void update(Canvas * canvas, int component, const Time & time)
     {
         trace_ = canvas->model();
-        int parent_component = trace_->parent_component();
-
-        Selection component_filter = trace_->components();
-        component = trace_->visible_components()[trace_->lifeline(component)];
-        component_filter.disableAll(parent_component);
-        component_filter.setEnabled(component, true);
 
         QPair<Time, Time> nearby = canvas->nearby_range(time);
-        filtered_ = trace_->set_range(nearby.first, nearby.second);
-        filtered_ = filtered_->filter_components(component_filter);
-
-        filtered_->rewind();
-
-        eventList->showEvents(filtered_, time);
+        eventList->showEvents(trace_, component, nearby.first, nearby.second, time);
 
         if (eventList->model()->rowCount() == 1)
             eventList->hide();
@@ -239,7 +228,7 @@ private slots:
                 infoLayout->setRowStretch(2, 1);
             }
 
-            nameLabel->setText(event->kind);
+            nameLabel->setText(event->kindName());
             timeLabel->setText(event->time.toString(true));
             using_default_details = true;
         }
@@ -305,7 +294,6 @@ private:
     bool using_default_details;
 
     Trace_model::Ptr trace_;
-    Trace_model::Ptr filtered_;
 };
 
 
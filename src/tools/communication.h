@@ -0,0 +1,310 @@
+#ifndef COMMUNICATION_HPP
+#define COMMUNICATION_HPP
+
+#include "tool.h"
+#include "trace_model.h"
+#include "part_workers.h"
+#include "canvas.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QGroupBox>
+#include <QLabel>
+#include <QComboBox>
+#include <QTime>
+#include <QAction>
+#include <QImage>
+#include <QPainter>
+#include <QMouseEvent>
+#include <QToolTip>
+#include <QMap>
+#include <QHash>
+
+#include <vector>
+#include <math.h>
+
+namespace vis4 {
+
+/** Heat map of the communication matrix. Senders are rows and receivers
+    are columns, in the order of components. When there are more
+    components than pixels, a pixel sums the pairs falling into it, so
+    the image is built from the nonzero pairs only. */
+class Communication_matrix : public QWidget
+{
+    Q_OBJECT
+public:
+    enum Measure { messages, bytes, latency };
+
+    Communication_matrix(QWidget* parent)
+    : QWidget(parent), measure_(messages)
+    {
+        setMouseTracking(true);
+        setMinimumSize(100, 100);
+        setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    }
+
+    void setData(const Trace_model::Ptr& model, std::vector<Communication_entry>& entries)
+    {
+        model_ = model;
+        entries_.swap(entries);
+
+        /* Only the components taking part in the communication are shown. */
+        QMap<int, int> index;
+        for (unsigned i = 0; i < entries_.size(); ++i)
+        {
+            index[entries_[i].sender] = 0;
+            index[entries_[i].receiver] = 0;
+        }
+
+        components_.clear();
+        index_.clear();
+        QMap<int, int>::const_iterator i;
+        for (i = index.constBegin(); i != index.constEnd(); ++i)
+        {
+            index_[i.key()] = components_.size();
+            components_ << i.key();
+        }
+
+        image_ = QImage();
+        update();
+    }
+
+    void setMeasure(Measure measure)
+    {
+        measure_ = measure;
+        image_ = QImage();
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent*)
+    {
+        QPainter painter(this);
+        if (components_.isEmpty())
+        {
+            painter.drawText(rect(), Qt::AlignCenter, tr("No messages"));
+            return;
+        }
+
+        if (image_.size() != size())
+            buildImage();
+        painter.drawImage(0, 0, image_);
+    }
+
+    void mouseMoveEvent(QMouseEvent* event)
+    {
+        if (components_.isEmpty() || image_.isNull()) return;
+
+        int n = components_.size();
+        int sender = event->pos().y() * n / height();
+        int receiver = event->pos().x() * n / width();
+        if (sender < 0 || sender >= n || receiver < 0 || receiver >= n) return;
+
+        int pixel = event->pos().y() * width() + event->pos().x();
+        QString text = tr("%1 to %2<br>Messages: %3<br>Bytes: %4")
+            .arg(model_->component_name(components_[sender]))
+            .arg(model_->component_name(components_[receiver]))
+            .arg(pixel_messages_[pixel])
+            .arg(pixel_bytes_[pixel]);
+        if (pixel_messages_[pixel])
+        {
+            text += "<br>" + tr("Mean latency: %1")
+                .arg(duration(pixel_latency_[pixel] / pixel_messages_[pixel]));
+        }
+
+        QToolTip::showText(event->globalPos(), text, this);
+    }
+
+private:
+    /** Sums the pairs into pixels and colors the pixels by the
+        logarithm of the sum, white for none, dark red for the most. */
+    void buildImage()
+    {
+        int w = width(), h = height(), n = components_.size();
+
+        pixel_messages_.assign(w * h, 0);
+        pixel_bytes_.assign(w * h, 0);
+        pixel_latency_.assign(w * h, 0);
+
+        for (unsigned i = 0; i < entries_.size(); ++i)
+        {
+            const Communication_entry& e = entries_[i];
+            int y0 = index_[e.sender] * h / n, y1 = qMax(y0 + 1, (index_[e.sender] + 1) * h / n);
+            int x0 = index_[e.receiver] * w / n, x1 = qMax(x0 + 1, (index_[e.receiver] + 1) * w / n);
+
+            /* Latency is summed from the bins, taking the middle of each. */
+            int64_t total = 0;
+            for (int b = 0; b < Communication_entry::latency_bins; ++b)
+                total += (int64_t)e.latency[b] * (((int64_t)3 << b) / 2 - 1);
+
+            for (int y = y0; y < y1; ++y)
+                for (int x = x0; x < x1; ++x)
+                {
+                    int p = y * w + x;
+                    pixel_messages_[p] += e.messages;
+                    pixel_bytes_[p] += e.bytes;
+                    pixel_latency_[p] += total;
+                }
+        }
+
+        std::vector<double> value(w * h, 0);
+        double top = 0;
+        for (int p = 0; p < w * h; ++p)
+        {
+            if (!pixel_messages_[p]) continue;
+            switch (measure_)
+            {
+                case messages: value[p] = pixel_messages_[p]; break;
+                case bytes: value[p] = pixel_bytes_[p]; break;
+                case latency: value[p] = pixel_latency_[p] / pixel_messages_[p]; break;
+            }
+            value[p] = log(1 + value[p]);
+            top = qMax(top, value[p]);
+        }
+
+        image_ = QImage(w, h, QImage::Format_RGB32);
+        image_.fill(qRgb(255, 255, 255));
+        for (int p = 0; p < w * h; ++p)
+        {
+            if (!pixel_messages_[p]) continue;
+
+            double v = top > 0 ? value[p] / top : 1;
+            QColor c = QColor::fromHsv((int)(60 * (1 - v)), 40 + (int)(215 * v),
+                                       255 - (int)(100 * v));
+            image_.setPixel(p % w, p / w, c.rgb());
+        }
+    }
+
+    QString duration(int64_t ticks) const
+    {
+        return (model_->ticks_time(ticks) - model_->ticks_time(0)).toString(true);
+    }
+
+    Trace_model::Ptr model_;
+    std::vector<Communication_entry> entries_;
+    QList<int> components_;
+    QHash<int, int> index_;
+    Measure measure_;
+
+    QImage image_;
+    std::vector<int64_t> pixel_messages_;
+    std::vector<int64_t> pixel_bytes_;
+    std::vector<int64_t> pixel_latency_;
+};
+
+/** Shows who sends messages to whom within the visible time range.
+    The matrix is computed by Trace_model::communication in one thread
+    per processor, and again after the view changes. */
+class Communication : public Range_tool
+{
+    Q_OBJECT
+public:
+    Communication(QWidget* parent, Canvas* c)
+    : Range_tool(parent, c)
+    {
+        setObjectName("communication");
+        setWhatsThis(tr("<b>Communication</b>"
+                        "<p>Shows the messages sent within the visible part "
+                        "of the trace as a matrix, senders in rows and receivers "
+                        "in columns. Darker cells have more messages, bytes or "
+                        "longer latency. Point at a cell to see the numbers."));
+
+        setWindowTitle(tr("Communication"));
+
+        QVBoxLayout* mainLayout = new QVBoxLayout(this);
+
+        QGroupBox* group = new QGroupBox(tr("Communication"), this);
+        group->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+        mainLayout->addWidget(group);
+
+        QVBoxLayout* layout = new QVBoxLayout(group);
+
+        QHBoxLayout* measureLayout = new QHBoxLayout();
+        layout->addLayout(measureLayout);
+        measureLayout->addWidget(new QLabel(tr("Show:"), group));
+
+        measure_ = new QComboBox(group);
+        measure_->addItem(tr("Messages"));
+        measure_->addItem(tr("Bytes"));
+        measure_->addItem(tr("Mean latency"));
+        measureLayout->addWidget(measure_);
+        measureLayout->addStretch();
+        connect(measure_, SIGNAL(currentIndexChanged(int)),
+                this, SLOT(measureChanged(int)));
+
+        matrix_ = new Communication_matrix(group);
+        layout->addWidget(matrix_);
+
+        status_ = new QLabel(group);
+        status_->setWordWrap(true);
+        layout->addWidget(status_);
+    }
+
+    QAction* createAction()
+    {
+        QAction* action = new QAction(QIcon(":/coloredit.png"), tr("&Communication"), this);
+        action->setShortcut(QKeySequence(Qt::Key_C));
+        return action;
+    }
+
+private slots:
+
+    void measureChanged(int index)
+    {
+        matrix_->setMeasure((Communication_matrix::Measure)index);
+    }
+
+    void compute()
+    {
+        stop();
+
+        computed_ = model()->set_range(model()->min_time(), model()->max_time());
+        workers_.start(computed_, &Trace_model::communication, computed_->search_parts(),
+                       this, SLOT(workerFinished()));
+
+        started_.start();
+        status_->setText(tr("Computing..."));
+    }
+
+    void workerFinished()
+    {
+        if (!workers_.finished()) return;
+
+        std::vector<Communication_entry> entries;
+        std::vector<const std::vector<Communication_entry>*> results = workers_.results();
+        for (unsigned i = 0; i < results.size(); ++i)
+            entries.insert(entries.end(), results[i]->begin(), results[i]->end());
+        workers_.stop();
+
+        int pairs = (int)entries.size();
+        matrix_->setData(computed_, entries);
+        status_->setText(tr("%1 pairs, computed in %2 ms")
+                         .arg(pairs).arg(started_.elapsed()));
+    }
+
+private:
+
+    void stop()
+    {
+        workers_.stop();
+    }
+
+private:
+    QComboBox* measure_;
+    Communication_matrix* matrix_;
+    QLabel* status_;
+
+    Trace_model::Ptr computed_;
+    Part_workers<std::vector<Communication_entry> > workers_;
+    QTime started_;
+};
+
+
+Tool* createCommunication(QWidget* parent, Canvas* canvas)
+{
+    return new Communication(parent, canvas);
+}
+
+}
+
+#endif
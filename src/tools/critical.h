@@ -0,0 +1,387 @@
+#ifndef CRITICAL_HPP
+#define CRITICAL_HPP
+
+#include "tool.h"
+#include "trace_model.h"
+#include "part_workers.h"
+#include "critical_path.h"
+#include "canvas.h"
+#include "canvas_item.h"
+
+#include <QVBoxLayout>
+#include <QGroupBox>
+#include <QLabel>
+#include <QTreeView>
+#include <QStandardItemModel>
+#include <QTime>
+#include <QAction>
+#include <QPainter>
+#include <QMap>
+
+#include <vector>
+#include <algorithm>
+
+namespace vis4 {
+
+using common::Time;
+
+/** Draws the critical path over the trace: segments within components
+    along the lifelines and messages as lines from the sender to the
+    receiver. The selected segment is drawn wider. */
+class Critical_path_overlay : public CanvasItem
+{
+public:
+    Critical_path_overlay(Canvas* canvas)
+    : canvas_(canvas), shown_(true), selected_(-1)
+    {}
+
+    void setPath(const std::vector<Path_segment>& path)
+    {
+        path_ = path;
+        selected_ = -1;
+        refresh();
+    }
+
+    void setSelected(int segment)
+    {
+        selected_ = segment;
+        refresh();
+    }
+
+    void setShown(bool shown)
+    {
+        shown_ = shown;
+        refresh();
+    }
+
+    void refresh()
+    {
+        new_geomerty(pdraw(0));
+    }
+
+private: // CanvasItem override
+    QRect xdraw(QPainter& painter)
+    {
+        if (shown_)
+            return pdraw(&painter);
+        else
+            return pdraw(0);
+    }
+
+    QRect pdraw(QPainter* painter)
+    {
+        QRect total;
+
+        Trace_model::Ptr model = canvas_->model();
+        if (!shown_ || !model || path_.empty())
+            return total;
+
+        int64_t min = model->time_ticks(model->min_time());
+        int64_t max = model->time_ticks(model->max_time());
+
+        if (painter)
+        {
+            painter->save();
+            painter->setRenderHint(QPainter::Antialiasing);
+        }
+
+        for (unsigned i = 0; i < path_.size(); ++i)
+        {
+            const Path_segment& s = path_[i];
+            if (s.end < min || s.begin > max) continue;
+
+            int to = model->lifeline(s.component);
+            int from = model->lifeline(s.from_component);
+            if (to == -1 || from == -1) continue;
+
+            QPoint a = canvas_->lifeline_point(
+                from, model->ticks_time(std::max(s.begin, min)));
+            QPoint b = canvas_->lifeline_point(
+                to, model->ticks_time(std::min(s.end, max)));
+
+            int width = s.kind == Path_segment::local ? 4 : 2;
+            if ((int)i == selected_) width += 3;
+
+            total |= QRect(a, b).normalized().adjusted(-width, -width, width, width);
+
+            if (painter)
+            {
+                QColor red(Qt::red);
+                red.setAlpha(160);
+                painter->setPen(QPen(red, width, Qt::SolidLine, Qt::RoundCap));
+                painter->drawLine(a, b);
+            }
+        }
+
+        if (painter)
+            painter->restore();
+
+        return total;
+    }
+
+private:
+    Canvas* canvas_;
+    std::vector<Path_segment> path_;
+    bool shown_;
+    int selected_;
+};
+
+/** Finds the critical path within the time range visible when the tool
+    is activated and shows it on the trace, with the time of the path
+    blamed on the states.
+
+    The messages and calls are collected by
+    Trace_model::critical_path_part in one thread per processor, and
+    the path is found by find_critical_path once all are done. */
+class Critical_path : public Tool
+{
+    Q_OBJECT
+public:
+    Critical_path(QWidget* parent, Canvas* c)
+    : Tool(parent, c)
+    {
+        setObjectName("critical_path");
+        setWhatsThis(tr("<b>Critical path</b>"
+                        "<p>Shows the longest chain of work within the part of "
+                        "the trace visible when the tool is opened, where a process "
+                        "waiting for a message continues the chain of the sender. "
+                        "The time on the path is listed by the states taking it, "
+                        "and by messages. Click a segment to select it on the "
+                        "trace, double click to zoom to it."));
+
+        setWindowTitle(tr("Critical path"));
+
+        QVBoxLayout* mainLayout = new QVBoxLayout(this);
+
+        QGroupBox* group = new QGroupBox(tr("Critical path"), this);
+        group->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+        mainLayout->addWidget(group);
+
+        QVBoxLayout* layout = new QVBoxLayout(group);
+
+        status_ = new QLabel(group);
+        status_->setWordWrap(true);
+        layout->addWidget(status_);
+
+        table_ = new QStandardItemModel(this);
+        table_->setHorizontalHeaderLabels(QStringList()
+            << tr("Blame") << tr("Time") << tr("Segments"));
+
+        view_ = new QTreeView(group);
+        view_->setModel(table_);
+        view_->setUniformRowHeights(true);
+        view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        layout->addWidget(view_);
+
+        connect(view_, SIGNAL(clicked(const QModelIndex&)),
+                this, SLOT(segmentClicked(const QModelIndex&)));
+        connect(view_, SIGNAL(doubleClicked(const QModelIndex&)),
+                this, SLOT(segmentDoubleClicked(const QModelIndex&)));
+
+        connect(canvas(), SIGNAL(modelChanged(Trace_model::Ptr &)),
+                this, SLOT(modelChanged(Trace_model::Ptr &)));
+
+        overlay_ = new Critical_path_overlay(canvas());
+        canvas()->addItem(overlay_);
+        overlay_->setShown(false);
+    }
+
+    QAction* createAction()
+    {
+        QAction* action = new QAction(QIcon(":/link.png"), tr("Critical pa&th"), this);
+        action->setShortcut(QKeySequence(Qt::Key_T));
+        return action;
+    }
+
+    void activate()
+    {
+        overlay_->setShown(true);
+        compute();
+    }
+
+    void deactivate()
+    {
+        stop();
+        overlay_->setShown(false);
+    }
+
+private slots:
+
+    /** The path stays the same while the view is zoomed and
+        scrolled to see it, it's only drawn again. */
+    void modelChanged(Trace_model::Ptr &)
+    {
+        overlay_->refresh();
+    }
+
+    void compute()
+    {
+        stop();
+
+        computed_ = model()->set_range(model()->min_time(), model()->max_time());
+        workers_.start(computed_, &Trace_model::critical_path_part, computed_->search_parts(),
+                       this, SLOT(workerFinished()));
+
+        started_.start();
+        status_->setText(tr("Computing..."));
+    }
+
+    void workerFinished()
+    {
+        if (!workers_.finished()) return;
+
+        path_.clear();
+        find_critical_path(workers_.results(), computed_->time_ticks(computed_->min_time()), path_);
+        workers_.stop();
+
+        overlay_->setPath(path_);
+        showPath();
+
+        int64_t length = path_.empty() ? 0 : path_.back().end - path_.front().begin;
+        status_->setText(tr("Length %1, %2 segments, computed in %3 ms")
+                         .arg(duration(length)).arg(path_.size())
+                         .arg(started_.elapsed()));
+    }
+
+    void segmentClicked(const QModelIndex& index)
+    {
+        QVariant segment = index.sibling(index.row(), 0).data(Qt::UserRole);
+        overlay_->setSelected(segment.isValid() ? segment.toInt() : -1);
+    }
+
+    void segmentDoubleClicked(const QModelIndex& index)
+    {
+        QVariant segment = index.sibling(index.row(), 0).data(Qt::UserRole);
+        if (!segment.isValid()) return;
+
+        /* The segment is shown in the middle third of the view. */
+        const Path_segment& s = path_[segment.toInt()];
+        int64_t margin = qMax((int64_t)1, s.end - s.begin);
+        canvas()->setModel(model()->set_range(
+            model()->ticks_time(s.begin - margin),
+            model()->ticks_time(s.end + margin)));
+    }
+
+private:
+
+    void stop()
+    {
+        workers_.stop();
+    }
+
+    /** Lists the time of the path blamed on each state, and on
+        messages, with the longest segments of each. */
+    void showPath()
+    {
+        table_->removeRows(0, table_->rowCount());
+
+        /* Segments of each state, -2 for messages. */
+        QMap<int, std::vector<int> > blamed;
+        QMap<int, int64_t> times;
+        for (unsigned i = 0; i < path_.size(); ++i)
+        {
+            const Path_segment& s = path_[i];
+            int key = s.kind == Path_segment::message ? -2 : s.type;
+            blamed[key].push_back(i);
+            times[key] += s.end - s.begin;
+        }
+
+        QList<QPair<int64_t, int> > order;
+        QMap<int, int64_t>::const_iterator i;
+        for (i = times.constBegin(); i != times.constEnd(); ++i)
+            order << qMakePair(i.value(), i.key());
+        qSort(order.begin(), order.end(), qGreater<QPair<int64_t, int> >());
+
+        for (int k = 0; k < order.size(); ++k)
+        {
+            int key = order[k].second;
+            QString name = key == -2 ? tr("Messages")
+                : key == -1 ? tr("No state")
+                : computed_->states().item(key);
+
+            QList<QStandardItem*> row = makeRow(name, order[k].first,
+                                                QString::number(blamed[key].size()));
+            table_->appendRow(row);
+
+            /* Only the longest segments are listed. */
+            std::vector<int>& segments = blamed[key];
+            Longer longer(path_);
+            int shown = qMin((int)segments.size(), (int)max_listed);
+            std::partial_sort(segments.begin(), segments.begin() + shown,
+                              segments.end(), longer);
+
+            for (int j = 0; j < shown; ++j)
+            {
+                const Path_segment& s = path_[segments[j]];
+                QString where = computed_->component_name(s.component);
+                if (s.kind == Path_segment::message)
+                    where = tr("%1 to %2")
+                        .arg(computed_->component_name(s.from_component))
+                        .arg(where);
+
+                QList<QStandardItem*> child = makeRow(
+                    where, s.end - s.begin,
+                    computed_->ticks_time(s.begin).toString(true));
+                child[0]->setData(segments[j], Qt::UserRole);
+                row[0]->appendRow(child);
+            }
+        }
+
+        view_->resizeColumnToContents(0);
+    }
+
+    QList<QStandardItem*> makeRow(const QString& name, int64_t time,
+                                  const QString& last)
+    {
+        QList<QStandardItem*> row;
+        row << new QStandardItem(name);
+
+        QStandardItem* item = new QStandardItem(duration(time));
+        item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        row << item;
+        row << new QStandardItem(last);
+        return row;
+    }
+
+    QString duration(int64_t ticks) const
+    {
+        return (computed_->ticks_time(ticks) - computed_->ticks_time(0)).toString(true);
+    }
+
+    /** Orders segment numbers by the length of the segments, longest
+        first. */
+    struct Longer
+    {
+        Longer(const std::vector<Path_segment>& path) : path_(path) {}
+
+        bool operator()(int a, int b) const
+        {
+            return path_[a].end - path_[a].begin > path_[b].end - path_[b].begin;
+        }
+
+        const std::vector<Path_segment>& path_;
+    };
+
+    enum { max_listed = 100 };
+
+private:
+    QLabel* status_;
+    QTreeView* view_;
+    QStandardItemModel* table_;
+    Critical_path_overlay* overlay_;
+
+    Trace_model::Ptr computed_;
+    Part_workers<Path_part> workers_;
+    QTime started_;
+    std::vector<Path_segment> path_;
+};
+
+
+Tool* createCriticalPath(QWidget* parent, Canvas* canvas)
+{
+    return new Critical_path(parent, canvas);
+}
+
+}
+
+#endif
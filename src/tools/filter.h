@@ -160,11 +160,20 @@ private slots:
 
     void modelChanged(Trace_model::Ptr & model)
     {
-        components->initialize(model->components());
-        events->initialize(model->events());
-        states->initialize(model->available_states(), model->states());
-
-        saveState();
+        // Most changes only scroll or zoom, and initializing the
+        // selectors is slow for traces with many components.
+        int d = shown_model.get() ? delta(*model, *shown_model) : ~0;
+        shown_model = model;
+
+        if (d & (Trace_model_delta::component_position | Trace_model_delta::components))
+            components->initialize(model->components());
+        if (d & Trace_model_delta::event_types)
+            events->initialize(model->events());
+        if (d & Trace_model_delta::state_types)
+            states->initialize(model->available_states(), model->states());
+
+        if (d & ~Trace_model_delta::time_range)
+            saveState();
     }
 
     void filtersChanged()
@@ -206,6 +215,9 @@ private: /* members */
     SelectionWidget * states;
 
     bool state_restored;
+
+    /** Model the selectors were last initialized from. */
+    Trace_model::Ptr shown_model;
 };
 
 Tool* createFilter(QWidget* parent, Canvas* canvas)
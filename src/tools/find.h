@@ -1,5 +1,6 @@
 #include "tool.h"
 #include "find_tabs.h"
+#include "find_all.h"
 
 #include "canvas_item.h"
 #include "canvas.h"
@@ -142,6 +143,14 @@ public:
         connect(find_again, SIGNAL(triggered(bool)),
                 this, SLOT(findNext()));
 
+        QAction* find_back = new QAction(parent);
+        find_back->setShortcut(Qt::SHIFT + Qt::Key_F3);
+        find_back->setShortcutContext(Qt::WindowShortcut);
+        c->addAction(find_back);
+
+        connect(find_back, SIGNAL(triggered(bool)),
+                this, SLOT(findPrevious()));
+
         QVBoxLayout* mainLayout = new QVBoxLayout(this);
 
         QHBoxLayout* startTimeLayout = new QHBoxLayout();
@@ -193,6 +202,8 @@ public:
 
         connect(queryTab, SIGNAL( showEvent(Event_model*) ),
             this, SLOT( eventFound(Event_model*) ));
+        connect(queryTab, SIGNAL( showState(State_model*) ),
+            this, SLOT( stateFound(State_model*) ));
         connect(queryTab, SIGNAL( stateChanged() ),
             this, SLOT( tabStateChanged() ));
 
@@ -221,11 +232,29 @@ public:
 
         buttons->addStretch();
 
+        findPreviousButton = new QPushButton(tr("Find previous"), this);
+        buttons->addWidget(findPreviousButton);
+        connect(findPreviousButton, SIGNAL(clicked(bool)),
+                this, SLOT( findPrevious() ));
+
         findButton = new QPushButton(tr("Find"), this);
         buttons->addWidget(findButton);
         connect(findButton, SIGNAL(clicked(bool)),
                 this, SLOT( findNext() ));
 
+        findAllButton = new QPushButton(tr("Find all"), this);
+        buttons->addWidget(findAllButton);
+        connect(findAllButton, SIGNAL(clicked(bool)),
+                this, SLOT( findAll() ));
+
+        results = new Find_results(this);
+        results->hide();
+        mainLayout->addWidget(results, 1);
+        connect(results, SIGNAL( showEvent(Event_model*) ),
+            this, SLOT( eventFound(Event_model*) ));
+        connect(results, SIGNAL( showState(State_model*) ),
+            this, SLOT( stateFound(State_model*) ));
+
 
         highlight = new Found_item_highlight;
         canvas()->addItem(highlight);
@@ -534,12 +563,31 @@ private slots:
     }
 
     void findNext()
+    {
+        search(true);
+    }
+
+    void findPrevious()
+    {
+        search(false);
+    }
+
+    void findAll()
+    {
+        if (!findAllButton->isEnabled()) return;
+
+        Trace_model::Ptr filtered = active_tab->filteredModel();
+        results->start(filtered, active_tab->findsStates());
+        results->show();
+    }
+
+    void search(bool forward)
     {
         if (!findButton->isEnabled()) return;
 
         QApplication::setOverrideCursor(Qt::WaitCursor);
 
-        bool searched = active_tab->findNext();
+        bool searched = active_tab->findNext(forward);
         if (!searched) {
             if (nothing_yet)
             {
@@ -553,7 +601,7 @@ private slots:
             }
         } else {
             nothing_yet = false;
-            emit extraHelp(tr("<b>Press F3 to continue search.</b>"));
+            emit extraHelp(tr("<b>Press F3 to continue search, Shift+F3 to search back.</b>"));
         }
 
         QApplication::restoreOverrideCursor();
@@ -622,7 +670,11 @@ private slots:
     void tabStateChanged()
     {
         if (sender() == active_tab)
+        {
             findButton->setEnabled(active_tab->isSearchAllowed());
+            findPreviousButton->setEnabled(active_tab->isSearchAllowed());
+            findAllButton->setEnabled(active_tab->isSearchAllowed());
+        }
 
         saveState();
     }
@@ -645,6 +697,8 @@ private slots:
 
         findTabWidget->setCurrentIndex(tab);
         findButton->setEnabled(active_tab->isSearchAllowed());
+        findPreviousButton->setEnabled(active_tab->isSearchAllowed());
+        findAllButton->setEnabled(active_tab->isSearchAllowed());
         saveState();
     }
 
@@ -695,6 +749,10 @@ private: /* memebers */
     FindTab * active_tab;
 
     QPushButton* findButton;
+    QPushButton* findPreviousButton;
+    QPushButton* findAllButton;
+
+    Find_results* results;
 
     int highlighted_component;
     Time highlighted_min;
@@ -0,0 +1,417 @@
+#include "find_all.h"
+#include "event_model.h"
+#include "state_model.h"
+#include "string_table.h"
+
+#include <QThread>
+#include <QTimer>
+#include <QTreeView>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QStandardItemModel>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+namespace vis4 {
+
+using common::Time;
+using common::String_table;
+
+class Search_worker : public QThread
+{
+public:
+    Search_worker(Find_all* search) : search_(search) {}
+
+protected:
+    void run();
+
+private:
+    Find_all* search_;
+};
+
+void Search_worker::run()
+{
+    int part;
+    while (search_->nextPart(part))
+    {
+        if (search_->states_)
+            search_->model_->search_states(part, *search_);
+        else
+            search_->model_->search_events(part, *search_);
+
+        QMutexLocker lock(&search_->mutex_);
+        ++search_->parts_done_;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Find_all class implementation
+//---------------------------------------------------------------------------------------
+
+Find_all::Find_all(QObject* parent)
+: QObject(parent), states_(false), parts_(0), next_part_(0), parts_done_(0),
+  cancelled_(false)
+{
+    timer_ = new QTimer(this);
+    timer_->setInterval(100);
+    connect(timer_, SIGNAL(timeout()), this, SLOT(deliver()));
+}
+
+Find_all::~Find_all()
+{
+    cancel();
+    waitWorkers();
+}
+
+void Find_all::start(Trace_model::Ptr & model, bool states)
+{
+    cancel();
+    waitWorkers();
+
+    /* The search uses an object of its own, the GUI keeps iterating
+       the others. */
+    model_ = model->set_range(model->min_time(), model->max_time());
+    states_ = states;
+    parts_ = model_->search_parts();
+
+    next_part_ = parts_done_ = 0;
+    cancelled_ = false;
+    events_found_.clear();
+    states_found_.clear();
+
+    int threads = qMax(1, qMin(QThread::idealThreadCount(), parts_));
+    for (int i = 0; i < threads; ++i)
+    {
+        Search_worker* w = new Search_worker(this);
+        workers_ << w;
+        w->start();
+    }
+    timer_->start();
+}
+
+void Find_all::cancel()
+{
+    QMutexLocker lock(&mutex_);
+    cancelled_ = true;
+}
+
+int Find_all::partsDone() const
+{
+    QMutexLocker lock(&mutex_);
+    return parts_done_;
+}
+
+void Find_all::deliver()
+{
+    bool done = true;
+    foreach (Search_worker* w, workers_)
+        if (!w->isFinished()) done = false;
+
+    QVector<Event_record> events;
+    QVector<State_record> states;
+    {
+        QMutexLocker lock(&mutex_);
+        events.swap(events_found_);
+        states.swap(states_found_);
+    }
+
+    if (!events.isEmpty()) emit eventsFound(events);
+    if (!states.isEmpty()) emit statesFound(states);
+
+    if (done)
+    {
+        timer_->stop();
+        waitWorkers();
+        emit finished();
+    }
+}
+
+bool Find_all::cancelled()
+{
+    QMutexLocker lock(&mutex_);
+    return cancelled_;
+}
+
+void Find_all::found(const Event_record* records, int count)
+{
+    QMutexLocker lock(&mutex_);
+    for (int i = 0; i < count; ++i)
+        events_found_.push_back(records[i]);
+}
+
+void Find_all::found(const State_record* records, int count)
+{
+    QMutexLocker lock(&mutex_);
+    for (int i = 0; i < count; ++i)
+        states_found_.push_back(records[i]);
+}
+
+bool Find_all::nextPart(int& part)
+{
+    QMutexLocker lock(&mutex_);
+    if (cancelled_ || next_part_ >= parts_) return false;
+
+    part = next_part_++;
+    return true;
+}
+
+void Find_all::waitWorkers()
+{
+    foreach (Search_worker* w, workers_)
+    {
+        w->wait();
+        delete w;
+    }
+    workers_.clear();
+}
+
+//---------------------------------------------------------------------------------------
+// Find_results_model class implementation
+//---------------------------------------------------------------------------------------
+
+namespace {
+
+bool event_found_before(const Event_record& a, const Event_record& b)
+{
+    return find_order(a, b);
+}
+
+bool state_found_before(const State_record& a, const State_record& b)
+{
+    return find_order(a, b);
+}
+
+}
+
+Find_results_model::Find_results_model(QObject* parent)
+: QAbstractTableModel(parent), states_(false)
+{
+}
+
+void Find_results_model::clear(Trace_model::Ptr & model, bool states)
+{
+    model_ = model;
+    states_ = states;
+    events_.clear();
+    state_records_.clear();
+    reset();
+}
+
+void Find_results_model::append(const QVector<Event_record>& events)
+{
+    beginInsertRows(QModelIndex(), events_.size(), events_.size() + events.size() - 1);
+    events_ += events;
+    endInsertRows();
+}
+
+void Find_results_model::append(const QVector<State_record>& states)
+{
+    beginInsertRows(QModelIndex(), state_records_.size(),
+                    state_records_.size() + states.size() - 1);
+    state_records_ += states;
+    endInsertRows();
+}
+
+void Find_results_model::sort()
+{
+    emit layoutAboutToBeChanged();
+    std::stable_sort(events_.begin(), events_.end(), event_found_before);
+    std::stable_sort(state_records_.begin(), state_records_.end(), state_found_before);
+    emit layoutChanged();
+}
+
+int Find_results_model::rowCount(const QModelIndex & parent) const
+{
+    if (parent.isValid()) return 0;
+    return states_ ? state_records_.size() : events_.size();
+}
+
+int Find_results_model::columnCount(const QModelIndex & parent) const
+{
+    return parent.isValid() ? 0 : 3;
+}
+
+QVariant Find_results_model::data(const QModelIndex & index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole)
+        return QVariant();
+
+    int row = index.row();
+    if (row >= rowCount()) return QVariant();
+
+    int64_t time = states_ ? state_records_[row].begin : events_[row].time;
+    int component = states_ ? state_records_[row].component : events_[row].component;
+
+    switch (index.column())
+    {
+        case 0:
+            return model_->ticks_time(time).toString();
+        case 1:
+            return model_->component_name(component);
+        case 2:
+            if (states_)
+                return model_->states().item(state_records_[row].type);
+            return String_table::instance().string(events_[row].kind);
+    }
+    return QVariant();
+}
+
+QVariant Find_results_model::headerData(int section, Qt::Orientation orientation,
+                                        int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section)
+    {
+        case 0: return tr("Time");
+        case 1: return tr("Component");
+        case 2: return states_ ? tr("State") : tr("Event");
+    }
+    return QVariant();
+}
+
+//---------------------------------------------------------------------------------------
+// Find_results class implementation
+//---------------------------------------------------------------------------------------
+
+Find_results::Find_results(QWidget* parent)
+: QWidget(parent)
+{
+    search_ = new Find_all(this);
+    connect(search_, SIGNAL(eventsFound(const QVector<Event_record>&)),
+            this, SLOT(eventsFound(const QVector<Event_record>&)));
+    connect(search_, SIGNAL(statesFound(const QVector<State_record>&)),
+            this, SLOT(statesFound(const QVector<State_record>&)));
+    connect(search_, SIGNAL(finished()), this, SLOT(finished()));
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->setMargin(0);
+
+    QHBoxLayout* statusLayout = new QHBoxLayout();
+    layout->addLayout(statusLayout);
+
+    status_ = new QLabel(this);
+    statusLayout->addWidget(status_);
+    statusLayout->addStretch();
+
+    cancel_ = new QPushButton(tr("Cancel"), this);
+    cancel_->setEnabled(false);
+    statusLayout->addWidget(cancel_);
+    connect(cancel_, SIGNAL(clicked(bool)), this, SLOT(cancel()));
+
+    results_ = new Find_results_model(this);
+
+    list_ = new QTreeView(this);
+    list_->setRootIsDecorated(false);
+    list_->setUniformRowHeights(true);
+    list_->setAlternatingRowColors(true);
+    list_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    list_->setModel(results_);
+    layout->addWidget(list_, 3);
+    connect(list_, SIGNAL(activated(const QModelIndex&)),
+            this, SLOT(activated(const QModelIndex&)));
+    connect(list_, SIGNAL(clicked(const QModelIndex&)),
+            this, SLOT(activated(const QModelIndex&)));
+
+    counts_model_ = new QStandardItemModel(this);
+    counts_model_->setHorizontalHeaderLabels(
+        QStringList() << tr("Component") << tr("Found"));
+
+    counts_view_ = new QTreeView(this);
+    counts_view_->setRootIsDecorated(false);
+    counts_view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    counts_view_->setModel(counts_model_);
+    layout->addWidget(counts_view_, 1);
+}
+
+void Find_results::start(Trace_model::Ptr & model, bool states)
+{
+    results_->clear(model, states);
+    component_counts_.clear();
+    updateCounts();
+
+    search_->start(model, states);
+    cancel_->setEnabled(true);
+    updateStatus();
+}
+
+void Find_results::cancel()
+{
+    search_->cancel();
+}
+
+void Find_results::eventsFound(const QVector<Event_record>& events)
+{
+    results_->append(events);
+    foreach (const Event_record& e, events)
+        ++component_counts_[e.component];
+
+    updateCounts();
+    updateStatus();
+}
+
+void Find_results::statesFound(const QVector<State_record>& states)
+{
+    results_->append(states);
+    foreach (const State_record& s, states)
+        ++component_counts_[s.component];
+
+    updateCounts();
+    updateStatus();
+}
+
+void Find_results::finished()
+{
+    results_->sort();
+    cancel_->setEnabled(false);
+    updateStatus();
+}
+
+void Find_results::activated(const QModelIndex& index)
+{
+    if (!index.isValid()) return;
+
+    if (results_->hasStates())
+    {
+        std::auto_ptr<State_model> s =
+            results_->model()->make_state(results_->state(index.row()));
+        emit showState(s.get());
+    }
+    else
+    {
+        std::auto_ptr<Event_model> e =
+            results_->model()->make_event(results_->event(index.row()));
+        emit showEvent(e.get());
+    }
+}
+
+void Find_results::updateCounts()
+{
+    counts_model_->removeRows(0, counts_model_->rowCount());
+
+    int row = 0;
+    QMap<int, int>::const_iterator i;
+    for (i = component_counts_.constBegin(); i != component_counts_.constEnd(); ++i, ++row)
+    {
+        counts_model_->insertRow(row);
+        counts_model_->setData(counts_model_->index(row, 0),
+                               results_->model()->component_name(i.key()));
+        counts_model_->setData(counts_model_->index(row, 1), i.value());
+    }
+}
+
+void Find_results::updateStatus()
+{
+    QString s = tr("Found: %1").arg(results_->rowCount());
+    if (search_->running())
+        s += " " + tr("(searched %1 of %2 parts)")
+            .arg(search_->partsDone()).arg(search_->parts());
+    status_->setText(s);
+}
+
+}
@@ -0,0 +1,157 @@
+#ifndef FIND_ALL_HPP
+#define FIND_ALL_HPP
+
+#include "trace_model.h"
+
+#include <QWidget>
+#include <QAbstractTableModel>
+#include <QMutex>
+#include <QVector>
+#include <QList>
+#include <QMap>
+
+class QTreeView;
+class QLabel;
+class QPushButton;
+class QTimer;
+class QStandardItemModel;
+class QModelIndex;
+
+namespace vis4 {
+
+class Event_model;
+class State_model;
+class Search_worker;
+
+/** Finds all events or states shown by a model.
+
+    Parts of the model are searched by a pool of threads, one thread
+    per processor. Records found by the threads are collected and
+    passed to the GUI thread by eventsFound and statesFound a few
+    times per second, so results are shown while the search runs. */
+class Find_all : public QObject, private Search_sink
+{
+    Q_OBJECT
+public:
+    Find_all(QObject* parent);
+    ~Find_all();
+
+    /** Starts search of the events, or the states, shown by model.
+        Search in progress is cancelled. */
+    void start(Trace_model::Ptr & model, bool states);
+
+    /** Stops the search. Records found so far are still delivered. */
+    void cancel();
+
+    bool running() const { return !workers_.isEmpty(); }
+
+    int parts() const { return parts_; }
+    int partsDone() const;
+
+signals:
+    void eventsFound(const QVector<Event_record>& events);
+    void statesFound(const QVector<State_record>& states);
+    void finished();
+
+private slots:
+    void deliver();
+
+private:
+    bool cancelled();
+    void found(const Event_record* records, int count);
+    void found(const State_record* records, int count);
+
+    /** Takes the next part to search. Returns false if none left. */
+    bool nextPart(int& part);
+
+    void waitWorkers();
+
+    Trace_model::Ptr model_;
+    bool states_;
+    int parts_;
+
+    QList<Search_worker*> workers_;
+    QTimer* timer_;
+
+    mutable QMutex mutex_;
+    int next_part_;
+    int parts_done_;
+    bool cancelled_;
+    QVector<Event_record> events_found_;
+    QVector<State_record> states_found_;
+
+    friend class Search_worker;
+};
+
+/** Table of the records found by Find_all. */
+class Find_results_model : public QAbstractTableModel
+{
+public:
+    Find_results_model(QObject* parent);
+
+    void clear(Trace_model::Ptr & model, bool states);
+
+    void append(const QVector<Event_record>& events);
+    void append(const QVector<State_record>& states);
+
+    /** Sorts the records in the order of Trace_model::find_event. */
+    void sort();
+
+    bool hasStates() const { return states_; }
+    const Event_record& event(int row) const { return events_[row]; }
+    const State_record& state(int row) const { return state_records_[row]; }
+    const Trace_model::Ptr& model() const { return model_; }
+
+    int rowCount(const QModelIndex & parent = QModelIndex()) const;
+    int columnCount(const QModelIndex & parent = QModelIndex()) const;
+    QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+
+private:
+    Trace_model::Ptr model_;
+    bool states_;
+    QVector<Event_record> events_;
+    QVector<State_record> state_records_;
+};
+
+/** Widget running Find_all and showing the results, with the number
+    of records found on each component. */
+class Find_results : public QWidget
+{
+    Q_OBJECT
+public:
+    Find_results(QWidget* parent);
+
+    void start(Trace_model::Ptr & model, bool states);
+
+signals:
+    void showEvent(Event_model*);
+    void showState(State_model*);
+
+public slots:
+    void cancel();
+
+private slots:
+    void eventsFound(const QVector<Event_record>& events);
+    void statesFound(const QVector<State_record>& states);
+    void finished();
+    void activated(const QModelIndex& index);
+
+private:
+    void updateCounts();
+    void updateStatus();
+
+    Find_all* search_;
+    Find_results_model* results_;
+    QStandardItemModel* counts_model_;
+    QMap<int, int> component_counts_;
+
+    QTreeView* list_;
+    QTreeView* counts_view_;
+    QLabel* status_;
+    QPushButton* cancel_;
+};
+
+}
+#endif
@@ -3,6 +3,7 @@
 #include "event_model.h"
 #include "state_model.h"
 #include "canvas.h"
+#include "query.h"
 
 #include "selection_widget.h"
 
@@ -13,6 +14,7 @@
 #include <QStackedLayout>
 
 #include <set>
+#include <limits.h>
 
 namespace vis4 {
 
@@ -24,6 +26,11 @@ using common::SelectionWidget;
 // FindEventsTab class implementation
 //---------------------------------------------------------------------------------------
 
+Trace_model::Ptr FindTab::searchModel(Trace_model::Ptr & model)
+{
+    return model->set_range(model->root()->min_time(), model->max_time());
+}
+
 FindEventsTab::FindEventsTab(Tool * find_tool)
     : FindTab(find_tool)
 {
@@ -44,25 +51,33 @@ void FindEventsTab::reset()
     filtered_model_.reset();
 }
 
-bool FindEventsTab::findNext()
+bool FindEventsTab::findNext(bool forward)
 {
     Q_ASSERT(model_.get() != 0);
 
     if (!filtered_model_.get()) {
-        Selection filter = model_->events() & selector_->selection();
-        filtered_model_ = model_->filter_events(filter);
-        filtered_model_->rewind();
-    }
+        filtered_model_ = filteredModel();
 
-    std::auto_ptr<Event_model> e = filtered_model_->next_event();
-    if (e.get())
-    {
-        model_ = model_->set_range(e->time, model_->max_time());
-        emit showEvent(e.get());
-        return true;
+        /* Events at the start time are found going either way. */
+        position_.time = filtered_model_->time_ticks(model_->min_time());
+        position_.component = forward ? INT_MIN : INT_MAX;
+        position_.kind = 0;
     }
 
-    return false;
+    Event_record found;
+    if (!filtered_model_->find_event(&position_, forward, found))
+        return false;
+    position_ = found;
+
+    std::auto_ptr<Event_model> e = filtered_model_->make_event(position_);
+    emit showEvent(e.get());
+    return true;
+}
+
+Trace_model::Ptr FindEventsTab::filteredModel()
+{
+    Selection filter = model_->events() & selector_->selection();
+    return searchModel(model_)->filter_events(filter);
 }
 
 void FindEventsTab::setModel(Trace_model::Ptr & model)
@@ -135,28 +150,32 @@ void FindStatesTab::reset()
     filtered_model_.reset();
 }
 
-bool FindStatesTab::findNext()
+bool FindStatesTab::findNext(bool forward)
 {
     Q_ASSERT(model_.get() != 0);
 
     if (!filtered_model_.get()) {
-        Selection filter = model_->states() & selector_->selection();
-        filtered_model_ = model_->filter_states(filter);
-        filtered_model_->rewind();
+        filtered_model_ = filteredModel();
 
+        position_.begin = filtered_model_->time_ticks(model_->min_time());
+        position_.component = forward ? INT_MIN : INT_MAX;
+        position_.type = 0;
     }
 
-    for (;;) {
-        std::auto_ptr<State_model> s = filtered_model_->next_state();
-        if (s.get())
-        {
-            model_ = model_->set_range(s->begin, model_->max_time());
-            emit showState(s.get());
-            return true;
-        }
-
+    State_record found;
+    if (!filtered_model_->find_state(&position_, forward, found))
         return false;
-    }
+    position_ = found;
+
+    std::auto_ptr<State_model> s = filtered_model_->make_state(position_);
+    emit showState(s.get());
+    return true;
+}
+
+Trace_model::Ptr FindStatesTab::filteredModel()
+{
+    Selection filter = model_->states() & selector_->selection();
+    return searchModel(model_)->filter_states(filter);
 }
 
 void FindStatesTab::setModel(Trace_model::Ptr & model)
@@ -286,26 +305,54 @@ void FindQueryTab::reset()
     model_with_checker.reset();
 }
 
-bool FindQueryTab::findNext()
+bool FindQueryTab::findNext(bool forward)
 {
     Q_ASSERT(model_.get() != 0);
 
     if (!model_with_checker.get()) {
-        model_with_checker = model_->install_checker(active_checker);
-        model_with_checker->rewind();
-    }
+        model_with_checker = filteredModel();
 
-    std::auto_ptr<Event_model> e =
-        model_with_checker->next_event();
+        position_.time = model_with_checker->time_ticks(model_->min_time());
+        position_.component = forward ? INT_MIN : INT_MAX;
+        position_.kind = 0;
 
-    if (e.get())
+        state_position_.begin = position_.time;
+        state_position_.component = position_.component;
+        state_position_.type = 0;
+    }
+
+    if (findsStates())
     {
-        model_ = model_->set_range(e->time, model_->max_time());
-        emit showEvent(e.get());
+        State_record found;
+        if (!model_with_checker->find_state(&state_position_, forward, found))
+            return false;
+        state_position_ = found;
+
+        std::auto_ptr<State_model> s = model_with_checker->make_state(state_position_);
+        emit showState(s.get());
         return true;
     }
 
-    return false;
+    Event_record found;
+    if (!model_with_checker->find_event(&position_, forward, found))
+        return false;
+    position_ = found;
+
+    std::auto_ptr<Event_model> e = model_with_checker->make_event(position_);
+    emit showEvent(e.get());
+    return true;
+}
+
+Trace_model::Ptr FindQueryTab::filteredModel()
+{
+    return searchModel(model_)->install_checker(active_checker);
+}
+
+bool FindQueryTab::findsStates() const
+{
+    if (!active_checker) return false;
+    const Query * query = active_checker->query();
+    return (query && query->target() == Query::states) || active_checker->wait_kinds();
 }
 
 void FindQueryTab::setModel(Trace_model::Ptr & model)
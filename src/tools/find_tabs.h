@@ -38,7 +38,16 @@ public: /* methods */
 
     virtual void reset() = 0;
 
-    virtual bool findNext() = 0;
+    /** Finds the next found item, or the previous one if forward is
+        false. The search starts at the minimum time of the model. */
+    virtual bool findNext(bool forward) = 0;
+
+    /** Returns the model showing only the items searched for, over
+        the whole trace. */
+    virtual Trace_model::Ptr filteredModel() = 0;
+
+    /** Returns true if the tab searches for states, not events. */
+    virtual bool findsStates() const { return false; }
 
     virtual void setModel(Trace_model::Ptr &) = 0;
 
@@ -54,6 +63,11 @@ signals:
 
 protected:
 
+    /** Returns the model to search, with the range starting at the
+        start of the trace, so the search can go back from the start
+        time. */
+    static Trace_model::Ptr searchModel(Trace_model::Ptr & model);
+
     Tool * find_tool_;
 
 };
@@ -72,7 +86,9 @@ public: /* methods */
 
     void reset();
 
-    bool findNext();
+    bool findNext(bool forward);
+
+    Trace_model::Ptr filteredModel();
 
     void setModel(Trace_model::Ptr & model);
 
@@ -96,6 +112,9 @@ private: /* widgets */
     Trace_model::Ptr model_;
     Trace_model::Ptr filtered_model_;
 
+    /** The last found event, or the start of the search. */
+    Event_record position_;
+
 };
 
 /** Class for states find tab. */
@@ -112,7 +131,12 @@ public: /* methods */
 
     void reset();
 
-    bool findNext();
+    bool findNext(bool forward);
+
+    Trace_model::Ptr filteredModel();
+
+    bool findsStates() const
+        { return true; }
 
     void setModel(Trace_model::Ptr & model);
 
@@ -136,6 +160,9 @@ private: /* widgets */
     Trace_model::Ptr model_;
     Trace_model::Ptr filtered_model_;
 
+    /** The last found state, or the start of the search. */
+    State_record position_;
+
 };
 
 /** Class for checkers find tab. */
@@ -152,7 +179,12 @@ public: /* methods */
 
     void reset();
 
-    bool findNext();
+    bool findNext(bool forward);
+
+    Trace_model::Ptr filteredModel();
+
+    /** States are searched if the checker is a query of states. */
+    bool findsStates() const;
 
     void setModel(Trace_model::Ptr & model);
 
@@ -170,6 +202,7 @@ private: /* methods */
 signals:
 
     void showEvent(Event_model *);
+    void showState(State_model *);
 
 private slots:
 
@@ -184,6 +217,10 @@ private: /* widgets */
     Trace_model::Ptr model_;
     Trace_model::Ptr model_with_checker;
 
+    /** The last found event or state, or the start of the search. */
+    Event_record position_;
+    State_record state_position_;
+
     QList<pChecker> checkers;
     Checker * active_checker;
     bool active_checker_is_ready;
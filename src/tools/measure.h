@@ -12,6 +12,9 @@
 #include <QMouseEvent>
 #include <QPainter>
 #include <QAction>
+#include <QTreeView>
+#include <QStandardItemModel>
+#include <QTime>
 
 namespace vis4 {
 
@@ -189,19 +192,8 @@ public:
 
         selectedPoint(time);
 
-        Selection component_filter = model->components();
-        component_filter.disableAll(model->parent_component());
-        component_filter.setEnabled(component, true);
-
         QPair<Time, Time> nearby = canvas->nearby_range(time);
-
-        Trace_model::Ptr filtered_ =
-            model->set_range(nearby.first, nearby.second);
-        filtered_ = filtered_->filter_components(component_filter);
-
-        filtered_->rewind();
-
-        events->showEvents(filtered_, time);
+        events->showEvents(model, component, nearby.first, nearby.second, time);
 
         // FIXME: auto-snap if there's one event.
         if (events->model()->rowCount() == 0)
@@ -295,6 +287,27 @@ public:
         distanceLabel = new QLabel("", distanceGroup);
         distanceLayout->addWidget(distanceLabel);
 
+        QGroupBox* ribbonGroup = new QGroupBox(tr("Between the points"), this);
+        ribbonGroup->setSizePolicy(QSizePolicy::Expanding,
+                                   QSizePolicy::Expanding);
+        mainLayout->addWidget(ribbonGroup);
+
+        // Ribbon group contents.
+        QVBoxLayout* ribbonLayout = new QVBoxLayout(ribbonGroup);
+        statisticsLabel = new QLabel("", ribbonGroup);
+        statisticsLabel->setWordWrap(true);
+        ribbonLayout->addWidget(statisticsLabel);
+
+        statistics = new QStandardItemModel(this);
+        statistics->setHorizontalHeaderLabels(QStringList()
+            << tr("Component") << tr("Count") << tr("Time") << tr("Bytes"));
+
+        statisticsView = new QTreeView(ribbonGroup);
+        statisticsView->setModel(statistics);
+        statisticsView->setUniformRowHeights(true);
+        statisticsView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        ribbonLayout->addWidget(statisticsView);
+
         connect(canvas(), SIGNAL(modelChanged(Trace_model::Ptr &)),
                 this, SLOT(modelChanged(Trace_model::Ptr &)));
 
@@ -360,6 +373,99 @@ private:
         {
             distanceLabel->setText(tr("Points not selected yet"));
         }
+
+        showStatistics();
+    }
+
+    /** Shows the events, states and messages of the components from
+        point A to point B, within the time between the points. */
+    void showStatistics()
+    {
+        statistics->removeRows(0, statistics->rowCount());
+        statisticsLabel->setText(tr("Points not selected yet"));
+        if (time_a.isNull() || time_b.isNull() || !model())
+            return;
+
+        /* Points are set on lifelines, which are numbered as the
+           visible components. */
+        const QList<int>& components = model()->visible_components();
+        int a = component_a, b = component_b;
+        if (a > b) qSwap(a, b);
+        if (a < 0 || b >= components.size())
+            return;
+
+        Time min = qMin(time_a, time_b);
+        Time max = qMax(time_a, time_b);
+
+        QTime started;
+        started.start();
+        for (int i = a; i <= b; ++i)
+        {
+            Range_statistics s;
+            if (!model()->range_statistics(components[i], min, max, s))
+            {
+                statistics->removeRows(0, statistics->rowCount());
+                statisticsLabel->setText(
+                    tr("Not available for this trace"));
+                return;
+            }
+            statistics->appendRow(statisticsRows(s));
+        }
+
+        statisticsView->resizeColumnToContents(0);
+        statisticsLabel->setText(tr("%1 components, computed in %2 ms")
+                                 .arg(b - a + 1).arg(started.elapsed()));
+    }
+
+    QList<QStandardItem*> statisticsRows(const Range_statistics& s)
+    {
+        QList<QStandardItem*> row = makeRow(
+            model()->component_name(s.component), QString(), QString(),
+            QString::number(s.bytes));
+
+        int64_t events = 0;
+        std::map<int, int64_t>::const_iterator i;
+        for (i = s.events.begin(); i != s.events.end(); ++i)
+        {
+            events += i->second;
+            row[0]->appendRow(makeRow(model()->events().item(i->first),
+                                      QString::number(i->second)));
+        }
+        row[1]->setText(QString::number(events));
+
+        for (unsigned k = 0; k < s.states.size(); ++k)
+        {
+            const Profile_entry& e = s.states[k];
+            row[0]->appendRow(makeRow(model()->states().item(e.type),
+                                      QString::number(e.calls),
+                                      duration(e.inclusive)));
+        }
+
+        row[0]->appendRow(makeRow(tr("Messages sent"),
+                                  QString::number(s.messages), QString(),
+                                  QString::number(s.bytes)));
+        return row;
+    }
+
+    QList<QStandardItem*> makeRow(const QString& name,
+                                  const QString& count,
+                                  const QString& time = QString(),
+                                  const QString& bytes = QString())
+    {
+        QList<QStandardItem*> row;
+        row << new QStandardItem(name);
+        foreach (const QString& text, QStringList() << count << time << bytes)
+        {
+            QStandardItem* item = new QStandardItem(text);
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            row << item;
+        }
+        return row;
+    }
+
+    QString duration(int64_t ticks)
+    {
+        return (model()->ticks_time(ticks) - model()->ticks_time(0)).toString(true);
     }
 
 private slots:
@@ -492,6 +598,9 @@ private:
     Measure_point_display* pointA;
     Measure_point_display* pointB;
     QLabel* distanceLabel;
+    QLabel* statisticsLabel;
+    QTreeView* statisticsView;
+    QStandardItemModel* statistics;
 
     bool point_a_fixed;
     bool point_b_fixed;
@@ -0,0 +1,234 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include "tool.h"
+#include "trace_model.h"
+#include "part_workers.h"
+#include "canvas.h"
+
+#include <QVBoxLayout>
+#include <QGroupBox>
+#include <QLabel>
+#include <QTreeView>
+#include <QHeaderView>
+#include <QStandardItemModel>
+#include <QTime>
+#include <QAction>
+#include <QMap>
+#include <QPair>
+
+#include <vector>
+
+namespace vis4 {
+
+using common::Time;
+
+/** Table of the time spent in each function over the visible time
+    range: number of calls, inclusive and exclusive time, and the
+    shortest, longest and mean call. Rows of the functions contain
+    the rows of the processes.
+
+    The profile is taken from Trace_model::range_profile at once, if
+    the model supports it, and computed by Trace_model::profile in one
+    thread per processor, again after the view changes. */
+class Profile : public Range_tool
+{
+    Q_OBJECT
+public:
+    Profile(QWidget* parent, Canvas* c)
+    : Range_tool(parent, c)
+    {
+        setObjectName("profile");
+        setWhatsThis(tr("<b>Profile</b>"
+                        "<p>Shows the number of calls and the time spent in "
+                        "each function within the visible part of the trace. "
+                        "Exclusive time doesn't include the calls made by the "
+                        "function. Expand a function to see the processes."));
+
+        setWindowTitle(tr("Profile"));
+
+        QVBoxLayout* mainLayout = new QVBoxLayout(this);
+
+        QGroupBox* group = new QGroupBox(tr("Profile"), this);
+        group->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+        mainLayout->addWidget(group);
+
+        QVBoxLayout* layout = new QVBoxLayout(group);
+
+        status_ = new QLabel(group);
+        status_->setWordWrap(true);
+        layout->addWidget(status_);
+
+        table_ = new QStandardItemModel(this);
+        table_->setSortRole(Qt::UserRole);
+        table_->setHorizontalHeaderLabels(QStringList()
+            << tr("Function") << tr("Calls") << tr("Inclusive")
+            << tr("Exclusive") << tr("Min") << tr("Max") << tr("Mean"));
+
+        view_ = new QTreeView(group);
+        view_->setModel(table_);
+        view_->setUniformRowHeights(true);
+        view_->setAlternatingRowColors(true);
+        view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        view_->setSortingEnabled(true);
+        layout->addWidget(view_);
+    }
+
+    QAction* createAction()
+    {
+        QAction* action = new QAction(QIcon(":/kruler.png"), tr("Pro&file"), this);
+        action->setShortcut(QKeySequence(Qt::Key_P));
+        return action;
+    }
+
+private slots:
+
+    void compute()
+    {
+        stop();
+
+        /* The workers use a copy of their own, the view keeps
+           iterating the model of the canvas. */
+        profiled_ = model()->set_range(model()->min_time(), model()->max_time());
+
+        /* Models with prefix sums give the profile at once, the
+           threads add the shortest and longest calls. */
+        std::vector<Profile_entry> entries;
+        bool instant = true;
+        foreach (int component, profiled_->visible_components())
+        {
+            if (!profiled_->range_profile(component, profiled_->min_time(),
+                                          profiled_->max_time(), entries))
+            {
+                instant = false;
+                break;
+            }
+        }
+        if (instant)
+            showProfile(entries);
+
+        workers_.start(profiled_, &Trace_model::profile, profiled_->search_parts(),
+                       this, SLOT(workerFinished()));
+
+        started_.start();
+        status_->setText(tr("Computing..."));
+    }
+
+    void workerFinished()
+    {
+        if (!workers_.finished()) return;
+
+        std::vector<Profile_entry> entries;
+        std::vector<const std::vector<Profile_entry>*> results = workers_.results();
+        for (unsigned i = 0; i < results.size(); ++i)
+            entries.insert(entries.end(), results[i]->begin(), results[i]->end());
+        workers_.stop();
+
+        showProfile(entries);
+        status_->setText(tr("%1 - %2, computed in %3 ms")
+                         .arg(profiled_->min_time().toString(true))
+                         .arg(profiled_->max_time().toString(true))
+                         .arg(started_.elapsed()));
+    }
+
+private:
+
+    void stop()
+    {
+        workers_.stop();
+    }
+
+    void showProfile(const std::vector<Profile_entry>& entries)
+    {
+        table_->removeRows(0, table_->rowCount());
+        view_->setSortingEnabled(false);
+
+        /* Totals of each function, with the entries of the processes. */
+        QMap<int, Profile_entry> totals;
+        QMap<int, QList<const Profile_entry*> > components;
+        for (unsigned i = 0; i < entries.size(); ++i)
+        {
+            const Profile_entry& e = entries[i];
+            components[e.type] << &e;
+
+            if (!totals.contains(e.type))
+            {
+                totals[e.type] = e;
+                continue;
+            }
+
+            Profile_entry& t = totals[e.type];
+            t.calls += e.calls;
+            t.inclusive += e.inclusive;
+            t.exclusive += e.exclusive;
+            t.min = qMin(t.min, e.min);
+            t.max = qMax(t.max, e.max);
+        }
+
+        QMap<int, Profile_entry>::const_iterator i;
+        for (i = totals.constBegin(); i != totals.constEnd(); ++i)
+        {
+            QList<QStandardItem*> row =
+                makeRow(profiled_->states().item(i.key()), i.value());
+            table_->appendRow(row);
+
+            foreach (const Profile_entry* e, components[i.key()])
+                row[0]->appendRow(
+                    makeRow(profiled_->component_name(e->component), *e));
+        }
+
+        view_->setSortingEnabled(true);
+        view_->sortByColumn(3, Qt::DescendingOrder);
+        view_->resizeColumnToContents(0);
+    }
+
+    QList<QStandardItem*> makeRow(const QString& name, const Profile_entry& e)
+    {
+        QList<QStandardItem*> row;
+        QStandardItem* item = new QStandardItem(name);
+        item->setData(name, Qt::UserRole);
+        row << item;
+        row << numberItem(QString::number(e.calls), e.calls);
+        row << numberItem(duration(e.inclusive), e.inclusive);
+        row << numberItem(duration(e.exclusive), e.exclusive);
+        row << numberItem(e.min < 0 ? QString() : duration(e.min), e.min);
+        row << numberItem(e.max < 0 ? QString() : duration(e.max), e.max);
+
+        int64_t mean = e.calls ? e.inclusive / e.calls : 0;
+        row << numberItem(duration(mean), mean);
+        return row;
+    }
+
+    /** Item shown as text and sorted by the number. */
+    QStandardItem* numberItem(const QString& text, int64_t value)
+    {
+        QStandardItem* item = new QStandardItem(text);
+        item->setData((qlonglong)value, Qt::UserRole);
+        item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        return item;
+    }
+
+    QString duration(int64_t ticks) const
+    {
+        return (profiled_->ticks_time(ticks) - profiled_->ticks_time(0)).toString(true);
+    }
+
+private:
+    QLabel* status_;
+    QTreeView* view_;
+    QStandardItemModel* table_;
+
+    Trace_model::Ptr profiled_;
+    Part_workers<std::vector<Profile_entry> > workers_;
+    QTime started_;
+};
+
+
+Tool* createProfile(QWidget* parent, Canvas* canvas)
+{
+    return new Profile(parent, canvas);
+}
+
+}
+
+#endif
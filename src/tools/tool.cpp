@@ -7,6 +7,7 @@
 #include <QGridLayout>
 #include <QLabel>
 #include <QKeyEvent>
+#include <QTimer>
 
 namespace vis4 {
 
@@ -51,4 +52,35 @@ bool Tool::event(QEvent * event)
     return QWidget::event(event);
 }
 
+Range_tool::Range_tool(QWidget* parent, Canvas* c)
+    : Tool(parent, c), active_(false)
+{
+    timer_ = new QTimer(this);
+    timer_->setSingleShot(true);
+    timer_->setInterval(300);
+    connect(timer_, SIGNAL(timeout()), this, SLOT(compute()));
+
+    connect(canvas(), SIGNAL(modelChanged(Trace_model::Ptr &)),
+            this, SLOT(modelChanged(Trace_model::Ptr &)));
+}
+
+void Range_tool::activate()
+{
+    active_ = true;
+    compute();
+}
+
+void Range_tool::deactivate()
+{
+    active_ = false;
+    timer_->stop();
+    stop();
+}
+
+void Range_tool::modelChanged(Trace_model::Ptr &)
+{
+    if (active_)
+        timer_->start();
+}
+
 }
@@ -10,6 +10,7 @@
 
 class QAction;
 class QToolBar;
+class QTimer;
 
 namespace vis4 {
 
@@ -138,6 +139,41 @@ public:
 
 };
 
+/** Tool showing data computed over the visible part of the trace.
+    Zooming and scrolling change the model many times a second, so
+    the data is computed again only when they stop for a while. */
+class Range_tool : public Tool
+{
+    Q_OBJECT
+public:
+    Range_tool(QWidget* parent, Canvas* c);
+
+    /** Computes the data and keeps it up to date. */
+    void activate();
+
+    /** Stops computing. */
+    void deactivate();
+
+protected slots:
+
+    /** Starts computing the data for the current model, stopping the
+        previous computation. */
+    virtual void compute() = 0;
+
+protected:
+
+    /** Stops the computation under way, if any. */
+    virtual void stop() = 0;
+
+private slots:
+
+    void modelChanged(Trace_model::Ptr &);
+
+private:
+    bool active_;
+    QTimer* timer_;
+};
+
 
 
 
@@ -146,6 +182,10 @@ Tool* createGoto(QWidget* parent, Canvas* canvas);
 Tool* createMeasure(QWidget* parent, Canvas* canvas);
 Tool* createFilter(QWidget* parent, Canvas* canvas);
 Tool* createFind(QWidget* parent, Canvas* canvas);
+Tool* createProfile(QWidget* parent, Canvas* canvas);
+Tool* createCommunication(QWidget* parent, Canvas* canvas);
+Tool* createCriticalPath(QWidget* parent, Canvas* canvas);
+Tool* createWaitStates(QWidget* parent, Canvas* canvas);
 
 
 
@@ -0,0 +1,260 @@
+#ifndef WAITS_HPP
+#define WAITS_HPP
+
+#include "tool.h"
+#include "trace_model.h"
+#include "part_workers.h"
+#include "wait_states.h"
+#include "canvas.h"
+
+#include <QVBoxLayout>
+#include <QGroupBox>
+#include <QLabel>
+#include <QTreeView>
+#include <QStandardItemModel>
+#include <QTime>
+#include <QAction>
+#include <QMap>
+#include <QPair>
+
+#include <vector>
+
+namespace vis4 {
+
+using common::Time;
+
+/** Time spent waiting within the visible time range, by the kind of
+    wait, then by the call waiting, then by the process.
+
+    The messages, receives and collective calls are collected by
+    Trace_model::wait_part in one thread per processor, and the waits
+    are found by find_wait_states once all are done. The waits
+    themselves are found with the "Wait states" checker of Find. */
+class Wait_states : public Range_tool
+{
+    Q_OBJECT
+public:
+    Wait_states(QWidget* parent, Canvas* c)
+    : Range_tool(parent, c)
+    {
+        setObjectName("wait_states");
+        setWhatsThis(tr("<b>Wait states</b>"
+                        "<p>Shows the time processes spend waiting within the "
+                        "visible part of the trace: for a message sent late, for a "
+                        "receive called late, and for the last process to enter a "
+                        "collective operation. The time is listed by the calls "
+                        "waiting and by processes. Double click a row to zoom to "
+                        "its longest wait."));
+
+        setWindowTitle(tr("Wait states"));
+
+        QVBoxLayout* mainLayout = new QVBoxLayout(this);
+
+        QGroupBox* group = new QGroupBox(tr("Wait states"), this);
+        group->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+        mainLayout->addWidget(group);
+
+        QVBoxLayout* layout = new QVBoxLayout(group);
+
+        status_ = new QLabel(group);
+        status_->setWordWrap(true);
+        layout->addWidget(status_);
+
+        table_ = new QStandardItemModel(this);
+        table_->setSortRole(Qt::UserRole);
+        table_->setHorizontalHeaderLabels(QStringList()
+            << tr("Wait") << tr("Time") << tr("Count") << tr("Longest"));
+
+        view_ = new QTreeView(group);
+        view_->setModel(table_);
+        view_->setUniformRowHeights(true);
+        view_->setAlternatingRowColors(true);
+        view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        view_->setSortingEnabled(true);
+        layout->addWidget(view_);
+
+        connect(view_, SIGNAL(doubleClicked(const QModelIndex&)),
+                this, SLOT(rowDoubleClicked(const QModelIndex&)));
+    }
+
+    QAction* createAction()
+    {
+        QAction* action = new QAction(QIcon(":/wizard.png"), tr("&Wait states"), this);
+        action->setShortcut(QKeySequence(Qt::Key_W));
+        return action;
+    }
+
+private slots:
+
+    void compute()
+    {
+        stop();
+
+        computed_ = model()->set_range(model()->min_time(), model()->max_time());
+        workers_.start(computed_, &Trace_model::wait_part, computed_->search_parts(),
+                       this, SLOT(workerFinished()));
+
+        started_.start();
+        status_->setText(tr("Computing..."));
+    }
+
+    void workerFinished()
+    {
+        if (!workers_.finished()) return;
+
+        waits_.clear();
+        find_wait_states(workers_.results(), computed_->time_ticks(computed_->min_time()),
+                         computed_->time_ticks(computed_->max_time()), waits_);
+        workers_.stop();
+
+        int64_t total = showWaits();
+        status_->setText(tr("%1 waits, %2 in total, computed in %3 ms")
+                         .arg(waits_.size()).arg(duration(total))
+                         .arg(started_.elapsed()));
+    }
+
+    void rowDoubleClicked(const QModelIndex& index)
+    {
+        QVariant wait = index.sibling(index.row(), 3).data(Qt::UserRole + 1);
+        if (!wait.isValid()) return;
+
+        /* The wait is shown in the middle third of the view. */
+        const Wait_state& w = waits_[wait.toInt()];
+        int64_t margin = qMax((int64_t)1, w.end - w.begin);
+        canvas()->setModel(model()->set_range(
+            model()->ticks_time(w.begin - margin),
+            model()->ticks_time(w.end + margin)));
+    }
+
+private:
+
+    void stop()
+    {
+        workers_.stop();
+    }
+
+    /** Time, number and the longest of some waits. */
+    struct Total
+    {
+        Total() : time(0), count(0), longest(-1) {}
+
+        int64_t time;
+        int count;
+        int longest;                ///< Index in waits_.
+    };
+
+    /** Lists the totals of the waits and returns the time of all. */
+    int64_t showWaits()
+    {
+        table_->removeRows(0, table_->rowCount());
+        view_->setSortingEnabled(false);
+
+        int64_t min = computed_->time_ticks(computed_->min_time());
+        int64_t max = computed_->time_ticks(computed_->max_time());
+
+        typedef QPair<int, int> Key;
+        QMap<int, Total> kinds;
+        QMap<int, QMap<int, Total> > types;
+        QMap<Key, QMap<int, Total> > components;
+        Total all;
+        for (unsigned i = 0; i < waits_.size(); ++i)
+        {
+            const Wait_state& w = waits_[i];
+            int64_t time = qMin(w.end, max) - qMax(w.begin, min);
+
+            add(all, time, i);
+            add(kinds[w.kind], time, i);
+            add(types[w.kind][w.type], time, i);
+            add(components[Key(w.kind, w.type)][w.component], time, i);
+        }
+
+        QString names[Wait_state::kinds_count] = {
+            tr("Late sender"), tr("Late receiver"), tr("Collective") };
+
+        QMap<int, Total>::const_iterator k, t, c;
+        for (k = kinds.constBegin(); k != kinds.constEnd(); ++k)
+        {
+            QList<QStandardItem*> row = makeRow(names[k.key()], k.value());
+            table_->appendRow(row);
+
+            const QMap<int, Total>& calls = types[k.key()];
+            for (t = calls.constBegin(); t != calls.constEnd(); ++t)
+            {
+                QList<QStandardItem*> call = makeRow(
+                    computed_->states().item(t.key()), t.value());
+                row[0]->appendRow(call);
+
+                const QMap<int, Total>& processes = components[Key(k.key(), t.key())];
+                for (c = processes.constBegin(); c != processes.constEnd(); ++c)
+                    call[0]->appendRow(makeRow(
+                        computed_->component_name(c.key()), c.value()));
+            }
+        }
+
+        view_->setSortingEnabled(true);
+        view_->sortByColumn(1, Qt::DescendingOrder);
+        view_->resizeColumnToContents(0);
+        return all.time;
+    }
+
+    void add(Total& total, int64_t time, int wait)
+    {
+        total.time += time;
+        ++total.count;
+        if (total.longest == -1
+            || waits_[wait].end - waits_[wait].begin
+               > waits_[total.longest].end - waits_[total.longest].begin)
+            total.longest = wait;
+    }
+
+    QList<QStandardItem*> makeRow(const QString& name, const Total& total)
+    {
+        const Wait_state& w = waits_[total.longest];
+
+        QList<QStandardItem*> row;
+        QStandardItem* item = new QStandardItem(name);
+        item->setData(name, Qt::UserRole);
+        row << item;
+        row << numberItem(duration(total.time), total.time);
+        row << numberItem(QString::number(total.count), total.count);
+
+        item = numberItem(duration(w.end - w.begin), w.end - w.begin);
+        item->setData(total.longest, Qt::UserRole + 1);
+        row << item;
+        return row;
+    }
+
+    /** Item shown as text and sorted by the number. */
+    QStandardItem* numberItem(const QString& text, int64_t value)
+    {
+        QStandardItem* item = new QStandardItem(text);
+        item->setData((qlonglong)value, Qt::UserRole);
+        item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        return item;
+    }
+
+    QString duration(int64_t ticks) const
+    {
+        return (computed_->ticks_time(ticks) - computed_->ticks_time(0)).toString(true);
+    }
+
+private:
+    QLabel* status_;
+    QTreeView* view_;
+    QStandardItemModel* table_;
+
+    Trace_model::Ptr computed_;
+    Part_workers<Wait_part> workers_;
+    QTime started_;
+    std::vector<Wait_state> waits_;
+};
+
+
+Tool* createWaitStates(QWidget* parent, Canvas* canvas)
+{
+    return new Wait_states(parent, canvas);
+}
+
+}
+
+#endif
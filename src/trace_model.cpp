@@ -1,7 +1,525 @@
 #include "trace_model.h"
+#include "event_model.h"
+#include "state_model.h"
+#include "group_model.h"
+#include "wait_states.h"
+
+#include <algorithm>
+#include <map>
+#include <math.h>
 
 namespace vis4 {
 
+using common::Time;
+
+Trace_model::Trace_model()
+: components_version_(new_version()),
+  events_version_(new_version()),
+  states_version_(new_version()),
+  pending_point_(0)
+{
+}
+
+unsigned Trace_model::new_version()
+{
+    /* Models are only created in the GUI thread. */
+    static unsigned last = 0;
+    return ++last;
+}
+
+int Trace_model::next_events(Event_record* records, int capacity)
+{
+    int count = 0;
+    while (count < capacity)
+    {
+        std::auto_ptr<Event_model> e = next_event();
+        if (!e.get()) break;
+
+        Event_record& r = records[count++];
+        r.time = time_ticks(e->time);
+        r.component = e->component;
+        r.kind = e->kind;
+        r.letter = e->letter;
+        r.subletter = e->subletter;
+        r.letter_position = e->letter_position;
+        r.priority = e->priority;
+    }
+    return count;
+}
+
+int Trace_model::next_states(State_record* records, int capacity)
+{
+    int count = 0;
+    while (count < capacity)
+    {
+        std::auto_ptr<State_model> s = next_state();
+        if (!s.get()) break;
+
+        State_record& r = records[count++];
+        r.begin = time_ticks(s->begin);
+        r.end = time_ticks(s->end);
+        r.type = s->type;
+        r.component = s->component;
+        r.color = s->color.rgb();
+    }
+    return count;
+}
+
+int Trace_model::next_groups(Group_record* records, int capacity)
+{
+    int count = 0;
+    while (count < capacity)
+    {
+        if (!pending_group_.get())
+        {
+            std::auto_ptr<Group_model> g = next_group();
+            if (!g.get()) break;
+
+            pending_group_.reset(g.release());
+            pending_point_ = 1;
+        }
+
+        const Group_model& g = *pending_group_;
+        for (; pending_point_ < g.points.size() && count < capacity; ++pending_point_)
+        {
+            Group_record& r = records[count++];
+            r.type = g.type;
+            r.from_component = g.points[0].component;
+            r.from_time = time_ticks(g.points[0].time);
+            r.to_component = g.points[pending_point_].component;
+            r.to_time = time_ticks(g.points[pending_point_].time);
+        }
+
+        if (pending_point_ >= g.points.size())
+            pending_group_.reset();
+    }
+    return count;
+}
+
+int64_t Trace_model::time_ticks(const Time& time) const
+{
+    return (int64_t)floor((time - min_time())/min_resolution() + 0.5);
+}
+
+Time Trace_model::ticks_time(int64_t ticks) const
+{
+    return min_time() + min_resolution()*double(ticks);
+}
+
+std::auto_ptr<Event_model> Trace_model::make_event(const Event_record& record) const
+{
+    std::auto_ptr<Event_model> e(new Event_model);
+    e->time = ticks_time(record.time);
+    e->kind = record.kind;
+    e->letter = record.letter;
+    e->subletter = record.subletter;
+    e->letter_position = (Event_model::letter_position_t)record.letter_position;
+    e->priority = record.priority;
+    e->component = record.component;
+    return e;
+}
+
+std::auto_ptr<State_model> Trace_model::make_state(const State_record& record) const
+{
+    std::auto_ptr<State_model> s(new State_model);
+    s->begin = ticks_time(record.begin);
+    s->end = ticks_time(record.end);
+    s->type = record.type;
+    s->component = record.component;
+    s->color = QColor(record.color);
+    return s;
+}
+
+namespace {
+
+bool earlier(const Event_record& a, const Event_record& b)
+{
+    return a.time < b.time;
+}
+
+}
+
+void Trace_model::lifeline_events(int component, const Time& min, const Time& max,
+                                  QVector<Event_record>& records)
+{
+    records.clear();
+
+    int l = lifeline(component);
+    if (l == -1) return;
+
+    common::Selection filter = components();
+    filter.disableAll(parent_component());
+    filter.setEnabled(visible_components()[l], true);
+
+    Trace_model::Ptr range = set_range(min, max)->filter_components(filter);
+    range->rewind();
+
+    const int batch_size = 256;
+    Event_record batch[batch_size];
+    while (int count = range->next_events(batch, batch_size))
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            /* Ticks of the derived model count from its own min_time. */
+            batch[i].time = time_ticks(range->ticks_time(batch[i].time));
+            records.push_back(batch[i]);
+        }
+    }
+
+    std::stable_sort(records.begin(), records.end(), earlier);
+}
+
+bool Trace_model::find_event(const Event_record* after, bool forward, Event_record& found)
+{
+    rewind();
+
+    bool any = false;
+    const int batch_size = 256;
+    Event_record batch[batch_size];
+    while (int count = next_events(batch, batch_size))
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const Event_record& e = batch[i];
+            if (after && !(forward ? find_order(*after, e) : find_order(e, *after)))
+                continue;
+
+            if (!any || (forward ? find_order(e, found) : find_order(found, e)))
+            {
+                found = e;
+                any = true;
+            }
+        }
+    }
+    return any;
+}
+
+bool Trace_model::find_state(const State_record* after, bool forward, State_record& found)
+{
+    rewind();
+
+    /* Iteration returns all states overlapping the range. */
+    int64_t min = time_ticks(min_time());
+
+    bool any = false;
+    const int batch_size = 256;
+    State_record batch[batch_size];
+    while (int count = next_states(batch, batch_size))
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const State_record& s = batch[i];
+            if (s.begin < min) continue;
+            if (after && !(forward ? find_order(*after, s) : find_order(s, *after)))
+                continue;
+
+            if (!any || (forward ? find_order(s, found) : find_order(found, s)))
+            {
+                found = s;
+                any = true;
+            }
+        }
+    }
+    return any;
+}
+
+int Trace_model::search_parts()
+{
+    collective_states_ = collective_states(states());
+    return 1;
+}
+
+void Trace_model::search_events(int part, Search_sink& sink)
+{
+    Q_ASSERT(part == 0);
+    rewind();
+
+    const int batch_size = 256;
+    Event_record batch[batch_size];
+    while (!sink.cancelled())
+    {
+        int count = next_events(batch, batch_size);
+        if (count == 0) break;
+        sink.found(batch, count);
+    }
+}
+
+void Trace_model::search_states(int part, Search_sink& sink)
+{
+    Q_ASSERT(part == 0);
+    rewind();
+
+    const int batch_size = 256;
+    State_record batch[batch_size];
+    while (!sink.cancelled())
+    {
+        int count = next_states(batch, batch_size);
+        if (count == 0) break;
+        sink.found(batch, count);
+    }
+}
+
+namespace {
+
+bool state_nests_before(const State_record& a, const State_record& b)
+{
+    if (a.component != b.component) return a.component < b.component;
+    if (a.begin != b.begin) return a.begin < b.begin;
+    return a.end > b.end;
+}
+
+}
+
+void Trace_model::profile(int part, std::vector<Profile_entry>& entries)
+{
+    Q_ASSERT(part == 0);
+
+    std::vector<State_record> states;
+    rewind();
+
+    const int batch_size = 256;
+    State_record batch[batch_size];
+    while (int count = next_states(batch, batch_size))
+        states.insert(states.end(), batch, batch + count);
+
+    std::sort(states.begin(), states.end(), state_nests_before);
+
+    int64_t min = time_ticks(min_time()), max = time_ticks(max_time());
+    std::map<std::pair<int, int>, int> index;
+
+    /* Open calls of the current component, innermost last. */
+    std::vector<std::pair<int64_t, int> > open;
+    for (unsigned i = 0; i < states.size(); ++i)
+    {
+        const State_record& s = states[i];
+        if (i > 0 && states[i-1].component != s.component)
+            open.clear();
+        while (!open.empty() && open.back().first <= s.begin)
+            open.pop_back();
+
+        int64_t time = std::min(s.end, max) - std::max(s.begin, min);
+        if (time < 0) time = 0;
+
+        std::pair<int, int> key(s.component, s.type);
+        std::map<std::pair<int, int>, int>::iterator k = index.find(key);
+        if (k == index.end())
+        {
+            Profile_entry e = { s.component, s.type, 0, 0, 0, time, time };
+            k = index.insert(std::make_pair(key, (int)entries.size())).first;
+            entries.push_back(e);
+        }
+
+        bool recursive = false;
+        for (unsigned o = 0; o < open.size(); ++o)
+            if (open[o].second == k->second)
+                recursive = true;
+
+        Profile_entry& e = entries[k->second];
+        ++e.calls;
+        if (!recursive)
+            e.inclusive += time;
+        e.exclusive += time;
+        e.min = std::min(e.min, time);
+        e.max = std::max(e.max, time);
+
+        if (!open.empty())
+            entries[open.back().second].exclusive -= time;
+        open.push_back(std::make_pair(s.end, k->second));
+    }
+}
+
+bool Trace_model::range_profile(int component, const Time& min, const Time& max,
+                                std::vector<Profile_entry>& entries)
+{
+    return false;
+}
+
+void Trace_model::critical_path_part(int part, Path_part& data)
+{
+    Q_ASSERT(part == 0);
+    rewind();
+
+    int64_t min = time_ticks(min_time()), max = time_ticks(max_time());
+
+    const int batch_size = 256;
+    Group_record groups[batch_size];
+    while (int count = next_groups(groups, batch_size))
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const Group_record& g = groups[i];
+            if (g.from_time < min || g.to_time > max) continue;
+
+            Path_message m = { g.from_component, g.to_component, g.from_time, g.to_time };
+            data.messages.push_back(m);
+        }
+    }
+
+    std::vector<State_record> states;
+    State_record batch[batch_size];
+    while (int count = next_states(batch, batch_size))
+        states.insert(states.end(), batch, batch + count);
+
+    std::sort(states.begin(), states.end(), state_nests_before);
+
+    for (unsigned i = 0; i < states.size(); ++i)
+    {
+        const State_record& s = states[i];
+        Path_call c = { s.component, s.type, s.begin, s.end };
+        data.calls.push_back(c);
+    }
+}
+
+namespace {
+
+typedef std::map<int, std::vector<Wait_call> > Call_map;
+typedef std::map<int, Call_stack> Stack_map;
+
+/** Returns the innermost call of the component at time, which must not
+    decrease for the component. */
+Wait_call call_at(Call_map& calls, Stack_map& stacks, int component, int64_t time)
+{
+    Stack_map::iterator i = stacks.find(component);
+    if (i == stacks.end())
+        i = stacks.insert(std::make_pair(
+            component, Call_stack(component, calls[component]))).first;
+
+    return i->second.at(time);
+}
+
+bool group_sent_before(const Group_record& a, const Group_record& b)
+{
+    return a.from_time < b.from_time;
+}
+
+bool group_received_before(const Group_record& a, const Group_record& b)
+{
+    return a.to_time < b.to_time;
+}
+
+}
+
+void Trace_model::wait_part(int part, Wait_part& data)
+{
+    Q_ASSERT(part == 0);
+    rewind();
+
+    const int batch_size = 256;
+    std::vector<Group_record> groups;
+    Group_record batch[batch_size];
+    while (int count = next_groups(batch, batch_size))
+        groups.insert(groups.end(), batch, batch + count);
+
+    std::vector<State_record> states;
+    State_record state_batch[batch_size];
+    while (int count = next_states(state_batch, batch_size))
+        states.insert(states.end(), state_batch, state_batch + count);
+
+    std::sort(states.begin(), states.end(), state_nests_before);
+
+    Call_map calls;
+    std::map<std::pair<int, int>, int64_t> numbers;
+    for (unsigned i = 0; i < states.size(); ++i)
+    {
+        const State_record& s = states[i];
+        Wait_call c = { s.component, s.type, s.begin, s.end };
+        calls[s.component].push_back(c);
+
+        if (s.type >= 0 && s.type < (int)collective_states_.size()
+            && collective_states_[s.type])
+        {
+            Wait_collective w = { numbers[std::make_pair(s.component, s.type)]++, c };
+            data.collectives.push_back(w);
+        }
+    }
+
+    Stack_map senders;
+    std::stable_sort(groups.begin(), groups.end(), group_sent_before);
+    for (unsigned i = 0; i < groups.size(); ++i)
+    {
+        const Group_record& g = groups[i];
+        Wait_message m = { g.to_component, g.from_time, g.to_time,
+                           call_at(calls, senders, g.from_component, g.from_time) };
+        data.messages.push_back(m);
+    }
+
+    Stack_map receivers;
+    std::stable_sort(groups.begin(), groups.end(), group_received_before);
+    for (unsigned i = 0; i < groups.size(); ++i)
+    {
+        const Group_record& g = groups[i];
+        Wait_receive r = { g.to_time,
+                           call_at(calls, receivers, g.to_component, g.to_time) };
+        data.receives.push_back(r);
+    }
+}
+
+bool Trace_model::activity(int bins, std::vector<Activity_bin>& activity)
+{
+    return false;
+}
+
+bool Trace_model::range_statistics(int component, const Time& min, const Time& max,
+                                   Range_statistics& statistics)
+{
+    return false;
+}
+
+int latency_bin(int64_t latency)
+{
+    int bin = 0;
+    for (uint64_t l = latency < 0 ? 0 : latency + 1; l > 1; l >>= 1)
+        ++bin;
+    return std::min(bin, (int)Communication_entry::latency_bins - 1);
+}
+
+void Trace_model::communication(int part, std::vector<Communication_entry>& entries)
+{
+    Q_ASSERT(part == 0);
+    rewind();
+
+    int64_t min = time_ticks(min_time()), max = time_ticks(max_time());
+    std::map<std::pair<int, int>, int> index;
+
+    const int batch_size = 256;
+    Group_record batch[batch_size];
+    while (int count = next_groups(batch, batch_size))
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const Group_record& g = batch[i];
+            if (g.from_time < min || g.from_time > max) continue;
+
+            std::pair<int, int> key(g.from_component, g.to_component);
+            std::map<std::pair<int, int>, int>::iterator k = index.find(key);
+            if (k == index.end())
+            {
+                Communication_entry e = { g.from_component, g.to_component, 0, 0, { 0 } };
+                k = index.insert(std::make_pair(key, (int)entries.size())).first;
+                entries.push_back(e);
+            }
+
+            Communication_entry& e = entries[k->second];
+            ++e.messages;
+            ++e.latency[latency_bin(g.to_time - g.from_time)];
+        }
+    }
+}
+
+bool find_order(const Event_record& a, const Event_record& b)
+{
+    if (a.time != b.time) return a.time < b.time;
+    if (a.component != b.component) return a.component < b.component;
+    return a.kind < b.kind;
+}
+
+bool find_order(const State_record& a, const State_record& b)
+{
+    if (a.begin != b.begin) return a.begin < b.begin;
+    if (a.component != b.component) return a.component < b.component;
+    return a.type < b.type;
+}
+
 int delta(const Trace_model& a, const Trace_model& b)
 {
     int result = 0;
@@ -9,19 +527,25 @@ int delta(const Trace_model& a, const Trace_model& b)
     if (a.parent_component() != b.parent_component())
         result |= Trace_model_delta::component_position;
 
-    if (a.components() != b.components())
+    /* Selections are compared only if their stamps differ, the
+       selection might still be the same. */
+    bool components_changed = a.components_version() != b.components_version();
+    bool states_changed = a.states_version() != b.states_version();
+
+    if (components_changed && a.components() != b.components())
         result |= Trace_model_delta::components;
 
-    if (a.events() != b.events())
+    if (a.events_version() != b.events_version() && a.events() != b.events())
         result |= Trace_model_delta::event_types;
 
     if (a.groupsEnabled() != b.groupsEnabled())
         result |= Trace_model_delta::event_types;
 
-    if (a.states() != b.states())
+    if (states_changed && a.states() != b.states())
         result |= Trace_model_delta::state_types;
 
-    if (a.available_states() != b.available_states())
+    if ((components_changed || states_changed)
+        && a.available_states() != b.available_states())
         result |= Trace_model_delta::state_types;
 
     if (!a.min_time().sameType(b.min_time())
@@ -7,8 +7,13 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <QColor>
+#include <QVector>
+
 #include <memory>
 #include <vector>
+#include <map>
+#include <stdint.h>
 
 class Trace;
 
@@ -19,6 +24,220 @@ class State_model;
 class Group_model;
 class Checker;
 
+/** @name Plain records of the batch iteration.
+    Unlike Event_model and friends, these have no virtual methods and
+    own no memory, so arrays of them are filled without allocations.
+    Times are in ticks of the model, see Trace_model::time_ticks. */
+//@{
+struct Event_record
+{
+    int64_t time;
+    int component;
+    uint32_t kind;                  ///< Kind name in String_table.
+    char letter;
+    char subletter;
+    unsigned char letter_position;  ///< Event_model::letter_position_t.
+    unsigned char priority;
+};
+
+struct State_record
+{
+    int64_t begin;
+    int64_t end;
+    int type;                       ///< Link in Trace_model::states().
+    int component;
+    QRgb color;
+};
+
+/** Arrow of a group. Group of n points is returned as n-1 records
+    going from its first point. */
+struct Group_record
+{
+    int type;
+    int from_component;
+    int to_component;
+    int64_t from_time;
+    int64_t to_time;
+};
+//@}
+
+/** Calls of one function on one component, within the time range of
+    the model. Calls crossing the range are cut by it. Times are in
+    ticks. The exclusive time excludes the calls made by the function,
+    the inclusive time counts recursive calls once, with the outermost. */
+struct Profile_entry
+{
+    int component;
+    int type;                       ///< Link in Trace_model::states().
+    int64_t calls;
+    int64_t inclusive;
+    int64_t exclusive;
+    int64_t min;                    ///< Shortest inclusive time of a call.
+    int64_t max;
+};
+
+/** Messages from one component to another sent within the time range
+    of the model. Latencies are counted in bins of powers of two: bin
+    k counts latencies of at least 2^k - 1 and less than 2^(k+1) - 1
+    ticks. */
+struct Communication_entry
+{
+    enum { latency_bins = 32 };
+
+    int sender;
+    int receiver;
+    int64_t messages;
+    int64_t bytes;
+    uint32_t latency[latency_bins];
+};
+
+/** Returns the latency bin of Communication_entry for the latency. */
+int latency_bin(int64_t latency);
+
+/** Activity of one component within a time range, see
+    Trace_model::range_statistics. Times are in ticks. */
+struct Range_statistics
+{
+    int component;
+    std::map<int, int64_t> events;      ///< Number of events of each kind,
+                                        ///< by link in Trace_model::events().
+    std::vector<Profile_entry> states;  ///< As given by range_profile.
+    int64_t messages;                   ///< Messages sent within the range.
+    int64_t bytes;
+};
+
+/** @name Data of the critical path, see Trace_model::critical_path_part.
+    Times are in ticks. */
+//@{
+struct Path_message
+{
+    int sender;
+    int receiver;
+    int64_t send_time;
+    int64_t receive_time;
+};
+
+struct Path_call
+{
+    int component;
+    int type;                       ///< Link in Trace_model::states().
+    int64_t begin;
+    int64_t end;
+};
+
+/** Messages and calls of some parts. Calls of a component come from
+    one part, sorted by begin, so that nested calls follow their
+    parents. */
+struct Path_part
+{
+    std::vector<Path_message> messages;
+    std::vector<Path_call> calls;
+};
+
+/** Step of the critical path. A step within a component is blamed on
+    the state taking most of its time, as the innermost call. A step
+    along a message goes from its send to its receive. */
+struct Path_segment
+{
+    enum Kind { local, message };
+
+    Kind kind;
+    int component;                  ///< Receiver, for messages.
+    int from_component;             ///< Sender, for messages.
+    int64_t begin;
+    int64_t end;
+    int type;                       ///< Link in Trace_model::states() of the
+                                    ///< blamed state, -1 if none.
+};
+//@}
+
+/** @name Data of the wait states, see Trace_model::wait_part. Times
+    are in ticks. */
+//@{
+struct Wait_call
+{
+    int component;
+    int type;                       ///< Link in Trace_model::states(),
+                                    ///< -1 if there is no call.
+    int64_t begin;
+    int64_t end;
+};
+
+/** Message sent by a component of the part, with the innermost call
+    of the sender at the send. */
+struct Wait_message
+{
+    int receiver;
+    int64_t send_time;
+    int64_t receive_time;
+    Wait_call send;
+};
+
+/** Receive made by a component of the part, with the innermost call
+    at the receive. */
+struct Wait_receive
+{
+    int64_t time;
+    Wait_call call;
+};
+
+/** Call of a collective operation. Calls of one operation on the
+    components have the same type and number, counting the calls of
+    the type on each component. */
+struct Wait_collective
+{
+    int64_t number;
+    Wait_call call;
+};
+
+struct Wait_part
+{
+    std::vector<Wait_message> messages;
+    std::vector<Wait_receive> receives;
+    std::vector<Wait_collective> collectives;
+};
+
+/** Time a component spends waiting for another one within a call. */
+struct Wait_state
+{
+    enum Kind { late_sender, late_receiver, collective, kinds_count };
+
+    Kind kind;
+    int component;                  ///< Waiting component.
+    int peer;                       ///< Component waited for.
+    int type;                       ///< Link in Trace_model::states() of the
+                                    ///< call waiting.
+    int64_t begin;
+    int64_t end;
+};
+//@}
+
+/** Activity of all shown components within a time bin. Counts are
+    fractional, since a summary covering several bins is shared by
+    them in proportion to time. */
+struct Activity_bin
+{
+    double events;                  ///< Markers.
+    double messages;                ///< Sends and receives.
+    int state;                      ///< Link in Trace_model::states() of the
+                                    ///< dominant state, -1 if none.
+    QRgb color;                     ///< Color of that state.
+};
+
+/** Receiver of the records found by Trace_model::search_events and
+    search_states. Called from the threads doing the search. */
+class Search_sink
+{
+public:
+    virtual ~Search_sink() {}
+
+    /** Returns true if the search must stop. */
+    virtual bool cancelled() = 0;
+
+    virtual void found(const Event_record* records, int count) = 0;
+    virtual void found(const State_record* records, int count) = 0;
+};
+
 /**     .
 
         ,       ( ,
@@ -131,6 +350,151 @@ public:
 
 /// @}
 
+/** @defgroup batch Methods for batch iteration.
+    These methods continue the iteration of next_event, next_state
+    and next_group, filling up to capacity records into the array of
+    the caller. They return the number of records filled, zero at the
+    end.
+
+    Default implementations call next_event, next_state and next_group
+    and convert the objects, so an implementation must override at
+    least one method of each pair. Overriding the batch methods saves
+    a virtual call and an allocation per record. */
+/// @{
+
+    virtual int next_events(Event_record* records, int capacity);
+    virtual int next_states(State_record* records, int capacity);
+
+    /** A group that does not fit is continued by the next call.
+        Implementations using the default must call drop_pending_group
+        from rewind. */
+    virtual int next_groups(Group_record* records, int capacity);
+
+    /** Converts time to ticks of the batch records. The default counts
+        min_resolution intervals from min_time, so ticks of models
+        with different ranges are not comparable. */
+    virtual int64_t time_ticks(const common::Time& time) const;
+
+    /** Converts ticks of the batch records to time. */
+    virtual common::Time ticks_time(int64_t ticks) const;
+
+    /** Creates objects for records, for the code showing the details.
+        Implementations with Event_model or State_model descendants
+        should override these. */
+    virtual std::auto_ptr<Event_model> make_event(const Event_record& record) const;
+    virtual std::auto_ptr<State_model> make_state(const State_record& record) const;
+
+/// @}
+
+/** @defgroup queries Methods for queries of one lifeline. */
+/// @{
+
+    /** Fills records with the events shown on the lifeline of component
+        within [min, max], in time order. Times are in ticks of this
+        model. The range and filters of the model are not used, except
+        for the event filter.
+
+        The default derives a model for the range and the component
+        and iterates it, implementations keeping the events of each
+        lifeline sorted by time should override it. */
+    virtual void lifeline_events(int component,
+                                 const common::Time& min, const common::Time& max,
+                                 QVector<Event_record>& records);
+
+/// @}
+
+/** @defgroup find Methods for finding events and states.
+    Records are ordered by time, component and type, see find_order.
+    Records shown by the model and equal in this order are found once. */
+/// @{
+
+    /** Finds the event following after, or preceding it if forward is
+        false, among the events the model shows within its range. If
+        after is 0, finds the first or the last event.
+
+        The default iterates the whole range on every call, and resets
+        the iteration. Implementations with an index of the events
+        should override it. found must not be the record at after. */
+    virtual bool find_event(const Event_record* after, bool forward, Event_record& found);
+
+    /** Same as find_event, for states beginning within the range. */
+    virtual bool find_state(const State_record* after, bool forward, State_record& found);
+
+/// @}
+
+/** @defgroup search Methods for searches in several threads.
+    The data shown by the model is split into parts, and the parts
+    are searched by search_events and search_states from several
+    threads at once. search_parts is called first, from the GUI
+    thread; after that the object must not be used otherwise until
+    the search ends. Records found are passed to the sink in batches,
+    in no particular order. */
+/// @{
+
+    /** Prepares the search and returns the number of parts. The
+        default has one part, searched by iteration, and finds the
+        collective states for wait_part. */
+    virtual int search_parts();
+
+    /** Passes the events of the part shown by the model to sink. */
+    virtual void search_events(int part, Search_sink& sink);
+
+    /** Passes the states of the part shown by the model to sink. */
+    virtual void search_states(int part, Search_sink& sink);
+
+    /** Appends the profile of the part to entries, one entry for each
+        component and enabled state. The default iterates the states,
+        taking the states overlapping a state of the same component
+        for the calls made by it. */
+    virtual void profile(int part, std::vector<Profile_entry>& entries);
+
+    /** Appends the profile of the states of component within [min, max]
+        to entries, using data prepared by the model so that the time
+        doesn't depend on the number of calls. min and max of the entries
+        are not known and are set to -1. Returns false if the model can't
+        do it, the default; profile must be used then. Called from the
+        GUI thread. */
+    virtual bool range_profile(int component, const common::Time& min,
+                               const common::Time& max,
+                               std::vector<Profile_entry>& entries);
+
+    /** Appends the messages of the part to entries, one entry for each
+        pair of components that communicate. Pairs without messages
+        have no entry. The default iterates the groups, without bytes. */
+    virtual void communication(int part, std::vector<Communication_entry>& entries);
+
+    /** Appends the messages sent and received and the calls made
+        within the time range by the components of the part to data,
+        for find_critical_path. The default iterates the groups and the
+        states. */
+    virtual void critical_path_part(int part, Path_part& data);
+
+    /** Appends the messages sent, the receives and the collective
+        calls of the components of the part to data, for
+        find_wait_states. Messages received within the time range are
+        taken, with all the calls of the components, so that the calls
+        waiting within the range are found. The default iterates the
+        groups and the states, numbering collective calls from the
+        start of the range. */
+    virtual void wait_part(int part, Wait_part& data);
+
+    /** Splits the time range of the model into bins of equal width and
+        fills activity with the activity of each, using summaries
+        prepared by the model so that the time doesn't depend on the
+        number of records. Returns false if the model has no summaries,
+        the default. Called from the GUI thread. */
+    virtual bool activity(int bins, std::vector<Activity_bin>& activity);
+
+    /** Fills statistics with the events, states and messages of
+        component within [min, max], in the same way as range_profile.
+        Returns false if the model can't do it, the default. Called
+        from the GUI thread. */
+    virtual bool range_statistics(int component, const common::Time& min,
+                                  const common::Time& max,
+                                  Range_statistics& statistics);
+
+/// @}
+
 /** @defgroup filters Methods for managing filters. */
 /// @{
 
@@ -196,8 +560,49 @@ public:
          . */
     virtual void restore(const QString& s) = 0;
 
+/** @defgroup versions Version stamps of the selections.
+    A model derived with a changed selection of components, events or
+    states gets a new stamp for it, other derived models keep the
+    stamps of the original. Equal stamps mean equal selections, which
+    lets delta skip comparing them. */
+/// @{
+
+    unsigned components_version() const { return components_version_; }
+    unsigned events_version() const { return events_version_; }
+    unsigned states_version() const { return states_version_; }
+
+/// @}
+
+    Trace_model();
     virtual ~Trace_model() {}
 
+protected:
+
+    void drop_pending_group() { pending_group_.reset(); }
+
+    /** Give the model a new stamp. Implementations call these when
+        they change a selection. */
+    //@{
+    void components_changed() { components_version_ = new_version(); }
+    void events_changed() { events_version_ = new_version(); }
+    void states_changed() { states_version_ = new_version(); }
+    //@}
+
+private:
+
+    static unsigned new_version();
+
+    unsigned components_version_;
+    unsigned events_version_;
+    unsigned states_version_;
+
+    /** Group partially returned by the default next_groups. */
+    boost::shared_ptr<Group_model> pending_group_;
+    unsigned pending_point_;
+
+    /** Flags of is_collective for each state, for the default wait_part. */
+    std::vector<bool> collective_states_;
+
 };
 
 
@@ -219,5 +624,10 @@ struct Trace_model_delta
    second. */
 int delta(const Trace_model& a, const Trace_model& b);
 
+/** Order of the find methods: by time, then by component, then by
+    kind or type. States are ordered by begin. */
+bool find_order(const Event_record& a, const Event_record& b);
+bool find_order(const State_record& a, const State_record& b);
+
 }
 #endif
@@ -3,6 +3,7 @@
 #include "state_model.h"
 #include "group_model.h"
 #include "event_model.h"
+#include "batch_kernels.h"
 
 #include <QPrinter>
 #include <QPainter>
@@ -64,7 +65,8 @@ using common::Time;
 using common::Selection;
 
 Trace_painter::Trace_painter()
-    : right_margin(5), painter(0), tg(0), state_(Ready)
+    : right_margin(5), painter(0), tg(0),
+      min_ticks(0), pixels_per_tick(0), state_(Ready)
 {
     QFontMetrics fm(QApplication::font());
     text_elements_height = (fm.height() + 2)/2*2;
@@ -348,6 +350,36 @@ int Trace_painter::pixelPositionForTime(const Time& time) const
     return int(ratio*lifelines_width + left_margin);
 }
 
+void Trace_painter::updateTickScale()
+{
+    int lifelines_width = width - left_margin - right_margin;
+
+    min_ticks = model->time_ticks(model->min_time());
+    double ticks_per_page = model->time_ticks(model->min_time() + timePerPage)
+        - min_ticks;
+    pixels_per_tick = ticks_per_page > 0 ? lifelines_width/ticks_per_page : 0;
+}
+
+void Trace_painter::pixelPositionsForTicks(const int64_t* ticks, int count, int* pixels) const
+{
+    ticks_to_pixels(ticks, count, min_ticks, pixels_per_tick, left_margin, pixels);
+}
+
+void Trace_painter::updateLifelineTable()
+{
+    int count = model->components().totalItemsCount();
+    lifeline_table.resize(count);
+    for (int c = 0; c < count; ++c)
+        lifeline_table[c] = model->lifeline(c);
+}
+
+void Trace_painter::lifelinesForComponents(const int* components, int count, int* lifelines) const
+{
+    components_to_lifelines(components, count,
+                            lifeline_table.empty() ? 0 : &lifeline_table[0],
+                            lifeline_table.size(), lifelines);
+}
+
 Time Trace_painter::timeForPixel(int pixel_x) const
 {
     // If x coordinate less than timeline
@@ -534,43 +566,77 @@ NP          {
 
 void Trace_painter::drawStates(int from_component, int to_component)
 {
-    model->rewind();
+    State_record states[batch_size];
+    int64_t ticks[2][batch_size];
+    int pixels[2][batch_size];
+    int components[batch_size];
+    int lifelines[batch_size];
 
-    for(;;)
-    {
-        std::auto_ptr<State_model> s = model->next_state();
-        if (!s.get()) break;
+    updateTickScale();
+    updateLifelineTable();
 
-        int lifeline = model->lifeline(s.get()->component);
-        if (lifeline < from_component || lifeline > to_component) continue;
+    // Setting a brush allocates, so it's only done when
+    // the color changes.
+    bool brush_set = false;
+    QRgb brush_color = 0;
 
-        int pixel_begin = pixelPositionForTime(s->begin);
-        int pixel_end = pixelPositionForTime(s->end);
+    model->rewind();
 
-        painter->setBrush(s->color);
+    for(;;)
+    {
+        int count = model->next_states(states, batch_size);
+        if (count == 0) break;
 
-        int text_begin = -1;
-        if (pixel_begin < left_margin)
+        for (int k = 0; k < count; ++k)
         {
-            pixel_begin = left_margin-10;
-            text_begin = left_margin;
+            ticks[0][k] = states[k].begin;
+            ticks[1][k] = states[k].end;
+            components[k] = states[k].component;
         }
-        if (pixel_end > width-right_margin)
-            pixel_end = width-right_margin+10;
+        pixelPositionsForTicks(ticks[0], count, pixels[0]);
+        pixelPositionsForTicks(ticks[1], count, pixels[1]);
+        lifelinesForComponents(components, count, lifelines);
 
-        /* If a state takes only one pixel, prune it. */
-        if (pixel_end != pixel_begin)
+        for (int k = 0; k < count; ++k)
         {
-            QRect r = drawTextBox(model->states().item(s->type), painter,
-                                  pixel_begin, lifeline_position[lifeline],
-                                  pixel_end-pixel_begin, text_elements_height,
-                                  text_begin);
+            const State_record& s = states[k];
 
-            if (!printer_flag)
+            int lifeline = lifelines[k];
+            if (lifeline < from_component || lifeline > to_component) continue;
+
+            int pixel_begin = pixels[0][k];
+            int pixel_end = pixels[1][k];
+
+            if (!brush_set || s.color != brush_color)
+            {
+                painter->setBrush(QColor(s.color));
+                brush_color = s.color;
+                brush_set = true;
+            }
+
+            int text_begin = -1;
+            if (pixel_begin < left_margin)
             {
-                State_model* sm = s.release();
-                tg->states.push_back(
-                    qMakePair(r, boost::shared_ptr<State_model>(sm)));
+                pixel_begin = left_margin-10;
+                text_begin = left_margin;
+            }
+            if (pixel_end > width-right_margin)
+                pixel_end = width-right_margin+10;
+
+            /* If a state takes only one pixel, prune it. */
+            if (pixel_end != pixel_begin)
+            {
+                QRect r = drawTextBox(model->states().item(s.type), painter,
+                                      pixel_begin, lifeline_position[lifeline],
+                                      pixel_end-pixel_begin, text_elements_height,
+                                      text_begin);
+
+                if (!printer_flag)
+                {
+                    tg->states.push_back(
+                        qMakePair(r, boost::shared_ptr<State_model>(
+                            model->make_state(s).release())));
+                }
             }
         }
 
@@ -618,134 +684,156 @@ void Trace_painter::drawEvents(int from_component, int to_component)
     // line and draw event line once every 3 pixels.
     vector<int> last_event_line(model->visible_components().size(), -10);
 
+    Event_record events[batch_size];
+    int64_t ticks[batch_size];
+    int pixels[batch_size];
+    int components[batch_size];
+    int lifelines[batch_size];
+
+    updateTickScale();
+    updateLifelineTable();
+
     model->rewind();
     for(;;)
     {
-        std::auto_ptr<Event_model> e = model->next_event();
-        if (!e.get()) break;
+        int count = model->next_events(events, batch_size);
+        if (count == 0) break;
 
-        int lifeline = model->lifeline(e.get()->component);
-        if (lifeline < from_component || lifeline > to_component) continue;
+        for (int k = 0; k < count; ++k)
+        {
+            ticks[k] = events[k].time;
+            components[k] = events[k].component;
+        }
+        pixelPositionsForTicks(ticks, count, pixels);
+        lifelinesForComponents(components, count, lifelines);
 
-        int pos = pixelPositionForTime(e->time);
+        bool was_drawned = false;
+        for (int k = 0; k < count; ++k)
+        {
+            const Event_record* e = &events[k];
 
-        // Workaround a bug in tracedb -- it often
-        // returns event outside the requested time
-        // range.
-        if (pos < 0 || pos >= width)
-            continue;
+            int lifeline = lifelines[k];
+            if (lifeline < from_component || lifeline > to_component) continue;
 
-        unsigned y = lifeline_position[lifeline];
+            int pos = pixels[k];
 
-        // This is optimization. Drawing a line is much
-        // more expensive than comparing two integers and we don't
-        // ever need to draw a line on top of an already
-        // drawn one.
-        bool was_drawned = false;
-        if (pos > last_event_line[lifeline] + 2)
-        {
-            painter->save();
-            painter->setPen(QPen(Qt::black, 2));
-            painter->setRenderHint(QPainter::Antialiasing, false);
-            painter->drawLine(pos, y-text_elements_height/2-
-                              event_line_extra_height,
-                             pos, y+text_elements_height/2
-                              +event_line_extra_height);
-            painter->setRenderHint(QPainter::Antialiasing);
-            painter->restore();
-            last_event_line[lifeline] = pos;
-
-            was_drawned = true;
-        }
+            // Workaround a bug in tracedb -- it often
+            // returns event outside the requested time
+            // range.
+            if (pos < 0 || pos >= width)
+                continue;
 
-NP      tg->eventsNear[lifeline][pos] = true;
+            unsigned y = lifeline_position[lifeline];
 
-        int letter_width = mainFontLetterWidth[(unsigned char)(e->letter)];
-        int subletter_width = e->subletter ?
-            smallFontLetterWidth[(unsigned char)(e->subletter)] : 0;
+            // This is optimization. Drawing a line is much
+            // more expensive than comparing two integers and we don't
+            // ever need to draw a line on top of an already
+            // drawn one.
+            if (pos > last_event_line[lifeline] + 2)
+            {
+                painter->save();
+                painter->setPen(QPen(Qt::black, 2));
+                painter->setRenderHint(QPainter::Antialiasing, false);
+                painter->drawLine(pos, y-text_elements_height/2-
+                                  event_line_extra_height,
+                                 pos, y+text_elements_height/2
+                                  +event_line_extra_height);
+                painter->setRenderHint(QPainter::Antialiasing);
+                painter->restore();
+                last_event_line[lifeline] = pos;
 
+                was_drawned = true;
+            }
 
-        unsigned letter_x = pos;
-        unsigned letter_y = y - text_elements_height/2
-            - event_line_extra_height - event_line_and_letter_spacing;
+NP          tg->eventsNear[lifeline][pos] = true;
 
-        if (e->letter_position == Event_model::left_top
-            || e->letter_position == Event_model::left_bottom)
-        {
-            letter_x = pos - letter_width - subletter_width - 1;
-        }
+            int letter_width = mainFontLetterWidth[(unsigned char)(e->letter)];
+            int subletter_width = e->subletter ?
+                smallFontLetterWidth[(unsigned char)(e->subletter)] : 0;
 
-        if (e->letter_position == Event_model::left_bottom
-            || e->letter_position == Event_model::right_bottom)
-        {
-            letter_y = y+text_elements_height/2
-                + event_line_extra_height + event_line_and_letter_spacing
-                + mainFontAscent;
-        }
 
-        // Compute the bounding rect of this letter.
-        // Note that instead of QFontMetrics::boundingRect we use
-        // 'width', so the right boundary of rect will be the position
-        // where the next letter can be drawn.
-        QRect bound(letter_x, letter_y-mainFontDescent,
-                    letter_width + subletter_width + 1, mainFontHeight);
-
-        Event_letter_drawing drawing;
-        drawing.priority = e->priority;
-        drawing.letter = e->letter;
-        drawing.letterPosition = QPoint(letter_x, letter_y);
-        letter_x += letter_width;
-        drawing.subletter = e->subletter;
-        drawing.subletterPosition = QPoint(letter_x, letter_y);
-        drawing.boundingRect = bound;
-
-        // Now see if this letter overlaps with any previously drawn letters.
-        // The letters are stored sorted by the right boundary.
-        bool deleted = false;
-        QList<Event_letter_drawing>::iterator le;
-        le = letters_to_draw[lifeline].end();
-
-        // Note: we can't cache 'begin()' here since
-        // 'begin()' iterator does not appear to be
-        // stable, at least when all elements gets erased.
-        while(le != letters_to_draw[lifeline].begin())
-        {
-            --le;
-            if (le->boundingRect.right() <= bound.left())
-                break;
+            unsigned letter_x = pos;
+            unsigned letter_y = y - text_elements_height/2
+                - event_line_extra_height - event_line_and_letter_spacing;
 
-            if (!(le->boundingRect & bound).isEmpty())
+            if (e->letter_position == Event_model::left_top
+                || e->letter_position == Event_model::left_bottom)
             {
-                // We've got intersection. Remove either this
-                // event or the previous one.
-                if (le->priority >= e->priority)
-                {
-                    deleted = true;
-                }
-                else
-                {
-                    le = letters_to_draw[lifeline].erase(le);
-                }
+                letter_x = pos - letter_width - subletter_width - 1;
             }
-        }
 
-        if (!deleted)
-        {
-            // Must insert new letter while maintaining 'sort by right border'
-            // property.
-            QList<Event_letter_drawing>::iterator lb
-                = letters_to_draw[lifeline].begin();
+            if (e->letter_position == Event_model::left_bottom
+                || e->letter_position == Event_model::right_bottom)
+            {
+                letter_y = y+text_elements_height/2
+                    + event_line_extra_height + event_line_and_letter_spacing
+                    + mainFontAscent;
+            }
+
+            // Compute the bounding rect of this letter.
+            // Note that instead of QFontMetrics::boundingRect we use
+            // 'width', so the right boundary of rect will be the position
+            // where the next letter can be drawn.
+            QRect bound(letter_x, letter_y-mainFontDescent,
+                        letter_width + subletter_width + 1, mainFontHeight);
+
+            Event_letter_drawing drawing;
+            drawing.priority = e->priority;
+            drawing.letter = e->letter;
+            drawing.letterPosition = QPoint(letter_x, letter_y);
+            letter_x += letter_width;
+            drawing.subletter = e->subletter;
+            drawing.subletterPosition = QPoint(letter_x, letter_y);
+            drawing.boundingRect = bound;
+
+            // Now see if this letter overlaps with any previously drawn letters.
+            // The letters are stored sorted by the right boundary.
+            bool deleted = false;
+            QList<Event_letter_drawing>::iterator le;
             le = letters_to_draw[lifeline].end();
-            while(le != lb)
+
+            // Note: we can't cache 'begin()' here since
+            // 'begin()' iterator does not appear to be
+            // stable, at least when all elements gets erased.
+            while(le != letters_to_draw[lifeline].begin())
             {
                 --le;
-                if (bound.right() >= le->boundingRect.right())
-                {
-                    ++le;
+                if (le->boundingRect.right() <= bound.left())
                     break;
+
+                if (!(le->boundingRect & bound).isEmpty())
+                {
+                    // We've got intersection. Remove either this
+                    // event or the previous one.
+                    if (le->priority >= e->priority)
+                    {
+                        deleted = true;
+                    }
+                    else
+                    {
+                        le = letters_to_draw[lifeline].erase(le);
+                    }
+                }
+            }
+
+            if (!deleted)
+            {
+                // Must insert new letter while maintaining 'sort by right border'
+                // property.
+                QList<Event_letter_drawing>::iterator lb
+                    = letters_to_draw[lifeline].begin();
+                le = letters_to_draw[lifeline].end();
+                while(le != lb)
+                {
+                    --le;
+                    if (bound.right() >= le->boundingRect.right())
+                    {
+                        ++le;
+                        break;
+                    }
                 }
+                letters_to_draw[lifeline].insert(le, drawing);
             }
-            letters_to_draw[lifeline].insert(le, drawing);
         }
 
         if (!printer_flag && was_drawned) {
@@ -781,22 +869,45 @@ void Trace_painter::drawGroups(int from_comp, int to_comp)
 
     QSet< pair< pair<int, int>, pair<int, int> > > drawn;
 
+    Group_record groups[batch_size];
+    int64_t ticks[2][batch_size];
+    int pixels[2][batch_size];
+    int components[2][batch_size];
+    int lifelines[2][batch_size];
+
+    updateTickScale();
+    updateLifelineTable();
+
     model->rewind();
     for(;;)
     {
-        std::auto_ptr<Group_model> g = model->next_group();
-        if (!g.get()) break;
+        int count = model->next_groups(groups, batch_size);
+        if (count == 0) break;
 
-        if (g->type == Group_model::arrow)
+        for (int k = 0; k < count; ++k)
         {
-            int from_lifeline = model->lifeline(g->points[0].component);
-            int from_pixel = pixelPositionForTime(g->points[0].time);
-            pair<int, int> from_p(from_lifeline, from_pixel/9);
-            QPoint from(from_pixel, lifeline_position[from_lifeline]);
+            ticks[0][k] = groups[k].from_time;
+            ticks[1][k] = groups[k].to_time;
+            components[0][k] = groups[k].from_component;
+            components[1][k] = groups[k].to_component;
+        }
+        pixelPositionsForTicks(ticks[0], count, pixels[0]);
+        pixelPositionsForTicks(ticks[1], count, pixels[1]);
+        lifelinesForComponents(components[0], count, lifelines[0]);
+        lifelinesForComponents(components[1], count, lifelines[1]);
 
-            for(unsigned i = 1; i < g->points.size(); ++i)
+        for (int k = 0; k < count; ++k)
+        {
+            const Group_record* g = &groups[k];
+
+            if (g->type == Group_model::arrow)
             {
-                int to_lifeline = model->lifeline(g->points[i].component);
+                int from_lifeline = lifelines[0][k];
+                int from_pixel = pixels[0][k];
+                pair<int, int> from_p(from_lifeline, from_pixel/9);
+                QPoint from(from_pixel, lifeline_position[from_lifeline]);
+
+                int to_lifeline = lifelines[1][k];
 
                 // For composite lifelines, both endpoints of an
                 // error can end up on the same visible lifeline.
@@ -808,7 +919,7 @@ void Trace_painter::drawGroups(int from_comp, int to_comp)
                 if (((from_lifeline < (int)from_comp) || (from_lifeline > (int)to_comp)) &&
                     ((to_lifeline < (int)from_comp) || (to_lifeline > (int)to_comp))) continue;
 
-                int to_pixel = pixelPositionForTime(g->points[i].time);
+                int to_pixel = pixels[1][k];
                 pair<int, int> to_p(to_lifeline, to_pixel/9);
 
                 // See we we've drawn an arrow between those endpoints already.
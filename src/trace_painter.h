@@ -8,6 +8,8 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <stdint.h>
+
 namespace vis4 {
 
 class Trace_model;
@@ -86,6 +88,9 @@ public: /* methods */
 
     std::auto_ptr<Trace_geometry> traceGeometry() const;
 
+    /** Returns the model being drawn. */
+    const boost::shared_ptr<Trace_model>& traceModel() const { return model; }
+
 private: /* methods */
 
     /** @name Group of methods that really draw parts of trace diagram. */
@@ -96,6 +101,20 @@ private: /* methods */
     void drawGroups(int from_component, int to_component);
     //@}
 
+    /** Computes scale of pixelPositionsForTicks for the current
+        model and page. */
+    void updateTickScale();
+
+    /** Calculates x coordinates corresponding to ticks of batch
+        records. Unlike pixelPositionForTime, does no allocations. */
+    void pixelPositionsForTicks(const int64_t* ticks, int count, int* pixels) const;
+
+    /** Fills lifeline_table from the current model. */
+    void updateLifelineTable();
+
+    /** Same as Trace_model::lifeline for a batch of components. */
+    void lifelinesForComponents(const int* components, int count, int* lifelines) const;
+
     /** Calculates the number of pages, that must be printed. */
     void splitToPages();
 
@@ -175,6 +194,15 @@ private: /* members */
     common::Time timePerFullPage;
     common::Time timePerPage;                       ///< Trace scalling.
 
+    int64_t min_ticks;          ///< Ticks of the left edge of the page.
+    double pixels_per_tick;
+
+    /** Lifeline of each component link, -1 if none. */
+    std::vector<int> lifeline_table;
+
+    /** Records fetched from the model at once. */
+    static const int batch_size = 256;
+
     uint components_per_page;
 
     int width, height;                      ///< Full paper (or screen widget) size, including margins.
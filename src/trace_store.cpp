@@ -0,0 +1,847 @@
+#include "trace_store.h"
+
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+namespace vis4 {
+
+/* ------------------------------------------------------------------ */
+/* Block_ref                                                          */
+
+Block_ref::Block_ref(Block_cache* cache, void* entry)
+: cache_(cache), entry_(entry)
+{
+    cache_->pin(static_cast<Block_cache::Entry*>(entry_));
+}
+
+Block_ref::Block_ref(const Block_ref& other)
+: cache_(other.cache_), entry_(other.entry_)
+{
+    if (entry_) cache_->pin(static_cast<Block_cache::Entry*>(entry_));
+}
+
+Block_ref& Block_ref::operator=(const Block_ref& other)
+{
+    if (other.entry_) other.cache_->pin(static_cast<Block_cache::Entry*>(other.entry_));
+    release();
+    cache_ = other.cache_; entry_ = other.entry_;
+    return *this;
+}
+
+Block_ref::~Block_ref()
+{
+    release();
+}
+
+const void* Block_ref::data() const
+{
+    return entry_ ? static_cast<Block_cache::Entry*>(entry_)->data : 0;
+}
+
+void Block_ref::release()
+{
+    if (entry_) cache_->unpin(static_cast<Block_cache::Entry*>(entry_));
+    cache_ = 0; entry_ = 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Block_cache                                                        */
+
+Block_cache::Block_cache(size_t budget)
+: mutex_(QMutex::Recursive), budget_(budget), resident_(0), file_size_(0), dirty_(false),
+  spill_failed_(false), hits_(0), misses_(0), read_errors_(0)
+{
+    file_ = tmpfile();
+    if (!file_)
+    {
+        qWarning() << "trace store: can't create the spill file, keeping all blocks in memory";
+        spill_failed_ = true;
+    }
+}
+
+Block_cache::~Block_cache()
+{
+    while (!lru_.empty())
+    {
+        assert(lru_.back()->pins == 0);
+        drop(lru_.back());
+    }
+
+    if (file_) fclose(file_);
+}
+
+void Block_cache::setBudget(size_t budget)
+{
+    QMutexLocker lock(&mutex_);
+    budget_ = budget;
+    evict();
+}
+
+bool Block_cache::store(uint64_t key, const void* data, size_t bytes, uint64_t& offset)
+{
+    QMutexLocker lock(&mutex_);
+    assert(entries_.find(key) == entries_.end());
+
+    /* After a failed write the end of the file is unknown, so nothing
+       more is written. The file stays open for the blocks written
+       before, which may have been evicted. */
+    offset = file_size_;
+    bool spilled = false;
+    if (!spill_failed_)
+    {
+        if (fwrite(data, 1, bytes, file_) == bytes)
+        {
+            file_size_ += bytes;
+            dirty_ = true;
+            spilled = true;
+        }
+        else
+        {
+            qWarning() << "trace store: can't write the spill file:" << strerror(errno)
+                       << "- keeping new blocks in memory";
+            spill_failed_ = true;
+        }
+    }
+
+    Entry* e = new Entry;
+    e->key = key;
+    e->data = malloc(bytes);
+    memcpy(e->data, data, bytes);
+    e->mapping = 0; e->mapping_size = 0;
+    e->bytes = bytes;
+    e->pins = 0;
+    e->spilled = spilled;
+
+    lru_.push_front(e);
+    e->lru = lru_.begin();
+    entries_[key] = e;
+    resident_ += bytes;
+
+    evict();
+    return spilled;
+}
+
+Block_ref Block_cache::fetch(uint64_t key, uint64_t offset, size_t bytes)
+{
+    QMutexLocker lock(&mutex_);
+    std::map<uint64_t, Entry*>::iterator i = entries_.find(key);
+    if (i != entries_.end())
+    {
+        ++hits_;
+        Entry* e = i->second;
+        lru_.splice(lru_.begin(), lru_, e->lru);
+        return Block_ref(this, e);
+    }
+
+    ++misses_;
+
+    /* Only spilled blocks are evicted, so the file is there. */
+    if (dirty_)
+    {
+        fflush(file_);
+        dirty_ = false;
+    }
+
+    Entry* e = new Entry;
+    e->key = key;
+    e->bytes = bytes;
+    e->pins = 0;
+    e->spilled = true;
+
+    /* Mapping must start at the page boundary. */
+    static const uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t aligned = offset - offset % page;
+    size_t shift = (size_t)(offset - aligned);
+
+    void* mapping = mmap(0, bytes + shift, PROT_READ, MAP_PRIVATE,
+                         fileno(file_), (off_t)aligned);
+    if (mapping != MAP_FAILED)
+    {
+        e->mapping = mapping;
+        e->mapping_size = bytes + shift;
+        e->data = static_cast<char*>(mapping) + shift;
+    }
+    else if (!read(e, offset))
+    {
+        /* Readers get zeroed records rather than a crash. The entry is
+           evicted as usual, so the block is read again later. */
+        qWarning() << "trace store: can't read a block back from the spill file:"
+                   << strerror(errno);
+        ++read_errors_;
+        memset(e->data, 0, bytes);
+    }
+
+    lru_.push_front(e);
+    e->lru = lru_.begin();
+    entries_[key] = e;
+    resident_ += bytes;
+
+    Block_ref result(this, e);
+    evict();
+    return result;
+}
+
+bool Block_cache::read(Entry* e, uint64_t offset)
+{
+    e->mapping = 0;
+    e->mapping_size = 0;
+    e->data = malloc(e->bytes);
+
+    size_t done = 0;
+    while (done < e->bytes)
+    {
+        ssize_t n = pread(fileno(file_), static_cast<char*>(e->data) + done,
+                          e->bytes - done, (off_t)(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+void Block_cache::pin(Entry* e)
+{
+    QMutexLocker lock(&mutex_);
+    ++e->pins;
+}
+
+void Block_cache::unpin(Entry* e)
+{
+    QMutexLocker lock(&mutex_);
+    assert(e->pins > 0);
+    if (--e->pins == 0 && resident_ > budget_)
+        evict();
+}
+
+void Block_cache::evict()
+{
+    /* Blocks not in the spill file can't be read back. */
+    std::list<Entry*>::iterator i = lru_.end();
+    while (resident_ > budget_ && i != lru_.begin())
+    {
+        Entry* e = *--i;
+        if (e->pins || !e->spilled) continue;
+
+        if (e->mapping == 0 && dirty_)
+        {
+            /* Heap entry -- make sure its data reached the file. */
+            fflush(file_);
+            dirty_ = false;
+        }
+
+        ++i;
+        drop(e);
+    }
+}
+
+void Block_cache::drop(Entry* e)
+{
+    if (e->mapping)
+        munmap(e->mapping, e->mapping_size);
+    else
+        free(e->data);
+
+    resident_ -= e->bytes;
+    entries_.erase(e->key);
+    lru_.erase(e->lru);
+    delete e;
+}
+
+/* ------------------------------------------------------------------ */
+/* Lod_pyramid                                                        */
+
+void Lod_pyramid::reset(int capacity)
+{
+    Lod_bin empty = { 0, 0, 0, no_function, 0, 0 };
+
+    levels_.clear();
+    for (int size = capacity; size > 0; size /= 2)
+        levels_.push_back(std::vector<Lod_bin>(size, empty));
+
+    dirty_ = false;
+}
+
+void Lod_pyramid::merge(Lod_bin& to, const Lod_bin& from)
+{
+    to.sends += from.sends;
+    to.receives += from.receives;
+    to.markers += from.markers;
+    to.busy_time += from.busy_time;
+
+    if (from.dominant_time > to.dominant_time)
+    {
+        to.dominant = from.dominant;
+        to.dominant_time = from.dominant_time;
+    }
+}
+
+void Lod_pyramid::rebuild()
+{
+    if (!dirty_) return;
+
+    for (unsigned l = 1; l < levels_.size(); ++l)
+    {
+        std::vector<Lod_bin>& prev = levels_[l-1];
+        std::vector<Lod_bin>& cur = levels_[l];
+
+        for (unsigned i = 0; i < cur.size(); ++i)
+        {
+            cur[i] = prev[2*i];
+            merge(cur[i], prev[2*i+1]);
+        }
+    }
+
+    dirty_ = false;
+}
+
+/* ------------------------------------------------------------------ */
+/* Trace_store                                                        */
+
+const int Trace_store::block_capacity;
+const int Trace_store::max_open_publishes;
+const int Trace_store::min_lod_capacity;
+
+bool Trace_store::Message_key::operator<(const Message_key& o) const
+{
+    if (sender != o.sender) return sender < o.sender;
+    if (receiver != o.receiver) return receiver < o.receiver;
+    if (group != o.group) return group < o.group;
+    return tag < o.tag;
+}
+
+Trace_store::Trace_store(size_t memory_budget, int lod_capacity)
+: min_time_(~(uint64_t)0), max_time_(0), lod_initialized_(false),
+  cache_(memory_budget)
+{
+    /* Capacity must be a power of two for the pyramid levels. */
+    int capacity = 1;
+    while (capacity < lod_capacity) capacity *= 2;
+
+    lod_geometry_.origin = 0;
+    lod_geometry_.width = 1;
+    lod_geometry_.capacity = capacity;
+}
+
+Trace_store::~Trace_store()
+{
+}
+
+int Trace_store::addLifeline(uint32_t process)
+{
+    Process_map::iterator i = process_map_.find(process);
+    if (i != process_map_.end())
+        return i->second;
+
+    int lifeline = (int)lifelines_.size();
+    lifelines_.push_back(Lifeline_data());
+    lifelines_.back().process = process;
+    lifelines_.back().lod.reset(lod_geometry_.capacity);
+
+    process_map_[process] = lifeline;
+    boundLod();
+    return lifeline;
+}
+
+int Trace_store::lifeline(uint32_t process) const
+{
+    Process_map::const_iterator i = process_map_.find(process);
+    return (i != process_map_.end()) ? i->second : -1;
+}
+
+int Trace_store::lifelineFor(uint32_t process)
+{
+    Process_map::iterator i = process_map_.find(process);
+    return (i != process_map_.end()) ? i->second : addLifeline(process);
+}
+
+void Trace_store::addEnter(uint64_t time, uint32_t function, uint32_t process)
+{
+    int l = lifelineFor(process);
+    updateTimeRange(time);
+
+    Frame frame = { time, function, 0, lifelines_[l].open_calls[function]++ > 0 };
+    lifelines_[l].stack.push_back(frame);
+}
+
+void Trace_store::addLeave(uint64_t time, uint32_t function, uint32_t process)
+{
+    int l = lifelineFor(process);
+    updateTimeRange(time);
+
+    std::vector<Frame>& stack = lifelines_[l].stack;
+
+    /* Function 0 means the last entered one. Unmatched leaves are
+       ignored, frames left open by missing leaves are closed. */
+    if (function != 0)
+    {
+        int depth = (int)stack.size() - 1;
+        while (depth >= 0 && stack[depth].function != function) --depth;
+        if (depth < 0) return;
+    }
+
+    while (!stack.empty())
+    {
+        Frame frame = stack.back();
+        stack.pop_back();
+        --lifelines_[l].open_calls[frame.function];
+
+        State_entry state = { frame.time, time, process, frame.function,
+                              (uint16_t)std::min<size_t>(stack.size(), 0xFFFF),
+                              (uint16_t)(frame.recursive ? recursive_call : 0),
+                              stack.empty() ? no_function : stack.back().function };
+
+        uint64_t duration = state.end - state.begin;
+        uint64_t children = std::min(frame.children_time, duration);
+        double exclusive = duration ? double(duration - children) / duration : 1.0;
+
+        if (!stack.empty())
+            stack.back().children_time += duration;
+
+        append(l, states_series, &state, sizeof(state), state.begin, state.end);
+        lodState(l, state, exclusive);
+
+        if (function == 0 || frame.function == function) break;
+    }
+}
+
+void Trace_store::addSend(uint64_t time, uint32_t sender, uint32_t receiver,
+                          uint32_t group, uint32_t tag, uint32_t length)
+{
+    int l = lifelineFor(sender);
+    updateTimeRange(time);
+
+    Event_entry event = { time, sender, send_event, receiver, tag, length, 0 };
+    append(l, events_series, &event, sizeof(event), time, time);
+    lodEvent(l, time, send_event);
+
+    Message_key key = { sender, receiver, group, tag };
+    Pending_message pending = { time, length };
+    std::deque<Pending_message>* recvs = takePending(pending_receives_, key);
+    if (!recvs)
+    {
+        pending_sends_[key].push_back(pending);
+        return;
+    }
+
+    Pending_message recv = recvs->front();
+    recvs->pop_front();
+    addMessage(key, pending, recv);
+    if (recvs->empty())
+        pending_receives_.erase(key);
+}
+
+void Trace_store::addReceive(uint64_t time, uint32_t receiver, uint32_t sender,
+                             uint32_t group, uint32_t tag, uint32_t length)
+{
+    int l = lifelineFor(receiver);
+    updateTimeRange(time);
+
+    Event_entry event = { time, receiver, receive_event, sender, tag, length, 0 };
+    append(l, events_series, &event, sizeof(event), time, time);
+    lodEvent(l, time, receive_event);
+
+    Message_key key = { sender, receiver, group, tag };
+    Pending_message pending = { time, length };
+    std::deque<Pending_message>* sends = takePending(pending_sends_, key);
+    if (!sends)
+    {
+        pending_receives_[key].push_back(pending);
+        return;
+    }
+
+    Pending_message send = sends->front();
+    sends->pop_front();
+    addMessage(key, send, pending);
+    if (sends->empty())
+        pending_sends_.erase(key);
+}
+
+std::deque<Trace_store::Pending_message>*
+Trace_store::takePending(Pending_map& pending, const Message_key& key)
+{
+    Pending_map::iterator i = pending.find(key);
+    return (i != pending.end()) ? &i->second : 0;
+}
+
+void Trace_store::addMessage(const Message_key& key, const Pending_message& send,
+                             const Pending_message& recv)
+{
+    Message_entry message = { send.time, recv.time, key.sender, key.receiver,
+                              key.tag, send.length, key.group,
+                              (uint32_t)lifelineFor(key.receiver) };
+    append(lifelineFor(key.sender), messages_series, &message, sizeof(message),
+           send.time, recv.time);
+}
+
+void Trace_store::addMarker(uint64_t time, uint32_t process, uint32_t token)
+{
+    int l = lifelineFor(process);
+    updateTimeRange(time);
+
+    Event_entry event = { time, process, marker_event, 0, token, 0, 0 };
+    append(l, markers_series, &event, sizeof(event), time, time);
+    lodEvent(l, time, marker_event);
+}
+
+void Trace_store::flush()
+{
+    for (unsigned l = 0; l < lifelines_.size(); ++l)
+    {
+        for (int s = 0; s < series_count; ++s)
+            seal(l, (Series)s, recordSize((Series)s));
+
+        publishStack(l);
+        lifelines_[l].lod.rebuild();
+    }
+}
+
+void Trace_store::publish()
+{
+    for (unsigned l = 0; l < lifelines_.size(); ++l)
+    {
+        for (int s = 0; s < series_count; ++s)
+        {
+            Series_data& d = lifelines_[l].series[s];
+            if (d.open_count == 0) continue;
+
+            if (d.open_count == d.open_published
+                || ++d.open_publishes >= max_open_publishes)
+                seal(l, (Series)s, recordSize((Series)s));
+            else
+                d.open_published = d.open_count;
+        }
+
+        publishStack(l);
+        lifelines_[l].lod.rebuild();
+    }
+}
+
+Block_ref Trace_store::fetch(int lifeline, Series series, int block)
+{
+    const Block& b = lifelines_[lifeline].series[series].blocks[block];
+    return cache_.fetch(blockKey(lifeline, series, block), b.offset,
+                        b.count * recordSize(series));
+}
+
+Block_ref Trace_store::fetch(int lifeline, Series series, int block, const Block& descriptor)
+{
+    return cache_.fetch(blockKey(lifeline, series, block), descriptor.offset,
+                        descriptor.count * recordSize(series));
+}
+
+void Trace_store::append(int lifeline, Series series, const void* record,
+                         size_t size, uint64_t begin, uint64_t end)
+{
+    Series_data& s = lifelines_[lifeline].series[series];
+
+    if (s.open.empty())
+        s.open.resize(block_capacity * size);
+
+    if (s.open_count == 0)
+    {
+        s.open_begin = begin; s.open_end = end;
+    }
+    else
+    {
+        s.open_begin = std::min(s.open_begin, begin);
+        s.open_end = std::max(s.open_end, end);
+    }
+
+    memcpy(&s.open[s.open_count * size], record, size);
+    if (++s.open_count == (uint32_t)block_capacity)
+        seal(lifeline, series, size);
+}
+
+namespace {
+
+bool state_less(const State_entry& a, const State_entry& b)
+{
+    return a.begin < b.begin || (a.begin == b.begin && a.depth < b.depth);
+}
+
+bool message_less(const Message_entry& a, const Message_entry& b)
+{
+    return a.send_time < b.send_time;
+}
+
+}
+
+void Trace_store::seal(int lifeline, Series series, size_t size)
+{
+    Series_data& s = lifelines_[lifeline].series[series];
+    if (s.open_count == 0)
+        return;
+
+    /* States come in the order of leaves and messages in the order
+       of receives; readers expect the order of begin times. */
+    if (series == states_series)
+    {
+        State_entry* records = reinterpret_cast<State_entry*>(&s.open[0]);
+        std::sort(records, records + s.open_count, state_less);
+    }
+    else if (series == messages_series)
+    {
+        Message_entry* records = reinterpret_cast<Message_entry*>(&s.open[0]);
+        std::sort(records, records + s.open_count, message_less);
+    }
+
+    Block b;
+    b.begin = s.open_begin;
+    b.end = s.open_end;
+    b.count = s.open_count;
+    cache_.store(blockKey(lifeline, series, (int)s.blocks.size()),
+                 &s.open[0], s.open_count * size, b.offset);
+    s.blocks.push_back(b);
+
+    s.summaries.push_back(Block_summary());
+    summarize(series, &s.open[0], s.open_count, s.summaries.back());
+
+    s.open_count = 0;
+    s.open_published = 0;
+    s.open_publishes = 0;
+}
+
+void Trace_store::publishStack(int lifeline)
+{
+    Lifeline_data& d = lifelines_[lifeline];
+    d.open_states.clear();
+    for (unsigned i = 0; i < d.stack.size(); ++i)
+    {
+        const Frame& frame = d.stack[i];
+        State_entry state = { frame.time, max_time_, d.process, frame.function,
+                              (uint16_t)std::min<unsigned>(i, 0xFFFF),
+                              (uint16_t)(frame.recursive ? recursive_call : 0),
+                              i ? d.stack[i - 1].function : no_function };
+        d.open_states.push_back(state);
+    }
+}
+
+void Trace_store::summarize(Series series, const void* records, uint32_t count,
+                            Block_summary& summary)
+{
+    summary.first = summary.last = 0;
+    std::fill(summary.kinds, summary.kinds + event_kinds_count, 0);
+    summary.bytes = 0;
+
+    if (series == states_series)
+    {
+        /* Records are sorted by begin, so the first call of each
+           function is met first. */
+        const State_entry* states = static_cast<const State_entry*>(records);
+        summary.first = states[0].begin;
+        summary.last = states[count - 1].begin;
+
+        std::map<uint32_t, Function_summary> functions;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const State_entry& state = states[i];
+            uint64_t duration = state.end - state.begin;
+
+            std::map<uint32_t, Function_summary>::iterator f = functions.find(state.function);
+            if (f == functions.end())
+            {
+                Function_summary empty = { state.function, 0, state.begin, state.begin, 0, 0 };
+                f = functions.insert(std::make_pair(state.function, empty)).first;
+            }
+            else if (f->second.calls == 0)
+                f->second.first = state.begin;
+
+            ++f->second.calls;
+            f->second.last = state.begin;
+            if (!(state.flags & recursive_call))
+                f->second.inclusive += duration;
+            f->second.exclusive += duration;
+
+            if (state.caller != no_function)
+            {
+                Function_summary empty = { state.caller, 0, 0, 0, 0, 0 };
+                functions.insert(std::make_pair(state.caller, empty)).first
+                    ->second.exclusive -= duration;
+            }
+        }
+
+        summary.functions.reserve(functions.size());
+        std::map<uint32_t, Function_summary>::const_iterator f;
+        for (f = functions.begin(); f != functions.end(); ++f)
+            summary.functions.push_back(f->second);
+    }
+    else if (series == messages_series)
+    {
+        const Message_entry* messages = static_cast<const Message_entry*>(records);
+        summary.first = messages[0].send_time;
+        summary.last = messages[count - 1].send_time;
+        for (uint32_t i = 0; i < count; ++i)
+            summary.bytes += messages[i].length;
+    }
+    else
+    {
+        const Event_entry* events = static_cast<const Event_entry*>(records);
+        summary.first = events[0].time;
+        summary.last = events[count - 1].time;
+        for (uint32_t i = 0; i < count; ++i)
+            ++summary.kinds[events[i].kind];
+    }
+}
+
+void Trace_store::updateTimeRange(uint64_t time)
+{
+    min_time_ = std::min(min_time_, time);
+    max_time_ = std::max(max_time_, time);
+    ensureLodCovers(time);
+}
+
+void Trace_store::ensureLodCovers(uint64_t time)
+{
+    Lod_geometry& g = lod_geometry_;
+
+    if (!lod_initialized_)
+    {
+        g.origin = time;
+        g.width = 1;
+        lod_initialized_ = true;
+        return;
+    }
+
+    uint64_t end = g.origin + g.width * g.capacity;
+    if (time >= g.origin && time < end)
+        return;
+
+    /* Double the bin width until the whole range fits. The origin
+       is kept aligned to the width, so old bins nest in the new ones. */
+    uint64_t low = std::min(time, g.origin);
+    uint64_t high = std::max(time + 1, end);
+
+    Lod_geometry n = g;
+    do
+    {
+        n.width *= 2;
+        n.origin = low - low % n.width;
+    }
+    while (n.origin + n.width * n.capacity < high);
+
+    rebinLod(n);
+}
+
+void Trace_store::boundLod()
+{
+    /* Level 0 and the levels above hold 2*capacity - 1 bins. */
+    size_t limit = cache_.budget() / 4;
+    Lod_geometry g = lod_geometry_;
+    while (g.capacity > min_lod_capacity
+           && lifelines_.size() * (2 * g.capacity - 1) * sizeof(Lod_bin) > limit)
+    {
+        /* Pairs of bins are merged, the range stays the same. */
+        g.capacity /= 2;
+        g.width *= 2;
+    }
+
+    if (g.capacity != lod_geometry_.capacity)
+        rebinLod(g);
+}
+
+void Trace_store::rebinLod(const Lod_geometry& geometry)
+{
+    const Lod_geometry& old = lod_geometry_;
+    Lod_bin empty = { 0, 0, 0, no_function, 0, 0 };
+
+    for (unsigned l = 0; l < lifelines_.size(); ++l)
+    {
+        Lod_pyramid& lod = lifelines_[l].lod;
+        std::vector<Lod_bin> rebinned(geometry.capacity, empty);
+
+        for (int i = 0; i < old.capacity; ++i)
+        {
+            uint64_t start = old.origin + i * old.width;
+            int j = (int)((start - geometry.origin) / geometry.width);
+            if (j < geometry.capacity)
+                Lod_pyramid::merge(rebinned[j], lod.levels_[0][i]);
+        }
+
+        if (geometry.capacity != old.capacity)
+            lod.reset(geometry.capacity);
+        lod.levels_[0].swap(rebinned);
+        lod.dirty_ = true;
+    }
+
+    lod_geometry_ = geometry;
+}
+
+int Trace_store::lodBin(uint64_t time) const
+{
+    const Lod_geometry& g = lod_geometry_;
+    if (time <= g.origin) return 0;
+
+    uint64_t bin = (time - g.origin) / g.width;
+    return bin < (uint64_t)g.capacity ? (int)bin : g.capacity - 1;
+}
+
+void Trace_store::lodEvent(int lifeline, uint64_t time, uint32_t kind)
+{
+    Lod_pyramid& lod = lifelines_[lifeline].lod;
+    Lod_bin& bin = lod.bin(lodBin(time));
+
+    switch (kind)
+    {
+        case send_event: ++bin.sends; break;
+        case receive_event: ++bin.receives; break;
+        default: ++bin.markers; break;
+    }
+    lod.dirty_ = true;
+}
+
+void Trace_store::lodState(int lifeline, const State_entry& state, double exclusive)
+{
+    /* Bins are attributed the exclusive share of the call, so outer
+       calls like main() don't hide the functions that did the work. */
+    const Lod_geometry& g = lod_geometry_;
+    Lod_pyramid& lod = lifelines_[lifeline].lod;
+
+    int first = lodBin(state.begin), last = lodBin(state.end);
+    for (int i = first; i <= last; ++i)
+    {
+        uint64_t bin_begin = g.origin + i * g.width;
+        uint64_t bin_end = bin_begin + g.width;
+        uint64_t begin = std::max(bin_begin, state.begin);
+        uint64_t end = std::min(bin_end, state.end);
+        if (end <= begin) continue;
+
+        Lod_bin& bin = lod.bin(i);
+        uint64_t weight = (uint64_t)((end - begin) * exclusive);
+
+        if (state.depth == 0)
+            bin.busy_time += end - begin;
+
+        if (weight > bin.dominant_time || bin.dominant == no_function)
+        {
+            bin.dominant = state.function;
+            bin.dominant_time = weight;
+        }
+    }
+    lod.dirty_ = true;
+}
+
+uint64_t Trace_store::blockKey(int lifeline, Series series, int block)
+{
+    return ((uint64_t)lifeline << 34) | ((uint64_t)series << 32) | (uint32_t)block;
+}
+
+size_t Trace_store::recordSize(Series series)
+{
+    switch (series)
+    {
+        case events_series:
+        case markers_series: return sizeof(Event_entry);
+        case states_series: return sizeof(State_entry);
+        default: return sizeof(Message_entry);
+    }
+}
+
+}
@@ -0,0 +1,578 @@
+#ifndef TRACE_STORE_HPP
+#define TRACE_STORE_HPP
+
+#include <QMutex>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <vector>
+#include <map>
+#include <deque>
+#include <list>
+
+namespace vis4 {
+
+/** Kinds of the events kept in the store. The values are also used
+    as links in the event selection of OTF_trace_model. */
+enum Event_kind { send_event = 0, receive_event, marker_event, event_kinds_count };
+
+/** Function value used for bins and states without a function. */
+const uint32_t no_function = 0xFFFFFFFF;
+
+/** Point event of one process. */
+struct Event_entry
+{
+    uint64_t time;
+    uint32_t process;
+    uint32_t kind;      ///< Event_kind
+    uint32_t peer;      ///< Partner process for messages, 0 for markers.
+    uint32_t tag;       ///< Message tag or marker token.
+    uint32_t length;    ///< Message length in bytes.
+    uint32_t reserved;
+};
+
+/** Function call of one process, reconstructed from Enter/Leave pair. */
+struct State_entry
+{
+    uint64_t begin;
+    uint64_t end;
+    uint32_t process;
+    uint32_t function;
+    uint16_t depth;     ///< Nesting level, 0 for the top-level calls, at most 65535.
+    uint16_t flags;     ///< State_flag values.
+    uint32_t caller;    ///< Function of the enclosing call, or no_function.
+};
+
+enum State_flag
+{
+    /** The call is nested in another call of the same function. */
+    recursive_call = 1
+};
+
+/** Matched Send/Receive pair. Stored on the lifeline of the sender. */
+struct Message_entry
+{
+    uint64_t send_time;
+    uint64_t recv_time;
+    uint32_t sender;
+    uint32_t receiver;
+    uint32_t tag;
+    uint32_t length;
+    uint32_t group;
+
+    /** Lifeline of the receiver, so readers in other threads don't
+        look up the process while lifelines are being added. */
+    uint32_t receiver_lifeline;
+};
+
+/** Summary of a time bin of one lifeline. */
+struct Lod_bin
+{
+    uint32_t sends;
+    uint32_t receives;
+    uint32_t markers;
+    uint32_t dominant;          ///< Function of the longest state overlapping the bin.
+    uint64_t dominant_time;     ///< Part of the bin covered by that state.
+    uint64_t busy_time;         ///< Part of the bin covered by top-level states.
+};
+
+class Block_cache;
+
+/** Pinned reference to the data of a sealed block.
+    While at least one reference exists the block can't be
+    evicted from the cache. */
+class Block_ref
+{
+public:
+    Block_ref() : cache_(0), entry_(0) {}
+    Block_ref(const Block_ref& other);
+    Block_ref& operator=(const Block_ref& other);
+    ~Block_ref();
+
+    const void* data() const;
+    bool isNull() const { return entry_ == 0; }
+
+private:
+    Block_ref(Block_cache* cache, void* entry);
+    void release();
+
+    Block_cache* cache_;
+    void* entry_;
+
+    friend class Block_cache;
+};
+
+/** LRU cache of sealed blocks.
+
+    Blocks are stored in the spill file and mapped into memory
+    on demand. Total size of the mapped blocks is kept under the
+    memory budget; least recently used unpinned blocks are unmapped
+    first. If all blocks are pinned, the budget is exceeded temporarily.
+
+    If the spill file can't be written, later blocks are kept in
+    memory and never evicted, whatever the budget. Blocks written
+    before stay in the file and are mapped as usual.
+
+    The cache may be used from several threads at once. */
+class Block_cache
+{
+public:
+    Block_cache(size_t budget);
+    ~Block_cache();
+
+    void setBudget(size_t budget);
+    size_t budget() const { return budget_; }
+
+    /** Returns bytes currently held by the cache. */
+    size_t residentBytes() const { return resident_; }
+
+    /** Appends block data to the spill file and sets offset to its
+        position. The data stays resident as the most recently used
+        entry. Returns false if the data could not be written, so the
+        block is held in memory for good. */
+    bool store(uint64_t key, const void* data, size_t bytes, uint64_t& offset);
+
+    /** Returns pinned block, mapping it from the spill file if needed.
+        If the block can't be read back, it is filled with zeros and
+        counted in readErrors(). */
+    Block_ref fetch(uint64_t key, uint64_t offset, size_t bytes);
+
+    /** Returns true if a write to the spill file has failed. */
+    bool spillFailed() const { return spill_failed_; }
+
+    /** @name Statistics. */
+    //@{
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    uint64_t spilledBytes() const { return file_size_; }
+    uint64_t readErrors() const { return read_errors_; }
+    //@}
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        void* data;         ///< Start of the block data.
+        void* mapping;      ///< Start of the mapping, 0 for heap entries.
+        size_t mapping_size;
+        size_t bytes;
+        int pins;
+        bool spilled;       ///< Data is in the spill file.
+        std::list<Entry*>::iterator lru;
+    };
+
+    void pin(Entry* e);
+    void unpin(Entry* e);
+    void evict();
+    void drop(Entry* e);
+
+    /** Reads the block into a heap entry, for when it can't be
+        mapped. Returns false if it can't be read either. */
+    bool read(Entry* e, uint64_t offset);
+
+    /** Recursive, since fetch pins the entry it returns. */
+    QMutex mutex_;
+
+    size_t budget_;
+    size_t resident_;
+
+    FILE* file_;
+    uint64_t file_size_;
+    bool dirty_;
+    bool spill_failed_;
+
+    std::map<uint64_t, Entry*> entries_;
+    std::list<Entry*> lru_;     ///< Front is the most recently used.
+
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t read_errors_;
+
+    friend class Block_ref;
+
+private:
+    Block_cache(const Block_cache&);
+    Block_cache& operator=(const Block_cache&);
+};
+
+/** Level-of-detail pyramid of one lifeline.
+
+    Level 0 has Lod_geometry::capacity bins of Lod_geometry::width ticks,
+    each next level merges pairs of bins of the previous one. The
+    pyramid is always resident, so zoomed out views never touch the
+    blocks. The pyramids of all lifelines take at most a quarter of
+    the memory budget: as lifelines are added, the number of bins is
+    halved, down to Trace_store::min_lod_capacity. */
+class Lod_pyramid
+{
+public:
+    Lod_pyramid() : dirty_(false) {}
+
+    int levels() const { return (int)levels_.size(); }
+    const std::vector<Lod_bin>& level(int l) const { return levels_[l]; }
+
+private:
+    void reset(int capacity);
+    Lod_bin& bin(int index) { return levels_[0][index]; }
+    void rebuild();
+
+    static void merge(Lod_bin& to, const Lod_bin& from);
+
+    std::vector< std::vector<Lod_bin> > levels_;
+    bool dirty_;
+
+    friend class Trace_store;
+};
+
+/** Chunked out-of-core storage of the trace records.
+
+    Records of every lifeline (process) are kept in four series --
+    events, states, messages and markers. Each series is split into blocks of
+    at most block_capacity records. Sealed blocks are written to the
+    spill file and paged in on demand through Block_cache, so only the
+    block index with the block summaries and the LOD pyramids must fit
+    into memory. The pyramids
+    are bounded by the budget, except with more than about budget/16 KB
+    lifelines, where even the smallest ones exceed it.
+
+    Readers see only sealed blocks. flush() seals all partially
+    filled blocks and must be called before the data is shown; while
+    records keep coming, publish() seals only the blocks that stopped
+    growing, so frequent refreshes don't cut the series into small
+    blocks. */
+class Trace_store
+{
+public: /* types */
+
+    /** Markers are kept apart from the other events, since OTF
+        delivers them after all event records. */
+    enum Series { events_series = 0, states_series, messages_series, markers_series,
+                  series_count };
+
+    /** Descriptor of a sealed block. begin and end cover all records
+        in the block, so blocks of one series may overlap in time. */
+    struct Block
+    {
+        uint64_t begin;
+        uint64_t end;
+        uint64_t offset;
+        uint32_t count;
+    };
+
+    /** Time spent in one function by the calls of a block. */
+    struct Function_summary
+    {
+        uint32_t function;
+        uint32_t calls;
+        uint64_t first;         ///< Begin of the first call.
+        uint64_t last;          ///< Begin of the last call.
+        uint64_t inclusive;     ///< Duration of the calls, except recursive ones.
+
+        /** Duration of the calls less the duration of the calls of
+            the block made directly from the function. Calls leave
+            before their callers, which may be in a later block, so a
+            function may have an entry without calls and a negative
+            time. */
+        int64_t exclusive;
+    };
+
+    /** Counts of the records of a sealed block, so readers skip
+        blocks without fetching them. */
+    struct Block_summary
+    {
+        /** Times of the first and the last record: event times, call
+            begins or send times. */
+        uint64_t first;
+        uint64_t last;
+
+        uint32_t kinds[event_kinds_count];  ///< Events of each kind.
+        uint64_t bytes;                     ///< Bytes of the messages.
+
+        std::vector<Function_summary> functions;    ///< Sorted by function.
+    };
+
+    /** Common geometry of all LOD pyramids. */
+    struct Lod_geometry
+    {
+        uint64_t origin;
+        uint64_t width;     ///< Width of the level 0 bin, in ticks.
+        int capacity;       ///< Number of level 0 bins.
+    };
+
+    static const int block_capacity = 4096;
+
+    /** Number of publish() calls a growing block may stay open. */
+    static const int max_open_publishes = 8;
+
+    /** Smallest number of level 0 bins of the LOD pyramids. */
+    static const int min_lod_capacity = 64;
+
+    typedef std::map<uint32_t, int> Process_map;
+
+public: /* methods */
+
+    Trace_store(size_t memory_budget, int lod_capacity = 1024);
+    ~Trace_store();
+
+    /** @name Building the store. Records of each process must come
+        in the order of increasing time, records of different processes
+        may be interleaved arbitrarily. */
+    //@{
+    int addLifeline(uint32_t process);
+
+    void addEnter(uint64_t time, uint32_t function, uint32_t process);
+    void addLeave(uint64_t time, uint32_t function, uint32_t process);
+    void addSend(uint64_t time, uint32_t sender, uint32_t receiver,
+                 uint32_t group, uint32_t tag, uint32_t length);
+    void addReceive(uint64_t time, uint32_t receiver, uint32_t sender,
+                    uint32_t group, uint32_t tag, uint32_t length);
+    void addMarker(uint64_t time, uint32_t process, uint32_t token);
+
+    /** Seals all partially filled blocks and updates the LOD pyramids. */
+    void flush();
+
+    /** Seals the partially filled blocks that got no records since
+        the previous call, or were open for max_open_publishes calls,
+        and updates the LOD pyramids. */
+    void publish();
+
+    /** Returns true if some blocks could not be spilled and are held
+        in memory, over the budget. */
+    bool spillFailed() const { return cache_.spillFailed(); }
+    //@}
+
+    /** @name Access to the stored data. */
+    //@{
+    int lifelinesCount() const { return (int)lifelines_.size(); }
+
+    /** Returns lifeline index for process, or -1. */
+    int lifeline(uint32_t process) const;
+    uint32_t process(int lifeline) const { return lifelines_[lifeline].process; }
+
+    bool isEmpty() const { return min_time_ > max_time_; }
+    uint64_t minTime() const { return isEmpty() ? 0 : min_time_; }
+    uint64_t maxTime() const { return isEmpty() ? 0 : max_time_; }
+
+    const std::vector<Block>& blocks(int lifeline, Series series) const
+    { return lifelines_[lifeline].series[series].blocks; }
+
+    /** Calls not left at the last publish() or flush(), outermost
+        first, as if they ended at maxTime() of then. */
+    const std::vector<State_entry>& openStates(int lifeline) const
+    { return lifelines_[lifeline].open_states; }
+
+    /** Summaries of the sealed blocks, in the order of blocks(). */
+    const std::vector<Block_summary>& summaries(int lifeline, Series series) const
+    { return lifelines_[lifeline].series[series].summaries; }
+
+    /** Returns pinned data of the sealed block. */
+    Block_ref fetch(int lifeline, Series series, int block);
+
+    /** Same, for a copy of the block descriptor. Does not look into
+        the block index, so unlike the other methods it may be called
+        from other threads while the store is being built. */
+    Block_ref fetch(int lifeline, Series series, int block, const Block& descriptor);
+
+    const Lod_geometry& lodGeometry() const { return lod_geometry_; }
+    const Lod_pyramid& lod(int lifeline) const { return lifelines_[lifeline].lod; }
+
+    Block_cache& cache() { return cache_; }
+    //@}
+
+private: /* types */
+
+    struct Series_data
+    {
+        Series_data() : open_count(0), open_begin(0), open_end(0),
+                        open_published(0), open_publishes(0) {}
+
+        std::vector<Block> blocks;
+        std::vector<Block_summary> summaries;
+        std::vector<char> open;     ///< Records of the block being filled.
+        uint32_t open_count;
+        uint64_t open_begin;
+        uint64_t open_end;
+
+        uint32_t open_published;    ///< open_count at the last publish().
+        int open_publishes;         ///< publish() calls the block was open.
+    };
+
+    struct Frame
+    {
+        uint64_t time;
+        uint32_t function;
+        uint64_t children_time;     ///< Total duration of the nested calls.
+        bool recursive;             ///< Function is called by an enclosing frame.
+    };
+
+    struct Lifeline_data
+    {
+        uint32_t process;
+        Series_data series[series_count];
+        std::vector<Frame> stack;
+        std::map<uint32_t, int> open_calls;     ///< Frames of each function.
+        std::vector<State_entry> open_states;   ///< Stack at the last publish().
+        Lod_pyramid lod;
+    };
+
+    /** Key used to match sends with receives. */
+    struct Message_key
+    {
+        uint32_t sender, receiver, group, tag;
+        bool operator<(const Message_key& o) const;
+    };
+
+    struct Pending_message
+    {
+        uint64_t time;
+        uint32_t length;
+    };
+
+    typedef std::map<Message_key, std::deque<Pending_message> > Pending_map;
+
+private: /* methods */
+
+    int lifelineFor(uint32_t process);
+    void append(int lifeline, Series series, const void* record,
+                size_t size, uint64_t begin, uint64_t end);
+    void seal(int lifeline, Series series, size_t size);
+    void publishStack(int lifeline);
+    static void summarize(Series series, const void* records, uint32_t count,
+                          Block_summary& summary);
+    void updateTimeRange(uint64_t time);
+
+    static std::deque<Pending_message>* takePending(Pending_map& pending,
+                                                    const Message_key& key);
+    void addMessage(const Message_key& key, const Pending_message& send,
+                    const Pending_message& recv);
+
+    /** @name LOD maintenance. */
+    //@{
+    void ensureLodCovers(uint64_t time);
+
+    /** Halves the bins of the pyramids while they take more than a
+        quarter of the budget. */
+    void boundLod();
+    void rebinLod(const Lod_geometry& geometry);
+    int lodBin(uint64_t time) const;
+    void lodEvent(int lifeline, uint64_t time, uint32_t kind);
+    void lodState(int lifeline, const State_entry& state, double exclusive);
+    //@}
+
+    static uint64_t blockKey(int lifeline, Series series, int block);
+    static size_t recordSize(Series series);
+
+private: /* members */
+
+    std::vector<Lifeline_data> lifelines_;
+    Process_map process_map_;
+
+    /** Sends and receives waiting for their pair. Streams are read
+        independently, so either side may come first. */
+    Pending_map pending_sends_;
+    Pending_map pending_receives_;
+
+    uint64_t min_time_;
+    uint64_t max_time_;
+
+    Lod_geometry lod_geometry_;
+    bool lod_initialized_;
+
+    Block_cache cache_;
+
+private:
+    Trace_store(const Trace_store&);
+    Trace_store& operator=(const Trace_store&);
+};
+
+/** Iterates records of one series of one lifeline overlapping
+    the given time range. Only blocks sealed at the moment of
+    construction are visited. */
+template<class Entry>
+class Series_cursor
+{
+public:
+    Series_cursor()
+    : store_(0), lifeline_(-1), series_(Trace_store::events_series), min_(0), max_(0),
+      block_(-1), blocks_count_(0), index_(0), count_(0), records_(0)
+    {}
+
+    Series_cursor(Trace_store* store, int lifeline, Trace_store::Series series,
+                  uint64_t min, uint64_t max)
+    : store_(store), lifeline_(lifeline), series_(series), min_(min), max_(max),
+      block_(-1), blocks_count_((int)store->blocks(lifeline, series).size()),
+      index_(0), count_(0), records_(0)
+    {}
+
+    /** Returns next block record or 0. Records are filtered only by
+        blocks, caller must check the record time itself. */
+    const Entry* next()
+    {
+        if (!store_) return 0;
+
+        while (index_ >= count_)
+        {
+            if (!nextBlock())
+                return 0;
+        }
+
+        if (!records_)
+        {
+            ref_ = store_->fetch(lifeline_, series_, block_);
+            records_ = static_cast<const Entry*>(ref_.data());
+        }
+        return &records_[index_++];
+    }
+
+    /** Returns the record obtained by the last next() call back. */
+    void unget() { assert(index_ > 0); --index_; }
+
+    /** Unpins the current block, keeping the position. The block
+        is fetched again by the next call to next(). */
+    void release() { ref_ = Block_ref(); records_ = 0; }
+
+    int lifeline() const { return lifeline_; }
+
+private:
+    bool nextBlock()
+    {
+        const std::vector<Trace_store::Block>& blocks =
+            store_->blocks(lifeline_, series_);
+
+        for (++block_; block_ < blocks_count_; ++block_)
+        {
+            const Trace_store::Block& b = blocks[block_];
+            if (b.end < min_ || b.begin > max_)
+                continue;
+
+            ref_ = store_->fetch(lifeline_, series_, block_);
+            records_ = static_cast<const Entry*>(ref_.data());
+            count_ = b.count;
+            index_ = 0;
+            return true;
+        }
+
+        ref_ = Block_ref();
+        records_ = 0;
+        index_ = count_ = 0;
+        return false;
+    }
+
+    Trace_store* store_;
+    int lifeline_;
+    Trace_store::Series series_;
+    uint64_t min_, max_;
+
+    int block_;
+    int blocks_count_;
+    uint32_t index_;
+    uint32_t count_;
+
+    Block_ref ref_;
+    const Entry* records_;
+};
+
+}
+#endif
@@ -8,26 +8,42 @@ INCLUDEPATH += /usr/include/libxml2
 SOURCES += vis4.cpp \
     trace_model.cpp \
     selection.cpp \
+    string_table.cpp \
     time_vis3.cpp \
     otf_trace_model.cpp \
+    trace_store.cpp \
+    otf_loader.cpp \
     event_list.cpp \
     canvas_item.cpp \
     main_window.cpp \
     canvas.cpp \
     trace_painter.cpp \
+    batch_kernels.cpp \
     timeline.cpp \
     timeunit_control.cpp \
     tools/tool.cpp \
     otf_main_window.cpp \
     tools/find_tabs.cpp \
+    tools/find_all.cpp \
     checker.cpp \
+    query.cpp \
+    query_checker.cpp \
+    rules.cpp \
+    critical_path.cpp \
+    wait_states.cpp \
+    rule_checker.cpp \
+    wait_checker.cpp \
     tools/timeedit.cpp \
     tools/selection_widget.cpp \
     grx.cpp
 HEADERS += trace_model.h \
     selection.h \
+    string_table.h \
     time_vis3.h \
     otf_trace_model.h \
+    trace_store.h \
+    otf_loader.h \
+    part_workers.h \
     state_model.h \
     group_model.h \
     event_model.h \
@@ -36,6 +52,7 @@ HEADERS += trace_model.h \
     main_window.h \
     canvas.h \
     trace_painter.h \
+    batch_kernels.h \
     timeline.h \
     timeunit_control.h \
     tools/tool.h \
@@ -46,7 +63,19 @@ HEADERS += trace_model.h \
     tools/find.h \
     tools/filter.h \
     tools/find_tabs.h \
+    tools/find_all.h \
+    tools/profile.h \
+    tools/communication.h \
+    tools/critical.h \
+    tools/waits.h \
     checker.h \
+    query.h \
+    query_checker.h \
+    rules.h \
+    critical_path.h \
+    wait_states.h \
+    rule_checker.h \
+    wait_checker.h \
     tools/timeedit.h \
     tools/selection_widget.h \
     grx.h
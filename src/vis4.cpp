@@ -1,8 +1,107 @@
 #include <QApplication>
+#include <QStringList>
+#include <QTime>
+#include <QDebug>
+#include <QMap>
 #include <boost/enable_shared_from_this.hpp>
 
 #include "otf_trace_model.h"
+#include "otf_loader.h"
 #include "otf_main_window.h"
+#include "batch_kernels.h"
+#include "query_checker.h"
+#include "rule_checker.h"
+#include "wait_checker.h"
+
+#include <vector>
+#include <stdlib.h>
+
+namespace {
+
+/** Loads each trace and reports load throughput. */
+int benchmark(const QStringList& files)
+{
+    using namespace vis4;
+
+    foreach (const QString& file, files)
+    {
+        QTime timer;
+        timer.start();
+        OTF_trace_model::Ptr model(new OTF_trace_model(file));
+        model->load(-1);
+        int elapsed = timer.elapsed();
+
+        double mb = OTF_loader::traceSize(file) / (1024.0*1024.0);
+        qDebug() << file << ":" << mb << "MB in" << elapsed << "ms,"
+                 << (elapsed ? mb * 1000 / elapsed : 0) << "MB/s";
+    }
+    return 0;
+}
+
+/** Compares conversion of times to pixels and of components to
+    lifelines done per record, as the painter used to do, with the
+    batch kernels. */
+int benchmarkKernels()
+{
+    using namespace vis4;
+    using common::Time;
+    using common::scalar_time;
+
+    const int count = 1 << 20;
+    const int components = 1024;
+    const int rounds = 20;
+
+    std::vector<int64_t> ticks(count);
+    std::vector<int> component(count);
+    for (int i = 0; i < count; ++i)
+    {
+        ticks[i] = (int64_t)i * 1000 + rand() % 1000;
+        component[i] = rand() % components;
+    }
+
+    QMap<int, int> lifeline_map;
+    std::vector<int> lifeline_table(components);
+    for (int c = 0; c < components; ++c)
+        lifeline_map[c] = lifeline_table[c] = c / 2;
+
+    std::vector<int> pixels(count), lifelines(count);
+    Time min_time = scalar_time<long long>(ticks[0]);
+    Time time_per_page = scalar_time<long long>(ticks[count-1] - ticks[0]);
+    double scale = 1024.0 / (ticks[count-1] - ticks[0]);
+    long long check = 0;
+
+    QTime timer;
+    timer.start();
+    for (int r = 0; r < rounds; ++r)
+        for (int i = 0; i < count; ++i)
+        {
+            double ratio = (scalar_time<long long>(ticks[i]) - min_time) / time_per_page;
+            pixels[i] = int(ratio * 1024);
+            lifelines[i] = lifeline_map.contains(component[i]) ? lifeline_map[component[i]] : -1;
+        }
+    int per_record = timer.elapsed();
+    check += pixels[count/2] + lifelines[count/2];
+
+    timer.start();
+    for (int r = 0; r < rounds; ++r)
+    {
+        ticks_to_pixels(&ticks[0], count, ticks[0], scale, 0, &pixels[0]);
+        components_to_lifelines(&component[0], count, &lifeline_table[0], components,
+                                &lifelines[0]);
+    }
+    int batch = timer.elapsed();
+    check += pixels[count/2] + lifelines[count/2];
+
+    double records = double(count) * rounds / 1e6;
+    qDebug() << "per record:" << per_record << "ms,"
+             << (per_record ? records * 1000 / per_record : 0) << "M records/s";
+    qDebug() << "batch (" << batch_kernels_isa() << "):" << batch << "ms,"
+             << (batch ? records * 1000 / batch : 0) << "M records/s";
+    qDebug() << "checksum" << check;
+    return 0;
+}
+
+}
 
 int main(int ac, char* av[])
 {
@@ -12,7 +111,24 @@ int main(int ac, char* av[])
     app.setOrganizationDomain("lvk.cs.msu.su");
     app.setApplicationName("otf-vis");
 
-    Trace_model::Ptr model(new OTF_trace_model("hello_world.otf"));
+    QStringList args = app.arguments();
+    args.removeFirst();
+
+    if (!args.isEmpty() && args.first() == "--benchmark-kernels")
+        return benchmarkKernels();
+
+    if (!args.isEmpty() && args.first() == "--benchmark")
+    {
+        args.removeFirst();
+        return benchmark(args);
+    }
+
+    Checker::registerChecker(new Query_checker);
+    Checker::registerChecker(new Rule_checker);
+    Checker::registerChecker(new Wait_checker);
+
+    QString filename = args.isEmpty() ? QString("hello_world.otf") : args.first();
+    Trace_model::Ptr model(new OTF_trace_model(filename));
     //Trace_model::Ptr model(new OTF_trace_model("philosophers.otf"));
     //Trace_model::Ptr model(new OTF_trace_model("wrf.otf"));
 
@@ -0,0 +1,57 @@
+#include "wait_checker.h"
+
+#include <QWidget>
+#include <QCheckBox>
+#include <QVBoxLayout>
+
+namespace vis4 {
+
+Wait_checker::Wait_checker()
+    : kinds_(0)
+{
+    for (int k = 0; k < Wait_state::kinds_count; ++k)
+        boxes_[k] = 0;
+}
+
+QWidget * Wait_checker::widget()
+{
+    QWidget * w = new QWidget();
+    QVBoxLayout * layout = new QVBoxLayout(w);
+
+    boxes_[Wait_state::late_sender] = new QCheckBox(tr("Late sender"), w);
+    boxes_[Wait_state::late_sender]->setToolTip(
+        tr("The receive is called before the matching send"));
+    boxes_[Wait_state::late_receiver] = new QCheckBox(tr("Late receiver"), w);
+    boxes_[Wait_state::late_receiver]->setToolTip(
+        tr("The send lasts until the matching receive is called"));
+    boxes_[Wait_state::collective] = new QCheckBox(tr("Collective"), w);
+    boxes_[Wait_state::collective]->setToolTip(
+        tr("A collective operation waits for the last process to call it"));
+
+    for (int k = 0; k < Wait_state::kinds_count; ++k)
+    {
+        boxes_[k]->setChecked(true);
+        layout->addWidget(boxes_[k]);
+        connect(boxes_[k], SIGNAL( toggled(bool) ), this, SLOT( kindToggled() ));
+    }
+    kindToggled();
+
+    return w;
+}
+
+Checker * Wait_checker::clone() const
+{
+    return new Wait_checker();
+}
+
+void Wait_checker::kindToggled()
+{
+    kinds_ = 0;
+    for (int k = 0; k < Wait_state::kinds_count; ++k)
+        if (boxes_[k]->isChecked())
+            kinds_ |= 1 << k;
+
+    emit stateChanged();
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef WAIT_CHECKER_HPP
+#define WAIT_CHECKER_HPP
+
+#include "checker.h"
+
+class QCheckBox;
+
+namespace vis4 {
+
+/** Checker finding the wait states of the selected kinds, see
+    find_wait_states. The model the checker is installed to reports
+    each wait as a state of the call waiting. */
+class Wait_checker : public Checker {
+
+    Q_OBJECT
+
+public: /* methods */
+
+    Wait_checker();
+
+    QString name() const { return "waits"; }
+
+    QString title() const { return tr("Wait states"); }
+
+    std::set<int> events() const { return std::set<int>(); }
+
+    std::set<int> subevents(int) const { return std::set<int>(); }
+
+    QWidget * widget();
+
+    bool isReady() const { return kinds_ != 0; }
+
+    void setModel(const Trace_model::Ptr & model) { model_ = model; }
+
+    int wait_kinds() const { return kinds_; }
+
+private: /* methods */
+
+    Checker * clone() const;
+
+private slots:
+
+    void kindToggled();
+
+private: /* members */
+
+    Trace_model::Ptr model_;
+    int kinds_;
+
+    QCheckBox * boxes_[Wait_state::kinds_count];
+
+};
+
+}
+#endif
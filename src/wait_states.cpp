@@ -0,0 +1,170 @@
+#include "wait_states.h"
+
+#include <algorithm>
+#include <map>
+
+namespace vis4 {
+
+namespace {
+
+bool receive_before(const Wait_receive* a, const Wait_receive* b)
+{
+    return a->time < b->time;
+}
+
+bool message_before(const Wait_message* a, const Wait_message* b)
+{
+    return a->receive_time < b->receive_time;
+}
+
+/** Calls of one operation are next to each other, in the order of
+    begin. */
+bool operation_before(const Wait_collective* a, const Wait_collective* b)
+{
+    if (a->call.type != b->call.type) return a->call.type < b->call.type;
+    if (a->number != b->number) return a->number < b->number;
+    return a->call.begin < b->call.begin;
+}
+
+void add_wait(std::vector<Wait_state>& waits, Wait_state::Kind kind,
+              const Wait_call& call, int peer, int64_t end,
+              int64_t min, int64_t max)
+{
+    end = std::min(end, call.end);
+    if (end <= call.begin || end < min || call.begin > max) return;
+
+    Wait_state w = { kind, call.component, peer, call.type, call.begin, end };
+    waits.push_back(w);
+}
+
+void message_waits(const Wait_message& m, const Wait_call& receive,
+                   int64_t min, int64_t max, std::vector<Wait_state>& waits)
+{
+    const Wait_call& send = m.send;
+    if (send.type == -1 || receive.type == -1) return;
+
+    if (receive.begin < send.begin)
+        add_wait(waits, Wait_state::late_sender, receive, send.component,
+                 send.begin, min, max);
+    else if (send.begin < receive.begin && send.end > receive.begin)
+        add_wait(waits, Wait_state::late_receiver, send, receive.component,
+                 receive.begin, min, max);
+}
+
+}
+
+bool is_collective(const QString& function)
+{
+    static const char* const names[] = {
+        "barrier", "reduce", "bcast", "broadcast", "gather", "scatter",
+        "alltoall", "scan" };
+
+    for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+        if (function.contains(names[i], Qt::CaseInsensitive))
+            return true;
+    return false;
+}
+
+std::vector<bool> collective_states(const common::Selection& states)
+{
+    std::vector<bool> collective(states.totalItemsCount());
+    for (unsigned link = 0; link < collective.size(); ++link)
+        collective[link] = is_collective(states.item(link));
+    return collective;
+}
+
+Call_stack::Call_stack(int component, const std::vector<Wait_call>& calls)
+: component_(component), calls_(calls), next_(0)
+{
+}
+
+Wait_call Call_stack::at(int64_t time)
+{
+    while (next_ < calls_.size() && calls_[next_].begin <= time)
+    {
+        while (!open_.empty() && open_.back()->end < calls_[next_].begin)
+            open_.pop_back();
+        open_.push_back(&calls_[next_++]);
+    }
+    while (!open_.empty() && open_.back()->end < time)
+        open_.pop_back();
+
+    if (!open_.empty())
+        return *open_.back();
+
+    Wait_call none = { component_, -1, 0, 0 };
+    return none;
+}
+
+void find_wait_states(const std::vector<const Wait_part*>& parts,
+                      int64_t min, int64_t max, std::vector<Wait_state>& waits)
+{
+    typedef std::map<int, std::vector<const Wait_receive*> > Receive_map;
+    typedef std::map<int, std::vector<const Wait_message*> > Message_map;
+
+    Receive_map receives;
+    Message_map messages;
+    std::vector<const Wait_collective*> collectives;
+
+    for (unsigned p = 0; p < parts.size(); ++p)
+    {
+        const Wait_part& part = *parts[p];
+        for (unsigned i = 0; i < part.receives.size(); ++i)
+            receives[part.receives[i].call.component].push_back(&part.receives[i]);
+        for (unsigned i = 0; i < part.messages.size(); ++i)
+            messages[part.messages[i].receiver].push_back(&part.messages[i]);
+        for (unsigned i = 0; i < part.collectives.size(); ++i)
+            collectives.push_back(&part.collectives[i]);
+    }
+
+    size_t first = waits.size();
+
+    /* The messages of each receiver in the order of receive are
+       joined with its receives. */
+    Message_map::iterator m;
+    for (m = messages.begin(); m != messages.end(); ++m)
+    {
+        std::vector<const Wait_message*>& list = m->second;
+        std::stable_sort(list.begin(), list.end(), message_before);
+
+        std::vector<const Wait_receive*>& r = receives[m->first];
+        std::stable_sort(r.begin(), r.end(), receive_before);
+
+        unsigned k = 0;
+        for (unsigned i = 0; i < list.size(); ++i)
+        {
+            while (k < r.size() && r[k]->time < list[i]->receive_time)
+                ++k;
+            if (k < r.size() && r[k]->time == list[i]->receive_time)
+                message_waits(*list[i], r[k]->call, min, max, waits);
+        }
+    }
+
+    /* The last call of an operation to begin ends the waits of the
+       others. */
+    std::sort(collectives.begin(), collectives.end(), operation_before);
+    for (unsigned i = 0, j; i < collectives.size(); i = j)
+    {
+        j = i + 1;
+        while (j < collectives.size()
+               && collectives[j]->call.type == collectives[i]->call.type
+               && collectives[j]->number == collectives[i]->number)
+            ++j;
+
+        const Wait_call& last = collectives[j-1]->call;
+        for (unsigned k = i; k < j - 1; ++k)
+            add_wait(waits, Wait_state::collective, collectives[k]->call,
+                     last.component, last.begin, min, max);
+    }
+
+    std::sort(waits.begin() + first, waits.end(), wait_before);
+}
+
+bool wait_before(const Wait_state& a, const Wait_state& b)
+{
+    if (a.begin != b.begin) return a.begin < b.begin;
+    if (a.component != b.component) return a.component < b.component;
+    return a.type < b.type;
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef WAIT_STATES_HPP
+#define WAIT_STATES_HPP
+
+#include "trace_model.h"
+
+#include <QString>
+
+#include <vector>
+#include <stdint.h>
+
+namespace vis4 {
+
+/** Returns true if the function is a collective operation, judging by
+    its name: barriers, reductions, broadcasts, gathers and scatters, as
+    named by MPI. Names of the states come from the string table, which
+    may be used only by the GUI thread, so the calls are classified
+    before a search starts and the workers use the result. */
+bool is_collective(const QString& function);
+
+/** Returns the flags of is_collective for each state link. */
+std::vector<bool> collective_states(const common::Selection& states);
+
+/** Finds the innermost call at the given times, which must not
+    decrease. Calls must be sorted by begin, nested calls following
+    the calls containing them. */
+class Call_stack
+{
+public:
+    Call_stack(int component, const std::vector<Wait_call>& calls);
+
+    /** Returns the innermost call containing time, of type -1 if
+        there is none. */
+    Wait_call at(int64_t time);
+
+private:
+    int component_;
+    const std::vector<Wait_call>& calls_;
+    unsigned next_;
+    std::vector<const Wait_call*> open_;
+};
+
+/** Finds the wait states in the data of all parts.
+
+    - Late sender: the receiving call begins before the sending call,
+      the receiver waits until the send begins.
+    - Late receiver: the sending call begins before the receiving call
+      and lasts until it, the sender waits until the receive begins.
+    - Collective: the calls of one collective operation begin at
+      different times, each component waits until the last one comes.
+
+    Messages are joined with their receives by the receiver and the
+    time. Waits overlapping [min, max] are appended to waits, in the
+    order of wait_before. */
+void find_wait_states(const std::vector<const Wait_part*>& parts,
+                      int64_t min, int64_t max, std::vector<Wait_state>& waits);
+
+/** Order of the states in Trace_model::find_state: by begin, then by
+    component, then by type. */
+bool wait_before(const Wait_state& a, const Wait_state& b);
+
+}
+#endif